@@ -6,40 +6,42 @@
 
 using namespace llvm;
 
-std::string CheckNSWPlugin::canOverflow(Value* value) {
+QueryResult CheckNSWPlugin::canOverflow(Value* value) {
     // Support only instructions
     auto* inst = dyn_cast<Instruction>(value);
     if (!inst)
-        return "unknown";
+        return QueryResult::Unknown;
 
     // Support only instruction of integer type
     const auto* intT = dyn_cast<IntegerType>(inst->getType());
     if (!intT)
-        return "unknown";
+        return QueryResult::Unknown;
 
     if (const auto* binOp
         = dyn_cast<OverflowingBinaryOperator>(inst)) {
         // we are looking for bin. ops with nsw
         if (!binOp->hasNoSignedWrap())
-            return "false";
+            return QueryResult::False;
     }
 
-    return "unknown";
+    return QueryResult::Unknown;
 }
 
-static const std::string supportedQueries[] = {
-    "canOverflow",
-};
-
-bool CheckNSWPlugin::supports(const std::string& query) {
-    for (unsigned idx = 0; idx < sizeof(supportedQueries)/sizeof(*supportedQueries); ++idx) {
-        if (query == supportedQueries[idx])
-            return true;
-    }
-
-    return false;
+void CheckNSWPlugin::bindQueries(const std::vector<std::string>& names) {
+    static const QueryHandlers<CheckNSWPlugin>::Entry entries[] = {
+        {"canOverflow", [](CheckNSWPlugin& p, ArrayRef<Value*> operands) {
+            assert(operands.size() == 1 && "Wrong number of operands");
+            return p.canOverflow(operands[0]);
+        }},
+    };
+    handlers.bind(names, entries);
 }
 
-extern "C" InstrPlugin* create_object(llvm::Module* module) {
+// queries are answered directly from the instructions
+extern "C" const unsigned instr_plugin_capabilities = PluginReadsModuleOnly;
+
+extern "C" InstrPluginV2* create_object_v2(llvm::Module* module, unsigned version) {
+    if (version != INSTR_PLUGIN_ABI_VERSION)
+        return nullptr;
     return new CheckNSWPlugin(module);
 }
@@ -6,25 +6,26 @@
 #include <llvm/IR/Constants.h>
 #include "instr_plugin.hpp"
 
-class CheckNSWPlugin : public InstrPlugin
+class CheckNSWPlugin : public InstrPluginV2
 {
      private:
-        std::string canOverflow(llvm::Value*);
+        QueryHandlers<CheckNSWPlugin> handlers;
+
+        QueryResult canOverflow(llvm::Value*);
 
     public:
-        bool supports(const std::string& query) override;
-        std::string query(const std::string& query,
-                const std::vector<llvm::Value *>& operands) override {
-            if (query == "canOverflow") {
-                assert(operands.size() == 1 && "Wrong number of operands");
-                return canOverflow(operands[0]);
-            } else {
-                return "unsupported query";
-            }
+        void bindQueries(const std::vector<std::string>& names) override;
+        bool supports(QueryId query) const override {
+            return handlers.supports(query);
+        }
+        bool isThreadSafe() const override { return true; }
+        QueryResult query(QueryId query,
+                          llvm::ArrayRef<llvm::Value *> operands) override {
+            return handlers.answer(*this, query, operands);
         }
 
         CheckNSWPlugin(llvm::Module* /*module*/)
-            : InstrPlugin("CheckNSWPlugin") {}
+            : InstrPluginV2("CheckNSWPlugin") {}
 };
 
 #endif
@@ -2,6 +2,8 @@
 
 #include "dg/SCC.h"
 
+#include <chrono>
+#include <cstdlib>
 #include <set>
 #include <string>
 #include <iostream>
@@ -10,42 +12,128 @@ using dg::pta::PSNode;
 using dg::pta::Pointer;
 using dg::pta::PSNodeAlloc;
 
-std::string PointsToPlugin::pointsToStack(llvm::Value* a) {
+static PointsToSummary summarize(const PSNode *node) {
+    PointsToSummary summary;
+    if (node->pointsTo.empty())
+        return summary;
+
+    summary.flags = PointsToSummary::Known | PointsToSummary::AllHeap |
+                    PointsToSummary::AllStack | PointsToSummary::AllGlobal |
+                    PointsToSummary::AllOffsetsKnown |
+                    PointsToSummary::AllNullOrInvalidated |
+                    PointsToSummary::AllSizesKnown | PointsToSummary::SameSizes;
+
+    const auto& first = *(node->pointsTo.begin());
+    summary.offset = *(first.offset);
+    summary.size = first.target->getSize();
+    summary.min_offset = summary.max_offset = summary.offset;
+    summary.min_space = summary.max_space = summary.size - summary.offset;
+
+    uint16_t cleared = 0;
+    for (const auto& ptr : node->pointsTo) {
+        if (ptr.isNull())
+            summary.flags |= PointsToSummary::HasNull;
+        if (ptr.isUnknown())
+            summary.flags |= PointsToSummary::HasUnknown;
+        if (ptr.isInvalidated())
+            summary.flags |= PointsToSummary::HasInvalidated;
+        if (!ptr.isNull() && !ptr.isInvalidated())
+            cleared |= PointsToSummary::AllNullOrInvalidated;
+
+        PSNodeAlloc *target = ptr.isUnknown() ? nullptr : PSNodeAlloc::get(ptr.target);
+        if (target && target->isHeap())
+            summary.flags |= PointsToSummary::HasHeap;
+        if (!target || !target->isHeap())
+            cleared |= PointsToSummary::AllHeap;
+        if (!target || target->isGlobal() || target->isHeap())
+            cleared |= PointsToSummary::AllStack;
+        if (!target || !target->isGlobal())
+            cleared |= PointsToSummary::AllGlobal;
+
+        if (ptr.offset.isUnknown())
+            cleared |= PointsToSummary::AllOffsetsKnown;
+        if (ptr.isNull() || ptr.isUnknown() || ptr.isInvalidated() ||
+            ptr.offset.isUnknown() || ptr.target->getSize() == 0)
+            cleared |= PointsToSummary::AllSizesKnown;
+        if (*(ptr.offset) != summary.offset ||
+            ptr.target->getSize() != summary.size)
+            cleared |= PointsToSummary::SameSizes;
+
+        uint64_t space = ptr.target->getSize() - *(ptr.offset);
+        if (*(ptr.offset) < summary.min_offset)
+            summary.min_offset = *(ptr.offset);
+        if (*(ptr.offset) > summary.max_offset)
+            summary.max_offset = *(ptr.offset);
+        if (space < summary.min_space)
+            summary.min_space = space;
+        if (space > summary.max_space)
+            summary.max_space = space;
+    }
+
+    summary.flags &= ~cleared;
+    return summary;
+}
+
+void PointsToPlugin::computeSummaries() {
+    auto& nodes = PTA->getNodes();
+    summaries.assign(nodes.size(), PointsToSummary());
+    for (auto &nodeptr : nodes) {
+        if (!nodeptr)
+            continue;
+        if (nodeptr->getID() >= summaries.size())
+            summaries.resize(nodeptr->getID() + 1);
+        summaries[nodeptr->getID()] = summarize(nodeptr.get());
+    }
+}
+
+///
+// Return the summary of the points-to set of the value,
+// nullptr if the points-to set is empty
+const PointsToSummary *PointsToPlugin::getSummary(const llvm::Value* a) {
     // need to have the PTA
     assert(PTA);
     PSNode *psnode = PTA->getPointsToNode(a);
-    if (!psnode || psnode->pointsTo.empty()) {
-        // llvm::errs() << "No points-to for " << *a << "\n";
-        // we know nothing, it may be null
-        return "maybe";
+    if (!psnode)
+        return nullptr;
+
+    const PointsToSummary *summary;
+    if (psnode->getID() < summaries.size()) {
+        summary = &summaries[psnode->getID()];
+    } else {
+        // PTA creates nodes for some constants only when asked for them
+        auto it = lateSummaries.find(psnode);
+        if (it == lateSummaries.end())
+            it = lateSummaries.emplace(psnode, summarize(psnode)).first;
+        summary = &it->second;
     }
 
-    for (const auto& ptr : psnode->pointsTo) {
-        if (ptr.isUnknown())
-            return "false";
+    return summary->is(PointsToSummary::Known) ? summary : nullptr;
+}
 
-        PSNodeAlloc *target = PSNodeAlloc::get(ptr.target);
-        if (!target || target->isGlobal() || target->isHeap())
-            return "false";
+QueryResult PointsToPlugin::pointsToStack(llvm::Value* a) {
+    const PointsToSummary *summary = getSummary(a);
+    if (!summary) {
+        // llvm::errs() << "No points-to for " << *a << "\n";
+        // we know nothing, it may be null
+        return QueryResult::Maybe;
     }
 
     // a points to stack
-    return "true";
+    if (summary->is(PointsToSummary::AllStack))
+        return QueryResult::True;
+
+    return QueryResult::False;
 }
 
 std::string PointsToPlugin::notMinMemoryBlock(llvm::Value* p, llvm::Value* a) {
     // check is a is getelementptr
     if (llvm::GetElementPtrInst *GI = llvm::dyn_cast<llvm::GetElementPtrInst>(p)) {
-        // need to have the PTA
-        assert(PTA);
-        PSNode *psnode = PTA->getPointsToNode(GI->getPointerOperand());
-        if (!psnode || psnode->pointsTo.empty()) {
+        const PointsToSummary *summary = getSummary(GI->getPointerOperand());
+        if (!summary) {
             return "true";
         }
 
-        uint64_t min_offset = *((*psnode->pointsTo.begin()).offset);
-        uint64_t min_space = (*psnode->pointsTo.begin()).target->getSize()
-                             - *((*psnode->pointsTo.begin()).offset);
+        PSNode *psnode = PTA->getPointsToNode(GI->getPointerOperand());
         bool pointsTo = false;
 
         uint64_t act_offset = 0;
@@ -59,21 +147,13 @@ std::string PointsToPlugin::notMinMemoryBlock(llvm::Value* p, llvm::Value* a) {
                 act_space = (ptr.target->getSize() - *(ptr.offset));
                 pointsTo = true;
             }
-
-            if ((*(ptr.offset) < min_offset))
-                min_offset = *(ptr.offset);
-
-            if ((ptr.target->getSize() - *(ptr.offset))
-                < min_space) {
-                min_space = ptr.target->getSize() - *(ptr.offset);
-            }
         }
 
         if (!pointsTo) {
             return "unknown";
         }
 
-        if (act_offset <= min_offset && act_space <= min_space) {
+        if (act_offset <= summary->min_offset && act_space <= summary->min_space) {
             return "false";
         } else {
             return "true";
@@ -84,180 +164,121 @@ std::string PointsToPlugin::notMinMemoryBlock(llvm::Value* p, llvm::Value* a) {
     }
 }
 
-std::string PointsToPlugin::pointsToGlobal(llvm::Value* a) {
-    // need to have the PTA
-    assert(PTA);
-    PSNode *psnode = PTA->getPointsToNode(a);
-    if (!psnode || psnode->pointsTo.empty()) {
+QueryResult PointsToPlugin::pointsToGlobal(llvm::Value* a) {
+    const PointsToSummary *summary = getSummary(a);
+    if (!summary) {
         // llvm::errs() << "No points-to for " << *a << "\n";
         // we know nothing, it may be null
-        return "maybe";
-    }
-
-    for (const auto& ptr : psnode->pointsTo) {
-        if (ptr.isUnknown())
-            return "false";
-
-        PSNodeAlloc *target = PSNodeAlloc::get(ptr.target);
-        if (!target || !target->isGlobal())
-            return "false";
+        return QueryResult::Maybe;
     }
 
     // a points to a global variable
-    return "true";
+    if (summary->is(PointsToSummary::AllGlobal))
+        return QueryResult::True;
+
+    return QueryResult::False;
 }
 
-std::string PointsToPlugin::pointsToHeap(llvm::Value* a) {
-    // need to have the PTA
-    assert(PTA);
-    PSNode *psnode = PTA->getPointsToNode(a);
-    if (!psnode || psnode->pointsTo.empty()) {
+QueryResult PointsToPlugin::pointsToHeap(llvm::Value* a) {
+    const PointsToSummary *summary = getSummary(a);
+    if (!summary) {
         // llvm::errs() << "No points-to for " << *a << "\n";
         // we know nothing, it may be null
-        return "maybe";
-    }
-
-    for (const auto& ptr : psnode->pointsTo) {
-        if (ptr.isUnknown())
-            return "false";
-
-        PSNodeAlloc *target = PSNodeAlloc::get(ptr.target);
-        if (!target || !target->isHeap())
-            return "false";
+        return QueryResult::Maybe;
     }
 
     // a points to heap
-    return "true";
+    if (summary->is(PointsToSummary::AllHeap))
+        return QueryResult::True;
+
+    return QueryResult::False;
 }
 
-std::string PointsToPlugin::isInvalid(llvm::Value* a) {
-    // need to have the PTA
-    assert(PTA);
-    PSNode *psnode = PTA->getPointsToNode(a);
-    if (!psnode || psnode->pointsTo.empty()) {
+QueryResult PointsToPlugin::isInvalid(llvm::Value* a) {
+    const PointsToSummary *summary = getSummary(a);
+    if (!summary) {
         // llvm::errs() << "No points-to for " << *a << "\n";
         // we know nothing, it may be null
-        return "maybe";
-    }
-
-    for (const auto& ptr : psnode->pointsTo) {
-        if (!ptr.isNull() && !ptr.isInvalidated())
-            return "false";
+        return QueryResult::Maybe;
     }
 
     // a is null or invalidated
-    return "true";
+    if (summary->is(PointsToSummary::AllNullOrInvalidated))
+        return QueryResult::True;
+
+    return QueryResult::False;
 }
 
-std::string PointsToPlugin::isNull(llvm::Value* a) {
+QueryResult PointsToPlugin::isNull(llvm::Value* a) {
     if (!a->getType()->isPointerTy())
         // null must be a pointer
-        return "false";
+        return QueryResult::False;
 
-    // need to have the PTA
-    assert(PTA);
-    PSNode *psnode = PTA->getPointsToNode(a);
-    if (!psnode || psnode->pointsTo.empty()) {
+    const PointsToSummary *summary = getSummary(a);
+    if (!summary) {
         // llvm::errs() << "No points-to for " << *a << "\n";
         // we know nothing, it may be null
-        return "maybe";
+        return QueryResult::Maybe;
     }
 
-    for (const auto& ptr : psnode->pointsTo) {
-        // unknown pointer can be null too
-        if (ptr.isNull() || ptr.isUnknown())
-            return "true";
-    }
+    // unknown pointer can be null too
+    if (summary->is(PointsToSummary::HasNull) ||
+        summary->is(PointsToSummary::HasUnknown))
+        return QueryResult::True;
 
     // a can not be null
-    return "false";
+    return QueryResult::False;
 }
 
-std::string PointsToPlugin::hasKnownSizes(llvm::Value* a) {
+QueryResult PointsToPlugin::hasKnownSizes(llvm::Value* a) {
     // check is a is getelementptr
     if (const llvm::GetElementPtrInst *GI
             = llvm::dyn_cast<llvm::GetElementPtrInst>(a)) {
-        // need to have the PTA
-        assert(PTA);
-        PSNode *psnode = PTA->getPointsToNode(GI->getPointerOperand());
-        if (!psnode || psnode->pointsTo.empty()) {
+        const PointsToSummary *summary = getSummary(GI->getPointerOperand());
+        if (!summary) {
             // we know nothing about the allocated size
-            return "false";
-        }
-
-        // check that all the objects has known sizes and
-        // offsets
-        for (const auto& ptr : psnode->pointsTo) {
-            // ptset cannot contain null, unknown or invalidated pointer
-            if(ptr.isNull() || ptr.isUnknown() || ptr.isInvalidated())
-                return "false";
-
-            // the sizes and offsets need to be known
-            if (ptr.offset.isUnknown() ||
-                ptr.target->getSize() == 0) {
-                return "false";
-            }
+            return QueryResult::False;
         }
 
-        return "true";
+        // all the objects must have known sizes and offsets
+        // and the ptset cannot contain null, unknown or invalidated pointer
+        if (summary->is(PointsToSummary::AllSizesKnown))
+            return QueryResult::True;
     }
 
-    return "false";
+    return QueryResult::False;
 }
 
-std::string PointsToPlugin::hasKnownSize(llvm::Value* a) {
+QueryResult PointsToPlugin::hasKnownSize(llvm::Value* a) {
     // check is a is getelementptr
     if (const llvm::GetElementPtrInst *GI
             = llvm::dyn_cast<llvm::GetElementPtrInst>(a)) {
-        // need to have the PTA
-        assert(PTA);
-        PSNode *psnode = PTA->getPointsToNode(GI->getPointerOperand());
-        if (!psnode || psnode->pointsTo.empty()) {
+        const PointsToSummary *summary = getSummary(GI->getPointerOperand());
+        if (!summary) {
             // we know nothing about the allocated size
-            return "false";
-        }
-
-        const auto& first = *(psnode->pointsTo.begin());
-        // we must have concrete offset and concrete size
-        if (first.isNull() || first.isUnknown() || first.isInvalidated())
-            return "false";
-        if (first.offset.isUnknown())
-            return "false";
-        if (first.target->getSize() == 0)
-            return "false";
-
-        // check that all the objects has the same size and the
-        // same offset (and are know, but that follows from
-        // the non-zero size
-        for (const auto& ptr : psnode->pointsTo) {
-            // the sizes and offsets need to be the same
-            if (*(ptr.offset) != *(first.offset) ||
-                ptr.target->getSize() != first.target->getSize()) {
-                return "false";
-            }
-            // ptset cannot contain null, unknown or invalidated pointer
-            assert(!(ptr.isNull() || ptr.isUnknown() || ptr.isInvalidated()));
+            return QueryResult::False;
         }
 
-        return "true";
+        // all the objects must have the same known size and
+        // the same known offset
+        if (summary->is(PointsToSummary::AllSizesKnown) &&
+            summary->is(PointsToSummary::SameSizes))
+            return QueryResult::True;
     }
 
-    return "false";
+    return QueryResult::False;
 }
 
 PointerInfo PointsToPlugin::getPointerInfo(llvm::Value* a) {
     // check is a is getelementptr
     if (llvm::GetElementPtrInst *GI = llvm::dyn_cast<llvm::GetElementPtrInst>(a)) {
-        // need to have the PTA
-        assert(PTA);
-        PSNode *psnode = PTA->getPointsToNode(GI->getPointerOperand());
-        if (!psnode || psnode->pointsTo.empty()) {
+        const PointsToSummary *summary = getSummary(GI->getPointerOperand());
+        if (!summary) {
             return PointerInfo();
         }
 
-        const auto& first = *(psnode->pointsTo.begin());
-        return PointerInfo(GI->getPointerOperand(), *(first.offset),
-                           first.target->getSize());
+        return PointerInfo(GI->getPointerOperand(), summary->offset,
+                           summary->size);
 
     }
     else {
@@ -270,46 +291,28 @@ PointerInfo PointsToPlugin::getPInfoMinMax(llvm::Value* a,
 {
     // check is a is getelementptr
     if (llvm::GetElementPtrInst *GI = llvm::dyn_cast<llvm::GetElementPtrInst>(a)) {
-        // need to have the PTA
-        assert(PTA);
-        PSNode *psnode = PTA->getPointsToNode(GI->getPointerOperand());
-        if (!psnode || psnode->pointsTo.empty()) {
+        const PointsToSummary *summary = getSummary(GI->getPointerOperand());
+        if (!summary) {
             return PointerInfo();
         }
 
-        uint64_t min_offset = *((*psnode->pointsTo.begin()).offset);
-        uint64_t min_space = (*psnode->pointsTo.begin()).target->getSize()
-                             - *((*psnode->pointsTo.begin()).offset);
-        uint64_t max_offset = *((*psnode->pointsTo.begin()).offset);
-        uint64_t max_space = (*psnode->pointsTo.begin()).target->getSize()
-                             - *((*psnode->pointsTo.begin()).offset);
-
-        for (const auto& ptr : psnode->pointsTo) {
-            if ((*(ptr.offset) < min_offset))
-                min_offset = *(ptr.offset);
-            if ((ptr.target->getSize() - *(ptr.offset))
-                < min_space) {
-                min_space = ptr.target->getSize() - *(ptr.offset);
-            }
-            if ((*(ptr.offset) > max_offset))
-                max_offset = *(ptr.offset);
-            if ((ptr.target->getSize() - *(ptr.offset))
-                > max_space) {
-                max_space = ptr.target->getSize() - *(ptr.offset);
-            }
-        }
-
-        for (const auto& ptr : psnode->pointsTo) {
-            if ((*(ptr.offset) > min_offset) &&
-                (ptr.target->getSize() - *(ptr.offset)) > min_space) {
-                llvm::Value *llvmVal = ptr.target->getUserData<llvm::Value>();
-                if (llvmVal)
-                    ptset.push_back(llvmVal);
+        // the objects are needed only when some pointer is above the minima
+        if (summary->max_offset > summary->min_offset &&
+            summary->max_space > summary->min_space) {
+            PSNode *psnode = PTA->getPointsToNode(GI->getPointerOperand());
+            for (const auto& ptr : psnode->pointsTo) {
+                if ((*(ptr.offset) > summary->min_offset) &&
+                    (ptr.target->getSize() - *(ptr.offset)) > summary->min_space) {
+                    llvm::Value *llvmVal = ptr.target->getUserData<llvm::Value>();
+                    if (llvmVal)
+                        ptset.push_back(llvmVal);
+                }
             }
         }
 
-        return PointerInfo(GI->getPointerOperand(), min_offset,
-                           min_space, max_offset, max_space);
+        return PointerInfo(GI->getPointerOperand(), summary->min_offset,
+                           summary->min_space, summary->max_offset,
+                           summary->max_space);
 
     }
     else {
@@ -321,26 +324,13 @@ PointerInfo PointsToPlugin::getPInfoMinMax(llvm::Value* a,
 PointerInfo PointsToPlugin::getPInfoMin(llvm::Value* a) {
     // check is a is getelementptr
     if (llvm::GetElementPtrInst *GI = llvm::dyn_cast<llvm::GetElementPtrInst>(a)) {
-        // need to have the PTA
-        assert(PTA);
-        PSNode *psnode = PTA->getPointsToNode(GI->getPointerOperand());
-        if (!psnode || psnode->pointsTo.empty()) {
+        const PointsToSummary *summary = getSummary(GI->getPointerOperand());
+        if (!summary) {
             return PointerInfo();
         }
 
-        uint64_t min_offset = *((*psnode->pointsTo.begin()).offset);
-        uint64_t min_space = (*psnode->pointsTo.begin()).target->getSize()
-                             - *((*psnode->pointsTo.begin()).offset);
-        for (const auto& ptr : psnode->pointsTo) {
-            if ((*(ptr.offset) < min_offset))
-                min_offset = *(ptr.offset);
-            if ((ptr.target->getSize() - *(ptr.offset))
-                < min_space) {
-                min_space = ptr.target->getSize() - *(ptr.offset);
-            }
-        }
-        return PointerInfo(GI->getPointerOperand(), min_offset,
-                           min_space);
+        return PointerInfo(GI->getPointerOperand(), summary->min_offset,
+                           summary->min_space);
 
     }
     else {
@@ -348,10 +338,10 @@ PointerInfo PointsToPlugin::getPInfoMin(llvm::Value* a) {
     }
 }
 
-std::string PointsToPlugin::isValidPointer(llvm::Value* a, llvm::Value *len) {
+QueryResult PointsToPlugin::isValidPointer(llvm::Value* a, llvm::Value *len) {
     if (!a->getType()->isPointerTy())
         // null must be a pointer
-        return "false";
+        return QueryResult::False;
 
     uint64_t size = 0;
     if (llvm::ConstantInt *C = llvm::dyn_cast<llvm::ConstantInt>(len)) {
@@ -359,12 +349,12 @@ std::string PointsToPlugin::isValidPointer(llvm::Value* a, llvm::Value *len) {
         // if the size cannot be expressed as an uint64_t,
         // say we do not know
         if (size == ~((uint64_t) 0))
-            return "maybe";
+            return QueryResult::Maybe;
 
         // the offset is concrete number, fall-through
     } else {
         // we do not know anything with variable length
-        return "maybe";
+        return QueryResult::Maybe;
     }
 
     assert(size > 0 && size < ~((uint64_t) 0));
@@ -375,22 +365,22 @@ std::string PointsToPlugin::isValidPointer(llvm::Value* a, llvm::Value *len) {
     if (!psnode || psnode->pointsTo.empty()) {
         //llvm::errs() << "No points-to for " << *a << "\n";
         // we know nothing, it may be invalid
-        return "maybe";
+        return QueryResult::Maybe;
     }
 
     for (const auto& ptr : psnode->pointsTo) {
         // unknown pointer and null are invalid
         if (ptr.isNull() || ptr.isUnknown())
-            return "false";
+            return QueryResult::False;
 
         // the memory this pointer points-to was invalidated
         if (ptr.isInvalidated())
-            return "false";
+            return QueryResult::False;
 
         // if the offset is unknown, than the pointer
         // may point after the end of allocated memory
         if (ptr.offset.isUnknown())
-            return "maybe";
+            return QueryResult::Maybe;
 
         // if the offset + size > the size of allocated memory,
         // then this can be invalid operation. Check it so that
@@ -398,14 +388,14 @@ std::string PointsToPlugin::isValidPointer(llvm::Value* a, llvm::Value *len) {
         // and than use this fact and equality with ptr.offset + size > psnode->size)
         if (size > ptr.target->getSize()
                 || *ptr.offset > ptr.target->getSize() - size) {
-            return "false";
+            return QueryResult::False;
         }
 
         if (llvm::Instruction *I = llvm::dyn_cast<llvm::Instruction>(a)) {
             if(llvm::Instruction *Iptr = llvm::dyn_cast<llvm::Instruction>(ptr.target->getUserData<llvm::Value>())) {
                 llvm::Function *F = I->getParent()->getParent();
                 if(Iptr->getParent()->getParent() != F || isRecursive(F))
-                    return "false";
+                    return QueryResult::False;
             } else {
                 //llvm::errs() << "In bound pointer for non-allocated memory: " << *a << "\n";
             }
@@ -415,49 +405,122 @@ std::string PointsToPlugin::isValidPointer(llvm::Value* a, llvm::Value *len) {
     }
 
     // this pointer is valid
-    return "true";
+    return QueryResult::True;
 }
 
-std::string PointsToPlugin::pointsTo(llvm::Value* a, llvm::Value* b) {
+QueryResult PointsToPlugin::pointsTo(llvm::Value* a, llvm::Value* b) {
     if(PTA) {
         PSNode *psnode = PTA->getPointsToNode(a);
-        if (!psnode) return "maybe";
+        if (!psnode) return QueryResult::Maybe;
         for (const auto& ptr : psnode->pointsTo) {
             llvm::Value *llvmVal = ptr.target->getUserData<llvm::Value>();
-            if(llvmVal == b) return "true";
+            if(llvmVal == b) return QueryResult::True;
         }
     } else {
-        return "true"; // a may point to b
+        return QueryResult::True; // a may point to b
     }
 
-    return "false";
+    return QueryResult::False;
 }
 
-std::string PointsToPlugin::pointsToSetsOverlap(llvm::Value* a, llvm::Value* b) {
-    assert(PTA);
-    PSNode *nodeA = PTA->getPointsToNode(a);
-    PSNode *nodeB = PTA->getPointsToNode(b);
-    if (!nodeA || !nodeB)
-        return "maybe";
-    if (nodeA->pointsTo.empty() || nodeB->pointsTo.empty())
-        return "maybe";
-
-    for (const auto& ptrA : nodeA->pointsTo) {
-        if (ptrA.isUnknown())
-            return "maybe";
+///
+// Return the points-to set of the node as bits, dense ids are given
+// to its targets and pointers that do not have them yet
+const PointsToBits& PointsToPlugin::getBits(const PSNode *node) {
+    auto it = bits.find(node);
+    if (it != bits.end())
+        return it->second;
+
+    PointsToBits& nodeBits = bits[node];
+    for (const auto& ptr : node->pointsTo) {
+        if (ptr.isUnknown())
+            continue;
 
-        for (const auto& ptrB : nodeB->pointsTo) {
-            if (ptrB.isUnknown())
-                return "maybe";
+        auto target = targetIds.emplace(ptr.target, targetIds.size());
+        if (target.second) {
+            if (auto *val = ptr.target->getUserData<llvm::Value>())
+                valueTargetIds[val].push_back(target.first->second);
+        }
+        nodeBits.targets.set(target.first->second);
 
-            if ((ptrA.target == ptrB.target) &&
-                ((ptrA.offset.isUnknown() || ptrB.offset.isUnknown()) ||
-                 (ptrA.offset == ptrB.offset)))
-                return "true";
+        if (ptr.offset.isUnknown()) {
+            nodeBits.unknownOffsetTargets.set(target.first->second);
+        } else {
+            auto pointer = pointerIds.emplace(std::make_pair(ptr.target, *(ptr.offset)),
+                                              pointerIds.size());
+            nodeBits.pointers.set(pointer.first->second);
         }
     }
 
-    return "false";
+    return nodeBits;
+}
+
+QueryResult PointsToPlugin::pointsToSetsOverlap(llvm::Value* a, llvm::Value* b) {
+    const PointsToSummary *summaryA = getSummary(a);
+    const PointsToSummary *summaryB = getSummary(b);
+    if (!summaryA || !summaryB)
+        return QueryResult::Maybe;
+
+    const PointsToBits& bitsA = getBits(PTA->getPointsToNode(a));
+    if (bitsA.overlaps(getBits(PTA->getPointsToNode(b))))
+        return QueryResult::True;
+
+    if (summaryA->is(PointsToSummary::HasUnknown) ||
+        summaryB->is(PointsToSummary::HasUnknown))
+        return QueryResult::Maybe;
+
+    return QueryResult::False;
+}
+
+void PointsToPlugin::remember(llvm::Value* a, RememberedPointsTo& remembered) {
+    remembered.any = true;
+
+    PSNode *psnode = PTA->getPointsToNode(a);
+    if (!psnode) {
+        remembered.hasNoNode = true;
+        remembered.hasUnknownSet = true;
+        return;
+    }
+
+    const PointsToSummary *summary = getSummary(a);
+    if (!summary || summary->is(PointsToSummary::HasUnknown))
+        remembered.hasUnknownSet = true;
+
+    remembered.bits.add(getBits(psnode));
+}
+
+bool PointsToPlugin::mayBePointedToByRemembered(llvm::Value* a,
+                                                const RememberedPointsTo& remembered) {
+    if (!remembered.any)
+        return false;
+    if (remembered.hasNoNode)
+        return true;
+
+    // all targets of remembered sets have their ids already
+    auto it = valueTargetIds.find(a);
+    if (it == valueTargetIds.end())
+        return false;
+
+    for (unsigned id : it->second) {
+        if (remembered.bits.targets.test(id))
+            return true;
+    }
+
+    return false;
+}
+
+bool PointsToPlugin::mayOverlapRemembered(llvm::Value* a,
+                                          const RememberedPointsTo& remembered) {
+    if (!remembered.any)
+        return false;
+    if (remembered.hasUnknownSet)
+        return true;
+
+    const PointsToSummary *summary = getSummary(a);
+    if (!summary || summary->is(PointsToSummary::HasUnknown))
+        return true;
+
+    return getBits(PTA->getPointsToNode(a)).overlaps(remembered.bits);
 }
 
 
@@ -488,41 +551,71 @@ bool PointsToPlugin::getPointsTo(llvm::Value* a, std::vector<llvm::Value*>& ptse
     return containsUnknown;
 }
 
-static std::set<PSNode *>
-gatherReachableObjects(dg::pta::PointerAnalysisFSInv::MemoryMapT *mm,
-                       const std::set<PSNode *>& from) {
-    // FIXME: use proper queue...
-    std::set<PSNode *> reachable = from;
-    std::set<PSNode *> queue = from;
+static inline bool isHeapObject(PSNode *obj) {
+    auto alloc = PSNodeAlloc::get(obj);
+    return alloc && alloc->isHeap();
+}
+
+///
+// Set the bit of the node in bits indexed by ids of nodes,
+// return false if it was set already
+static inline bool setNodeBit(llvm::BitVector& bits, const PSNode *node) {
+    unsigned id = node->getID();
+    if (id >= bits.size())
+        bits.resize(id + 1);
+    if (bits.test(id))
+        return false;
+    bits.set(id);
+    return true;
+}
+
+///
+// Return heap objects reachable in the memory map from the given objects
+static std::vector<PSNode *>
+gatherReachableHeapObjects(const MemoryMapT *mm,
+                           const std::vector<PSNode *>& from,
+                           unsigned nodesNum) {
+    std::vector<PSNode *> heap;
+    llvm::BitVector reached(nodesNum);
+    // FIFO worklist, objects before head were processed
+    std::vector<PSNode *> queue;
+    for (PSNode *obj : from) {
+        if (setNodeBit(reached, obj))
+            queue.push_back(obj);
+    }
 
-    while (!queue.empty()) {
-        PSNode *obj = *queue.begin();
-        queue.erase(queue.begin());
+    for (size_t head = 0; head < queue.size(); ++head) {
+        PSNode *obj = queue[head];
+        if (isHeapObject(obj))
+            heap.push_back(obj);
 
         auto it = mm->find(obj);
         if (it == mm->end())
             continue;
 
-        auto *memobj = it->second.get();
-        for (auto& ptit : *memobj) {
+        for (auto& ptit : *(it->second.get())) {
             for (const auto& ptr : ptit.second) {
-                if (reachable.insert(ptr.target).second) {
-                    queue.insert(ptr.target);
-                }
+                if (setNodeBit(reached, ptr.target))
+                    queue.push_back(ptr.target);
             }
         }
     }
-    return reachable;
+    return heap;
 }
 
-static std::set<PSNode *>
-overwrittenObjects(dg::pta::PointerAnalysisFSInv::MemoryMapT *pm,
-                   dg::pta::PointerAnalysisFSInv::MemoryMapT *mm) {
-    std::set<PSNode *> missing;
+///
+// Return objects whose pointers in pm are not in mm anymore
+// (and targets of these pointers)
+static std::vector<PSNode *>
+overwrittenObjects(const MemoryMapT *pm, const MemoryMapT *mm,
+                   unsigned nodesNum) {
+    std::vector<PSNode *> missing;
+    llvm::BitVector added(nodesNum);
     for (auto &pit : *pm) {
         auto it = mm->find(pit.first);
         if (it == mm->end()) {
-            missing.insert(pit.first);
+            if (setNodeBit(added, pit.first))
+                missing.push_back(pit.first);
             continue;
         }
         for (auto &pit2 : *(pit.second.get())) {
@@ -532,14 +625,16 @@ overwrittenObjects(dg::pta::PointerAnalysisFSInv::MemoryMapT *pm,
             auto it2 = it->second->find(off);
             if (it2 == it->second->end()) {
                 for (const auto& ptr : S) {
-                    missing.insert(ptr.target);
+                    if (setNodeBit(added, ptr.target))
+                        missing.push_back(ptr.target);
                 }
                 continue;
             }
 
             for (const auto& ptr : S) {
-                if (it2->second.count(ptr) == 0) {
-                    missing.insert(ptr.target);
+                if (it2->second.count(ptr) == 0 &&
+                    setNodeBit(added, ptr.target)) {
+                    missing.push_back(ptr.target);
                 }
             }
         }
@@ -547,49 +642,117 @@ overwrittenObjects(dg::pta::PointerAnalysisFSInv::MemoryMapT *pm,
     return missing;
 }
 
+///
+// Return objects of the memory map from which some heap object
+// is reachable, indexed by ids of nodes. Computed once for each
+// memory map by searching backwards from the heap objects.
+const llvm::BitVector& PointsToPlugin::getHeapReaching(const MemoryMapT *mm) {
+    auto found = heapReaching.find(mm);
+    if (found != heapReaching.end())
+        return found->second;
+
+    llvm::BitVector& reaching = heapReaching[mm];
+    reaching.resize(PTA->getNodes().size());
+
+    // objects that have pointers to the object
+    std::unordered_map<const PSNode *, std::vector<PSNode *>> pointedFrom;
+    // FIFO worklist, objects before head were processed
+    std::vector<PSNode *> queue;
+    auto addHeap = [&reaching, &queue](PSNode *obj) {
+        if (isHeapObject(obj) && setNodeBit(reaching, obj))
+            queue.push_back(obj);
+    };
+
+    for (auto& it : *mm) {
+        addHeap(it.first);
+        for (auto& ptit : *(it.second.get())) {
+            for (const auto& ptr : ptit.second) {
+                pointedFrom[ptr.target].push_back(it.first);
+                addHeap(ptr.target);
+            }
+        }
+    }
+
+    for (size_t head = 0; head < queue.size(); ++head) {
+        auto it = pointedFrom.find(queue[head]);
+        if (it == pointedFrom.end())
+            continue;
+        for (PSNode *obj : it->second) {
+            if (setNodeBit(reaching, obj))
+                queue.push_back(obj);
+        }
+    }
+
+    return reaching;
+}
+
 ///
 // Return true if this store may cause loosing the last
 // reference to some heap allocated memory
-std::string PointsToPlugin::storeMayLeak(llvm::Value *v) {
+QueryResult PointsToPlugin::storeMayLeak(llvm::Value *v) {
     auto SI = llvm::dyn_cast<llvm::StoreInst>(v);
     if (!SI) {
         assert(false && "Called not on store");
-        return "false";
+        return QueryResult::False;
     }
 
+    auto found = storeLeaks.find(SI);
+    if (found != storeLeaks.end())
+        return found->second;
+
+    QueryResult result = computeStoreMayLeak(SI);
+    storeLeaks.emplace(SI, result);
+    return result;
+}
+
+QueryResult PointsToPlugin::computeStoreMayLeak(llvm::StoreInst *SI) {
+    if (flowInsensitive)
+        return QueryResult::Maybe;
+
     PSNode *snode = PTA->getPointsToNode(SI);
     if (!snode || snode->pointsTo.hasUnknown()) {
-        return "maybe";
+        return QueryResult::Maybe;
     }
 
-    auto mm = snode->getData<dg::pta::PointerAnalysisFSInv::MemoryMapT>();
+    auto mm = snode->getData<MemoryMapT>();
     if (!mm) {
-        return "maybe";
+        return QueryResult::Maybe;
     }
 
+    unsigned nodesNum = PTA->getNodes().size();
     for (auto *pred : snode->predecessors()) {
-        auto pm = pred->getData<dg::pta::PointerAnalysisFSInv::MemoryMapT>();
+        auto pm = pred->getData<MemoryMapT>();
         if (!pm) {
-            return "maybe";
-        }
-
-        auto missing = overwrittenObjects(pm, mm);
-        auto leaked = gatherReachableObjects(pm, missing);
-        for (auto *obj : leaked) {
-            auto alloc = PSNodeAlloc::get(obj);
-            if (alloc && alloc->isHeap()) {
-               //llvm::errs() << "Leaking store:" << *SI << "\n";
-               //llvm::errs() << "leaking: "
-               //             << *alloc->getUserData<llvm::Value>() << "\n";
-                possiblyLeaked.insert(obj);
-                return "true";
-            }
+            return QueryResult::Maybe;
+        }
+
+        const llvm::BitVector& reaching = getHeapReaching(pm);
+        std::vector<PSNode *> leaking;
+        for (PSNode *obj : overwrittenObjects(pm, mm, nodesNum)) {
+            if (obj->getID() < reaching.size() && reaching.test(obj->getID()))
+                leaking.push_back(obj);
+        }
+
+        if (!leaking.empty()) {
+            //llvm::errs() << "Leaking store:" << *SI << "\n";
+            for (PSNode *obj : gatherReachableHeapObjects(pm, leaking, nodesNum))
+                markPossiblyLeaked(obj);
+            return QueryResult::True;
         }
     }
 
-    return "false";
+    return QueryResult::False;
+}
+
+void PointsToPlugin::markPossiblyLeaked(const PSNode *obj) {
+    if (setNodeBit(possiblyLeaked, obj))
+        ++possiblyLeakedNum;
 }
 
+bool PointsToPlugin::isPossiblyLeaked(const PSNode *obj) const {
+    return obj->getID() < possiblyLeaked.size() &&
+           possiblyLeaked.test(obj->getID());
+}
 
 void PointsToPlugin::gatherPossiblyLeaked(llvm::Instruction *I) {
     PSNode *ret = PTA->getPointsToNode(I);
@@ -598,7 +761,7 @@ void PointsToPlugin::gatherPossiblyLeaked(llvm::Instruction *I) {
         return;
     }
 
-    auto mm = ret->getData<dg::pta::PointerAnalysisFSInv::MemoryMapT>();
+    auto mm = ret->getData<MemoryMapT>();
     if (!mm) {
         allMayBeLeaked = true;
         return;
@@ -610,9 +773,8 @@ void PointsToPlugin::gatherPossiblyLeaked(llvm::Instruction *I) {
     for (auto& it : *mm) {
         for (auto& ptrs : *(it.second.get())) {
             for (const auto &ptr : ptrs.second) {
-                const auto alloc = PSNodeAlloc::get(ptr.target);
-                if (alloc && alloc->isHeap()) {
-                    possiblyLeaked.insert(alloc);
+                if (isHeapObject(ptr.target)) {
+                    markPossiblyLeaked(ptr.target);
                 }
             }
         }
@@ -620,6 +782,7 @@ void PointsToPlugin::gatherPossiblyLeaked(llvm::Instruction *I) {
 }
 
 void PointsToPlugin::gatherPossiblyLeaked(llvm::Module *) {
+    possiblyLeaked.resize(PTA->getNodes().size());
     for (auto &nodeptr : PTA->getNodes()) {
         if (!nodeptr)
             continue;
@@ -629,7 +792,8 @@ void PointsToPlugin::gatherPossiblyLeaked(llvm::Module *) {
                 continue;
             gatherPossiblyLeaked(llvm::cast<llvm::Instruction>(val));
             if (allMayBeLeaked) {
-                possiblyLeaked.clear();
+                possiblyLeaked.reset();
+                possiblyLeakedNum = 0;
                 return;
             }
         }
@@ -644,9 +808,25 @@ static inline bool pointsToUnknownOrNull(const PSNode *node) {
     return true;
 }
 
-std::string PointsToPlugin::mayBeLeaked(llvm::Value* a) {
+///
+// Return true if a may point to an allocation gathered in possiblyLeaked,
+// these are only heap allocations, so other pointers are not searched
+bool PointsToPlugin::pointsToPossiblyLeaked(const llvm::Value* a,
+                                            const PointsToSummary& summary) {
+    if (!summary.is(PointsToSummary::HasHeap) || possiblyLeakedNum == 0)
+        return false;
+
+    for (const auto& ptr : PTA->getPointsToNode(a)->pointsTo) {
+        if (isPossiblyLeaked(ptr.target))
+            return true;
+    }
+
+    return false;
+}
+
+QueryResult PointsToPlugin::mayBeLeaked(llvm::Value* a) {
     if (llvm::isa<llvm::ConstantInt>(a)) {
-        return "false";
+        return QueryResult::False;
     }
 
     // assume that undefined functions
@@ -666,83 +846,72 @@ std::string PointsToPlugin::mayBeLeaked(llvm::Value* a) {
                 !name.equals("realloc") &&
                 !name.startswith("__VERIFIER_malloc") &&
                 !name.startswith("__VERIFIER_calloc")) {
-                return "false";
+                return QueryResult::False;
             }
         }
     }
 
     if (allMayBeLeaked) {
-        return "true";
+        return QueryResult::True;
     }
 
-    PSNode *psnode = PTA->getPointsToNode(a);
-    if (!psnode || psnode->pointsTo.empty()) {
-        return "true";
+    const PointsToSummary *summary = getSummary(a);
+    if (!summary) {
+        return QueryResult::True;
     }
 
     // a number, not a pointer
-    if (a->getType()->isIntegerTy() && pointsToUnknownOrNull(psnode)) {
-        return "false";
+    if (a->getType()->isIntegerTy() &&
+        pointsToUnknownOrNull(PTA->getPointsToNode(a))) {
+        return QueryResult::False;
     }
 
-    for (const auto& ptr : psnode->pointsTo) {
-        if (ptr.isInvalidated())
-            continue; // freed memory cannot be leaked
-        if (ptr.isUnknown()) {
-            return "true";
-        }
-        if (possiblyLeaked.count(ptr.target) > 0) {
-            return "true";
-        }
+    if (summary->is(PointsToSummary::HasUnknown)) {
+        return QueryResult::True;
     }
 
-    return "false";
+    // freed memory cannot be leaked, it is not in possiblyLeaked
+    if (pointsToPossiblyLeaked(a, *summary)) {
+        return QueryResult::True;
+    }
+
+    return QueryResult::False;
 }
 
-std::string PointsToPlugin::mayBeLeakedOrFreed(llvm::Value* a) {
+QueryResult PointsToPlugin::mayBeLeakedOrFreed(llvm::Value* a) {
     if (allMayBeLeaked) {
-        return "true";
+        return QueryResult::True;
     }
 
-    PSNode *psnode = PTA->getPointsToNode(a);
-    if (!psnode || psnode->pointsTo.empty())
-        return "true";
+    const PointsToSummary *summary = getSummary(a);
+    if (!summary)
+        return QueryResult::True;
 
-    for (const auto& ptr : psnode->pointsTo) {
-        if (ptr.isUnknown() || ptr.isInvalidated())
-            return "true";
-        if (possiblyLeaked.count(ptr.target) > 0)
-            return "true";
-    }
+    if (summary->is(PointsToSummary::HasUnknown) ||
+        summary->is(PointsToSummary::HasInvalidated))
+        return QueryResult::True;
+
+    if (pointsToPossiblyLeaked(a, *summary))
+        return QueryResult::True;
 
-    return "false";
+    return QueryResult::False;
 }
 
-std::string PointsToPlugin::safeForFree(llvm::Value* a) {
-    assert(PTA);
-    PSNode *psnode = PTA->getPointsToNode(a);
-    if (!psnode || psnode->pointsTo.empty()) {
+QueryResult PointsToPlugin::safeForFree(llvm::Value* a) {
+    const PointsToSummary *summary = getSummary(a);
+    if (!summary) {
         // llvm::errs() << "No points-to for " << *a << "\n";
         // we know nothing, it may be null
-        return "maybe";
+        return QueryResult::Maybe;
     }
 
-    for (const auto& ptr : psnode->pointsTo) {
-        if (ptr.offset != 0)
-            return "false";
-        if (ptr.isUnknown() || ptr.isInvalidated())
-            return "false";
-
-        if (auto alloc = PSNodeAlloc::get(ptr.target)) {
-            if (!alloc->isHeap())
-                return "false";
-        } else {
-            return "false";
-        }
-    }
+    // points only to beginnings of known memory on heap
+    if (summary->is(PointsToSummary::AllHeap) &&
+        summary->is(PointsToSummary::AllOffsetsKnown) &&
+        summary->max_offset == 0)
+        return QueryResult::True;
 
-    // points only to beginnings of known memory or to nullptr
-    return "true";
+    return QueryResult::False;
 }
 
 void PointsToPlugin::computeRecursiveFuns(llvm::Module *module) {
@@ -780,34 +949,219 @@ bool PointsToPlugin::isReachableFun(const llvm::Function *F) const {
 }
 
 
-static const std::string supportedQueries[] = {
-    "isValidPointer",
-    "pointsTo",
-    "hasKnownSize",
-    "hasKnownSizes",
-    "getPointerInfo",
-    "isNull",
-    "pointsToHeap",
-    "pointsToGlobal",
-    "pointsToStack",
-    "isInvalid",
-    "mayBeLeaked",
-    "mayBeLeakedOrFreed",
-    "safeForFree",
-    "storeMayLeak",
-    "pointsToSetsOverlap",
-};
-
-bool PointsToPlugin::supports(const std::string& query) {
-    for (unsigned idx = 0; idx < sizeof(supportedQueries)/sizeof(*supportedQueries); ++idx) {
-        if (query == supportedQueries[idx])
+// in the order of AnalysisType
+static const char *analysisNames[] = {"fi", "fs", "inv"};
+
+static std::string getAnalysisName(dg::LLVMPointerAnalysisOptions::AnalysisType type) {
+    return analysisNames[static_cast<unsigned>(type)];
+}
+
+static bool parseNumber(const std::string& value, double& number) {
+    char *end;
+    number = std::strtod(value.c_str(), &end);
+    return !value.empty() && *end == '\0' && number >= 0;
+}
+
+bool PointsToPlugin::setOption(const std::string& name, const std::string& value) {
+    double number;
+    if (name == "analysis") {
+        if (value == "auto") {
+            autoAnalysis = true;
             return true;
+        }
+        for (unsigned i = 0; i < sizeof(analysisNames) / sizeof(*analysisNames); ++i) {
+            if (value == analysisNames[i]) {
+                autoAnalysis = false;
+                analysisType = static_cast<AnalysisType>(i);
+                return true;
+            }
+        }
+        return false;
     }
 
-    return false;
+    if (!parseNumber(value, number))
+        return false;
+
+    if (name == "maxIterations")
+        maxIterations = number;
+    else if (name == "timeBudget")
+        timeBudget = number;
+    else if (name == "largeModule")
+        largeModule = number;
+    else
+        return false;
+
+    return true;
 }
 
-extern "C" InstrPlugin* create_object(llvm::Module* module) {
+///
+// Run the analysis of the given type, return false if it
+// reached the limit of iterations
+bool PointsToPlugin::runAnalysis(AnalysisType type,
+                                 std::unique_ptr<dg::DGLLVMPointerAnalysis>& result) {
+    llvm::errs() << "Running DG points-to analysis with "
+                 << getAnalysisName(type) << "...\n";
+
+    dg::LLVMPointerAnalysisOptions opts;
+    opts.analysisType = type;
+    opts.maxIterations = maxIterations;
+
+    result = std::unique_ptr<dg::DGLLVMPointerAnalysis>(new dg::DGLLVMPointerAnalysis(module, opts));
+    bool finished = result->run();
+    if (!finished) {
+        llvm::errs() << "DG PTA reached iteration threshold: "
+                     << maxIterations << " iterations\n";
+    }
+    return finished;
+}
+
+///
+// Choose the analysis by the size of the module: small modules are
+// analyzed with inv right away, large ones flow-insensitively first and
+// then with inv if the budget allows it. DG cannot be interrupted, so
+// the time budget only decides whether to start inv, inv is stopped by
+// the limit of iterations and its unfinished result is replaced by
+// the flow-insensitive one.
+void PointsToPlugin::runAutoAnalysis() {
+    // flow-sensitive analysis is usually several times slower
+    // than the flow-insensitive one
+    static const double slowdown = 4;
+
+    uint64_t instructions = 0;
+    for (const llvm::Function& F : *module) {
+        for (const llvm::BasicBlock& B : F)
+            instructions += B.size();
+    }
+
+    if (instructions <= largeModule) {
+        if (runAnalysis(AnalysisType::inv, PTA)) {
+            tier = "inv";
+            return;
+        }
+        runAnalysis(AnalysisType::fi, PTA);
+        tier = "fi (inv reached the limit of iterations)";
+        flowInsensitive = true;
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    runAnalysis(AnalysisType::fi, PTA);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    if (timeBudget > 0 && timeBudget - elapsed.count() < slowdown * elapsed.count()) {
+        tier = "fi (large module, no time left for inv)";
+        flowInsensitive = true;
+        return;
+    }
+
+    std::unique_ptr<dg::DGLLVMPointerAnalysis> precise;
+    if (runAnalysis(AnalysisType::inv, precise)) {
+        PTA = std::move(precise);
+        tier = "inv (after fi)";
+    } else {
+        tier = "fi (large module, inv reached the limit of iterations)";
+        flowInsensitive = true;
+    }
+}
+
+void PointsToPlugin::initialize() {
+    if (autoAnalysis) {
+        runAutoAnalysis();
+    } else {
+        tier = getAnalysisName(analysisType);
+        flowInsensitive = analysisType == AnalysisType::fi;
+        if (!runAnalysis(analysisType, PTA))
+            tier += " (reached the limit of iterations)";
+    }
+
+    computeSummaries();
+    // the flow-insensitive analysis keeps memory objects instead
+    // of memory maps in the nodes
+    if (flowInsensitive)
+        allMayBeLeaked = true;
+    else
+        gatherPossiblyLeaked(module);
+    computeRecursiveFuns(module);
+
+    llvm::errs() << "PTA " << tier << " done.\n";
+}
+
+void PointsToPlugin::bindQueries(const std::vector<std::string>& names) {
+    static const QueryHandlers<PointsToPlugin>::Entry entries[] = {
+        {"isValidPointer", [](PointsToPlugin& p, llvm::ArrayRef<llvm::Value*> operands) {
+            assert(operands.size() == 2 && "Wrong number of operands");
+            return p.isValidPointer(operands[0], operands[1]);
+        }},
+        {"pointsTo", [](PointsToPlugin& p, llvm::ArrayRef<llvm::Value*> operands) {
+            assert(operands.size() == 2 && "Wrong number of operands");
+            return p.pointsTo(operands[0], operands[1]);
+        }},
+        {"hasKnownSize", [](PointsToPlugin& p, llvm::ArrayRef<llvm::Value*> operands) {
+            assert(operands.size() == 1 && "Wrong number of operands");
+            return p.hasKnownSize(operands[0]);
+        }},
+        {"hasKnownSizes", [](PointsToPlugin& p, llvm::ArrayRef<llvm::Value*> operands) {
+            assert(operands.size() == 1 && "Wrong number of operands");
+            return p.hasKnownSizes(operands[0]);
+        }},
+        {"isNull", [](PointsToPlugin& p, llvm::ArrayRef<llvm::Value*> operands) {
+            assert(operands.size() == 1 && "Wrong number of operands");
+            return p.isNull(operands[0]);
+        }},
+        {"pointsToHeap", [](PointsToPlugin& p, llvm::ArrayRef<llvm::Value*> operands) {
+            assert(operands.size() == 1 && "Wrong number of operands");
+            return p.pointsToHeap(operands[0]);
+        }},
+        {"pointsToGlobal", [](PointsToPlugin& p, llvm::ArrayRef<llvm::Value*> operands) {
+            assert(operands.size() == 1 && "Wrong number of operands");
+            return p.pointsToGlobal(operands[0]);
+        }},
+        {"pointsToStack", [](PointsToPlugin& p, llvm::ArrayRef<llvm::Value*> operands) {
+            assert(operands.size() == 1 && "Wrong number of operands");
+            return p.pointsToStack(operands[0]);
+        }},
+        {"isInvalid", [](PointsToPlugin& p, llvm::ArrayRef<llvm::Value*> operands) {
+            assert(operands.size() == 1 && "Wrong number of operands");
+            return p.isInvalid(operands[0]);
+        }},
+        {"mayBeLeaked", [](PointsToPlugin& p, llvm::ArrayRef<llvm::Value*> operands) {
+            assert(operands.size() == 1 && "Wrong number of operands");
+            return p.mayBeLeaked(operands[0]);
+        }},
+        {"mayBeLeakedOrFreed", [](PointsToPlugin& p, llvm::ArrayRef<llvm::Value*> operands) {
+            assert(operands.size() == 1 && "Wrong number of operands");
+            return p.mayBeLeakedOrFreed(operands[0]);
+        }},
+        {"safeForFree", [](PointsToPlugin& p, llvm::ArrayRef<llvm::Value*> operands) {
+            assert(operands.size() == 1 && "Wrong number of operands");
+            return p.safeForFree(operands[0]);
+        }},
+        {"storeMayLeak", [](PointsToPlugin& p, llvm::ArrayRef<llvm::Value*> operands) {
+            assert(operands.size() == 1 && "Wrong number of operands");
+            return p.storeMayLeak(operands[0]);
+        }},
+        {"pointsToSetsOverlap", [](PointsToPlugin& p, llvm::ArrayRef<llvm::Value*> operands) {
+            assert(operands.size() == 2 && "Wrong number of operands");
+            return p.pointsToSetsOverlap(operands[0], operands[1]);
+        }},
+    };
+    handlers.bind(names, entries);
+
+    uncacheable.assign(names.size(), false);
+    stateChanging.assign(names.size(), false);
+    for (QueryId id = 0; id < names.size(); ++id) {
+        if (names[id] == "mayBeLeaked" || names[id] == "mayBeLeakedOrFreed")
+            uncacheable[id] = true;
+        if (names[id] == "storeMayLeak")
+            stateChanging[id] = true;
+    }
+}
+
+// DG builds its own graphs, the module is only read
+extern "C" const unsigned instr_plugin_capabilities = PluginReadsModuleOnly;
+
+extern "C" InstrPluginV2* create_object_v2(llvm::Module* module, unsigned version) {
+        if (version != INSTR_PLUGIN_ABI_VERSION)
+            return nullptr;
         auto *ptplugin = new PointsToPlugin(module);
         if (ptplugin->failed()) {
             delete ptplugin;
@@ -4,12 +4,17 @@
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Value.h>
 #include <llvm/IR/Constants.h>
+#include <llvm/ADT/BitVector.h>
+#include <llvm/ADT/SparseBitVector.h>
+#include <map>
 #include <tuple>
+#include <unordered_map>
 #include "instr_plugin.hpp"
 #include "dg/llvm/PointerAnalysis/PointerAnalysis.h"
 #include "dg/PointerAnalysis/PointerAnalysisFSInv.h"
 
 using dg::pta::PSNode;
+using MemoryMapT = dg::pta::PointerAnalysisFSInv::MemoryMapT;
 
 class PointerInfo
 {
@@ -54,30 +59,172 @@ private:
     uint64_t max_space = 0;
 };
 
-class PointsToPlugin : public InstrPlugin
+// What the points-to set of a node contains, computed once after
+// the analysis so that the queries do not go through the sets again
+class PointsToSummary
+{
+
+public:
+    enum Flags : uint16_t {
+        // the points-to set is not empty
+        Known = 1 << 0,
+        HasNull = 1 << 1,
+        HasUnknown = 1 << 2,
+        HasInvalidated = 1 << 3,
+        // some target is allocated on the heap
+        HasHeap = 1 << 4,
+        // all targets are allocated on the heap (stack, globals)
+        AllHeap = 1 << 5,
+        AllStack = 1 << 6,
+        AllGlobal = 1 << 7,
+        AllOffsetsKnown = 1 << 8,
+        AllNullOrInvalidated = 1 << 9,
+        // all pointers point to valid memory of known size
+        // with known offsets
+        AllSizesKnown = 1 << 10,
+        // all pointers have the same offset and size as the first one
+        SameSizes = 1 << 11
+    };
+
+    bool is(Flags flag) const { return flags & flag; }
+
+    uint16_t flags = 0;
+    // offset and size of the first pointer in the set
+    uint64_t offset = 0;
+    uint64_t size = 0;
+    // space is the size of the target minus the offset
+    uint64_t min_offset = 0;
+    uint64_t min_space = 0;
+    uint64_t max_offset = 0;
+    uint64_t max_space = 0;
+};
+
+// Points-to set as bitsets over dense ids that the plugin gives to targets
+// and to pairs (target, offset), so that sets are intersected and united
+// word by word. The unknown pointer is not in the bitsets.
+class PointsToBits
+{
+
+public:
+    // pointers with known offsets, ids of (target, offset)
+    llvm::SparseBitVector<> pointers;
+    // targets of all pointers
+    llvm::SparseBitVector<> targets;
+    // targets of pointers with unknown offsets
+    llvm::SparseBitVector<> unknownOffsetTargets;
+
+    // some pointer of this set and some pointer of the other set
+    // have the same target and the same or unknown offset
+    bool overlaps(const PointsToBits& other) const {
+        return pointers.intersects(other.pointers) ||
+               unknownOffsetTargets.intersects(other.targets) ||
+               targets.intersects(other.unknownOffsetTargets);
+    }
+
+    void add(const PointsToBits& other) {
+        pointers |= other.pointers;
+        targets |= other.targets;
+        unknownOffsetTargets |= other.unknownOffsetTargets;
+    }
+};
+
+// Union of points-to sets of remembered values, answers whether
+// pointsTo or pointsToSetsOverlap of some remembered value and another
+// value may be true without asking about each remembered value.
+class RememberedPointsTo
+{
+
+public:
+    // some value is remembered
+    bool any = false;
+    // some remembered value has no points-to node (pointsTo is maybe)
+    bool hasNoNode = false;
+    // some remembered value has empty points-to set or may point to
+    // unknown memory (pointsToSetsOverlap is maybe or true)
+    bool hasUnknownSet = false;
+    PointsToBits bits;
+};
+
+class PointsToPlugin : public InstrPluginV2
 {
 
 private:
+    typedef dg::LLVMPointerAnalysisOptions::AnalysisType AnalysisType;
+
+    QueryHandlers<PointsToPlugin> handlers;
+    // answers of the queries (indexed by ids) change while instrumenting,
+    // mayBeLeaked and mayBeLeakedOrFreed depend on possiblyLeaked
+    // that storeMayLeak adds to
+    std::vector<bool> uncacheable;
+    // storeMayLeak adds to possiblyLeaked (indexed by ids of queries)
+    std::vector<bool> stateChanging;
+    llvm::Module *module;
+    // options of the analysis, the option "analysis" is one of fi, fs,
+    // inv or auto (autoAnalysis, chooses the analysis by the size
+    // of the module and timeBudget)
+    AnalysisType analysisType = AnalysisType::inv;
+    bool autoAnalysis = false;
+    uint64_t maxIterations = 50000; // empirically set
+    // seconds, 0 is unlimited
+    double timeBudget = 0;
+    // modules with more instructions are analyzed flow-insensitively
+    // first in the auto mode
+    uint64_t largeModule = 100000;
+    // the analysis that produced the answers, for the statistics
+    std::string tier;
+    // the answers come from the flow-insensitive analysis, its nodes
+    // have no memory maps for the leak analysis
+    bool flowInsensitive = false;
     bool allMayBeLeaked = false;
-    // possibly leaked allocations
-    std::set<PSNode *> possiblyLeaked;
+    // possibly leaked allocations, indexed by ids of nodes
+    llvm::BitVector possiblyLeaked;
+    unsigned possiblyLeakedNum = 0;
+    // objects from which heap objects are reachable
+    // in a memory map, indexed by ids of nodes
+    std::unordered_map<const MemoryMapT *, llvm::BitVector> heapReaching;
+    // answers of storeMayLeak
+    std::unordered_map<const llvm::StoreInst *, QueryResult> storeLeaks;
     std::set<const llvm::Function *> recursiveFuns;
     std::unique_ptr<dg::DGLLVMPointerAnalysis> PTA;
+    // summaries of points-to sets indexed by ids of nodes
+    std::vector<PointsToSummary> summaries;
+    // summaries of nodes that PTA created after computeSummaries()
+    std::unordered_map<const PSNode *, PointsToSummary> lateSummaries;
+
+    // dense ids of targets and of pairs (target, offset),
+    // assigned when a set that contains them is converted to bits
+    std::map<const PSNode *, unsigned> targetIds;
+    std::map<std::pair<const PSNode *, uint64_t>, unsigned> pointerIds;
+    // ids of targets allocated by values
+    std::map<const llvm::Value *, std::vector<unsigned>> valueTargetIds;
+    std::unordered_map<const PSNode *, PointsToBits> bits;
 
-    std::string isNull(llvm::Value* a);
-    std::string isValidPointer(llvm::Value* a, llvm::Value *len);
-    std::string pointsTo(llvm::Value* a, llvm::Value *b);
-    std::string hasKnownSize(llvm::Value* a);
-    std::string hasKnownSizes(llvm::Value* a);
-    std::string isInvalid(llvm::Value* a);
-    std::string pointsToHeap(llvm::Value* a);
-    std::string pointsToStack(llvm::Value* a);
-    std::string pointsToGlobal(llvm::Value* a);
-    std::string mayBeLeaked(llvm::Value* a);
-    std::string mayBeLeakedOrFreed(llvm::Value* a);
-    std::string safeForFree(llvm::Value* a);
-    std::string pointsToSetsOverlap(llvm::Value* a, llvm::Value *b);
-    std::string storeMayLeak(llvm::Value* S);
+    bool runAnalysis(AnalysisType type,
+                     std::unique_ptr<dg::DGLLVMPointerAnalysis>& result);
+    void runAutoAnalysis();
+    void computeSummaries();
+    const PointsToBits& getBits(const PSNode *node);
+    const PointsToSummary *getSummary(const llvm::Value* a);
+    bool pointsToPossiblyLeaked(const llvm::Value* a, const PointsToSummary& summary);
+
+    QueryResult isNull(llvm::Value* a);
+    QueryResult isValidPointer(llvm::Value* a, llvm::Value *len);
+    QueryResult pointsTo(llvm::Value* a, llvm::Value *b);
+    QueryResult hasKnownSize(llvm::Value* a);
+    QueryResult hasKnownSizes(llvm::Value* a);
+    QueryResult isInvalid(llvm::Value* a);
+    QueryResult pointsToHeap(llvm::Value* a);
+    QueryResult pointsToStack(llvm::Value* a);
+    QueryResult pointsToGlobal(llvm::Value* a);
+    QueryResult mayBeLeaked(llvm::Value* a);
+    QueryResult mayBeLeakedOrFreed(llvm::Value* a);
+    QueryResult safeForFree(llvm::Value* a);
+    QueryResult pointsToSetsOverlap(llvm::Value* a, llvm::Value *b);
+    QueryResult storeMayLeak(llvm::Value* S);
+    QueryResult computeStoreMayLeak(llvm::StoreInst* SI);
+    const llvm::BitVector& getHeapReaching(const MemoryMapT *mm);
+    void markPossiblyLeaked(const PSNode *obj);
+    bool isPossiblyLeaked(const PSNode *obj) const;
 
     void gatherPossiblyLeaked(llvm::Module *);
     void gatherPossiblyLeaked(llvm::Instruction *);
@@ -86,55 +233,22 @@ private:
     bool isRecursive(const llvm::Function *F);
 
 public:
-    bool supports(const std::string& query) override;
-    std::string query(const std::string& query,
-                      const std::vector<llvm::Value *>& operands) override
+    void bindQueries(const std::vector<std::string>& names) override;
+    bool supports(QueryId query) const override {
+        return handlers.supports(query);
+    }
+    QueryResult query(QueryId query,
+                      llvm::ArrayRef<llvm::Value *> operands) override
     {
-        if (query == "isValidPointer") {
-            assert(operands.size() == 2 && "Wrong number of operands");
-            return isValidPointer(operands[0], operands[1]);
-        } else if (query == "pointsTo") {
-            assert(operands.size() == 2 && "Wrong number of operands");
-            return pointsTo(operands[0], operands[1]);
-        } else if (query == "hasKnownSize") {
-            assert(operands.size() == 1 && "Wrong number of operands");
-            return hasKnownSize(operands[0]);
-        } else if (query == "hasKnownSizes") {
-            assert(operands.size() == 1 && "Wrong number of operands");
-            return hasKnownSizes(operands[0]);
-        } else if (query == "isNull") {
-            assert(operands.size() == 1 && "Wrong number of operands");
-            return isNull(operands[0]);
-        } else if (query == "pointsToHeap") {
-            assert(operands.size() == 1 && "Wrong number of operands");
-            return pointsToHeap(operands[0]);
-        } else if (query == "pointsToGlobal") {
-            assert(operands.size() == 1 && "Wrong number of operands");
-            return pointsToGlobal(operands[0]);
-        } else if (query == "pointsToStack") {
-            assert(operands.size() == 1 && "Wrong number of operands");
-            return pointsToStack(operands[0]);
-        } else if (query == "isInvalid") {
-            assert(operands.size() == 1 && "Wrong number of operands");
-            return isInvalid(operands[0]);
-        } else if (query == "mayBeLeaked") {
-            assert(operands.size() == 1 && "Wrong number of operands");
-            return mayBeLeaked(operands[0]);
-        } else if (query == "mayBeLeakedOrFreed") {
-            assert(operands.size() == 1 && "Wrong number of operands");
-            return mayBeLeakedOrFreed(operands[0]);
-        } else if (query == "safeForFree") {
-            assert(operands.size() == 1 && "Wrong number of operands");
-            return safeForFree(operands[0]);
-        } else if (query == "storeMayLeak") {
-            assert(operands.size() == 1 && "Wrong number of operands");
-            return storeMayLeak(operands[0]);
-        } else if (query == "pointsToSetsOverlap") {
-            assert(operands.size() == 2 && "Wrong number of operands");
-            return pointsToSetsOverlap(operands[0], operands[1]);
-        } else {
-            return "unsupported query";
-        }
+        return handlers.answer(*this, query, operands);
+    }
+
+    bool isCacheable(QueryId query) const override {
+        return query >= uncacheable.size() || !uncacheable[query];
+    }
+
+    bool changesState(QueryId query) const override {
+        return query < stateChanging.size() && stateChanging[query];
     }
 
     // must be virtual since it is called from the main binary
@@ -148,28 +262,25 @@ public:
                                         std::vector<llvm::Value*>& ptset);
     virtual std::string notMinMemoryBlock(llvm::Value* min, llvm::Value* a);
 
-    bool failed() const { return false; }
+    // Adds the points-to set of the value to the remembered sets
+    virtual void remember(llvm::Value* a, RememberedPointsTo& remembered);
+    // Whether pointsTo(v, a) may be true (true or maybe)
+    // for some remembered value v
+    virtual bool mayBePointedToByRemembered(llvm::Value* a,
+                                            const RememberedPointsTo& remembered);
+    // Whether pointsToSetsOverlap(v, a) may be true (true or maybe)
+    // for some remembered value v
+    virtual bool mayOverlapRemembered(llvm::Value* a,
+                                      const RememberedPointsTo& remembered);
 
-    PointsToPlugin(llvm::Module* module) : InstrPlugin("PointsTo") {
-        llvm::errs() << "Running DG points-to analysis with inv...\n";
-
-        dg::LLVMPointerAnalysisOptions opts;
-        opts.analysisType = dg::LLVMPointerAnalysisOptions::AnalysisType::inv;
-        opts.maxIterations = 50000; // empirically set
-
-        PTA = std::unique_ptr<dg::DGLLVMPointerAnalysis>(new dg::DGLLVMPointerAnalysis(module, opts));
-        bool finished = PTA->run();
-        if (!finished) {
-            llvm::errs() << "DG PTA reached iteration threshold: "
-                         << opts.maxIterations << " iterations\n";
-            // is this a fail?
-        }
+    bool failed() const { return false; }
 
-        gatherPossiblyLeaked(module);
-        computeRecursiveFuns(module);
+    PointsToPlugin(llvm::Module* module)
+        : InstrPluginV2("PointsTo"), module(module) {}
 
-        llvm::errs() << "PTA inv done.\n";
-    }
+    bool setOption(const std::string& name, const std::string& value) override;
+    void initialize() override;
+    std::string getStatistics() const override { return "points-to analysis " + tier; }
 };
 
 #endif
@@ -3,67 +3,69 @@
 
 using namespace llvm;
 
-std::string InfiniteLoopsPlugin::handleUnconditional(const BranchInst* br) {
+QueryResult InfiniteLoopsPlugin::handleUnconditional(const BranchInst* br) {
     BasicBlock* bb = br->getSuccessor(0);
 
     if (!bb)
-        return "unknown";
+        return QueryResult::Unknown;
 
     for (Instruction& succ : *bb) {
         if (isa<CallInst>(succ))
-            return "unknown";
+            return QueryResult::Unknown;
 
         if (isa<ReturnInst>(succ))
-            return "unknown";
+            return QueryResult::Unknown;
 
         if (isa<SwitchInst>(succ))
-            return "unknown";
+            return QueryResult::Unknown;
 
         auto* bs = dyn_cast<BranchInst>(&succ);
 
         if (bs && bs->isConditional())
-            return "unknown";
+            return QueryResult::Unknown;
 
         if (bs && bs->isUnconditional() &&
                   bs->getOperand(0) == br->getOperand(0))
-            return "true";
+            return QueryResult::True;
         else if (bs && bs->isConditional())
-            return "unknown";
+            return QueryResult::Unknown;
     }
-    return "unknown";
+    return QueryResult::Unknown;
 }
 
-std::string InfiniteLoopsPlugin::handleConditional(const BranchInst* /*br*/) {
-    return "unknown";
+QueryResult InfiniteLoopsPlugin::handleConditional(const BranchInst* /*br*/) {
+    return QueryResult::Unknown;
 }
 
-std::string InfiniteLoopsPlugin::isInfinite(Value* value) {
+QueryResult InfiniteLoopsPlugin::isInfinite(Value* value) {
     // Support only branch instructions
     auto* inst = dyn_cast<BranchInst>(value);
     if (!inst)
-        return "unknown";
+        return QueryResult::Unknown;
 
     if (inst->isUnconditional())
         return handleUnconditional(inst);
     else
         return handleConditional(inst);
 
-    return "unknown";
+    return QueryResult::Unknown;
 }
 
-static const std::string supportedQueries[] = {
-    "isInfinite",
-};
-
-bool InfiniteLoopsPlugin::supports(const std::string& query) {
-    for (unsigned idx = 0; idx < sizeof(supportedQueries)/sizeof(*supportedQueries); ++idx) {
-        if (query == supportedQueries[idx])
-            return true;
-    }
-
-    return false;
+void InfiniteLoopsPlugin::bindQueries(const std::vector<std::string>& names) {
+    static const QueryHandlers<InfiniteLoopsPlugin>::Entry entries[] = {
+        {"isInfinite", [](InfiniteLoopsPlugin& p, ArrayRef<Value*> operands) {
+            assert(operands.size() == 1 && "Wrong number of operands");
+            return p.isInfinite(operands[0]);
+        }},
+    };
+    handlers.bind(names, entries);
 }
 
-extern "C" InstrPlugin* create_object(llvm::Module* module) {
+// queries are answered directly from the instructions
+extern "C" const unsigned instr_plugin_capabilities = PluginReadsModuleOnly;
+
+extern "C" InstrPluginV2* create_object_v2(llvm::Module* module, unsigned version) {
+    if (version != INSTR_PLUGIN_ABI_VERSION)
+        return nullptr;
     return new InfiniteLoopsPlugin(module);
 }
@@ -7,29 +7,29 @@
 #include "llvm/IR/Instructions.h"
 #include "instr_plugin.hpp"
 
-class InfiniteLoopsPlugin : public InstrPlugin
+class InfiniteLoopsPlugin : public InstrPluginV2
 {
 private:
-    std::string isInfinite(llvm::Value*);
-    std::string handleConditional(const llvm::BranchInst*);
-    std::string handleUnconditional(const llvm::BranchInst*);
+    QueryHandlers<InfiniteLoopsPlugin> handlers;
+
+    QueryResult isInfinite(llvm::Value*);
+    QueryResult handleConditional(const llvm::BranchInst*);
+    QueryResult handleUnconditional(const llvm::BranchInst*);
 
 public:
-    bool supports(const std::string& query) override;
-    std::string query(const std::string& query,
-            const std::vector<llvm::Value *>& operands) override
+    void bindQueries(const std::vector<std::string>& names) override;
+    bool supports(QueryId query) const override {
+        return handlers.supports(query);
+    }
+    bool isThreadSafe() const override { return true; }
+    QueryResult query(QueryId query,
+                      llvm::ArrayRef<llvm::Value *> operands) override
     {
-        if (query == "isInfinite") {
-            assert(operands.size() == 1 && "Wrong number of operands");
-            return isInfinite(operands[0]);
-        } else {
-            return "unsupported query";
-        }
+        return handlers.answer(*this, query, operands);
     }
 
     InfiniteLoopsPlugin(llvm::Module* /*module*/)
-        : InstrPlugin("InfiniteLoopsPlugin") {}
+        : InstrPluginV2("InfiniteLoopsPlugin") {}
 };
 
 #endif
-
@@ -10,21 +10,33 @@
 #include <llvm/IR/DebugInfoMetadata.h>
 #include <llvm/Support/raw_os_ostream.h>
 
+#include <cerrno>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <fstream>
-#include <sstream>
+#include <thread>
 #include <unordered_set>
 
-static const std::unordered_set<std::string> supportedQueries {
-    "isValidPointer",
-    "isInvalid",
-    "mayBeLeaked",
-    "mayBeLeakedOrFreed",
-    "safeForFree",
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+static const PredatorPlugin::Answers supportedQueries[] = {
+    {"isValidPointer", QueryResult::Maybe, QueryResult::True},
+    {"isInvalid", QueryResult::Maybe, QueryResult::False},
+    {"mayBeLeaked", QueryResult::True, QueryResult::False},
+    {"mayBeLeakedOrFreed", QueryResult::True, QueryResult::False},
+    {"safeForFree", QueryResult::Maybe, QueryResult::True},
 };
 
 
-extern "C" InstrPlugin* create_object(llvm::Module* module) {
+extern "C" InstrPluginV2* create_object_v2(llvm::Module* module, unsigned version) {
+    if (version != INSTR_PLUGIN_ABI_VERSION)
+        return nullptr;
     auto *plugin = new PredatorPlugin(module);
     if (plugin->failed()) {
         delete plugin;
@@ -33,52 +45,114 @@ extern "C" InstrPlugin* create_object(llvm::Module* module) {
     return plugin;
 }
 
-bool PredatorPlugin::someUserHasSomeErrorReport(const llvm::Value* operand) const {
-    for (const auto& user : operand->users()) {
-        if (auto* inst = llvm::dyn_cast_or_null<llvm::Instruction>(user)) {
-            // there cannot be error report for instruction without debug location
-            if (!inst->getDebugLoc())
-                continue;
-
-            const unsigned line = inst->getDebugLoc().getLine();
-            const unsigned col = inst->getDebugLoc().getCol();
-
-
-            if (errors.hasAnyReport(line, col)) {
-                return true;
-            }
+void PredatorPlugin::bindQueries(const std::vector<std::string>& names) {
+    queryAnswers.assign(names.size(), nullptr);
+    if (!started)
+        return;
 
+    for (QueryId id = 0; id < names.size(); ++id) {
+        for (const Answers& answers : supportedQueries) {
+            if (names[id] == answers.query)
+                queryAnswers[id] = &answers;
         }
     }
+}
 
-    return false;
+QueryResult PredatorPlugin::query(QueryId query,
+                                  llvm::ArrayRef<llvm::Value *> operands) {
+    assert(supports(query) && "Unsupported query");
+    assert(!operands.empty());
+    waitForPredator();
+    const Answers *answers = queryAnswers[query];
+    // Predator did not finish in time, every value may have an error
+    if (timedOut)
+        return answers->reported;
+    // Predator failed, the plugin cannot answer as if it was not loaded
+    if (!predatorSuccess)
+        return QueryResult::Unsupported;
+    return isReported(operands[0]) ? answers->reported : answers->clean;
 }
 
-bool PredatorPlugin::someUserHasErrorReport(const llvm::Value* operand, ErrorType et) const {
-    for (const auto& user : operand->users()) {
-        if (auto* inst = llvm::dyn_cast_or_null<llvm::Instruction>(user)) {
-            // there cannot be error report for instruction without debug location
-            if (!inst->getDebugLoc())
-                continue;
+void PredatorPlugin::queryBatch(llvm::MutableArrayRef<BatchQuery> queries) {
+    waitForPredator();
+    if (timedOut || !predatorSuccess) {
+        for (BatchQuery& q : queries) {
+            assert(supports(q.query) && "Unsupported query");
+            q.result = timedOut ? queryAnswers[q.query]->reported
+                                : QueryResult::Unsupported;
+        }
+        return;
+    }
 
-            const unsigned line = inst->getDebugLoc().getLine();
-            const unsigned col = inst->getDebugLoc().getCol();
+    for (BatchQuery& q : queries) {
+        assert(supports(q.query) && "Unsupported query");
+        assert(!q.operands.empty());
+        const Answers *answers = queryAnswers[q.query];
+        q.result = isReported(q.operands[0]) ? answers->reported : answers->clean;
+    }
+}
 
-            if (errors.hasReport(line, col, et)) {
-                return true;
+void PredatorPlugin::indexReportedValues(llvm::Module* mod) {
+    // a value has an error-reported user if it is an operand
+    // of an instruction at the location of the report
+    for (const llvm::Function& F : *mod) {
+        for (const llvm::BasicBlock& B : F) {
+            for (const llvm::Instruction& I : B) {
+                // there cannot be error report for instruction without debug location
+                if (!I.getDebugLoc())
+                    continue;
+
+                const unsigned line = I.getDebugLoc().getLine();
+                const unsigned col = I.getDebugLoc().getCol();
+                if (!errors.hasAnyReport(line, col))
+                    continue;
+
+                unsigned types = 0;
+                for (ErrorType et : {ErrorType::Invalid, ErrorType::Leak, ErrorType::Free}) {
+                    if (errors.hasReport(line, col, et))
+                        types |= errorTypeBit(et);
+                }
+                for (const llvm::Value *operand : I.operand_values())
+                    reportedValues[operand] |= types;
             }
-
         }
     }
+}
 
-    return false;
+bool PredatorPlugin::someUserHasSomeErrorReport(const llvm::Value* operand) const {
+    return reportedValues.find(operand) != reportedValues.end();
+}
+
+bool PredatorPlugin::someUserHasErrorReport(const llvm::Value* operand, ErrorType et) const {
+    auto it = reportedValues.find(operand);
+    return it != reportedValues.end() && (it->second & errorTypeBit(et));
 }
 
 void PredatorPlugin::runPredator(llvm::Module* mod) {
+    // the files are in a private directory, so that more instances
+    // of the plugin (or of the instrumenter) do not overwrite them
+    const char *tmp = std::getenv("TMPDIR");
+    std::string dirTemplate = std::string(tmp && *tmp ? tmp : "/tmp") + "/predator-XXXXXX";
+    std::vector<char> dir(dirTemplate.begin(), dirTemplate.end());
+    dir.push_back('\0');
+    if (!mkdtemp(dir.data())) {
+        llvm::errs() << "PredatorPlugin: failed to create a temporary directory: "
+                     << std::strerror(errno) << "\n";
+        return;
+    }
+    tempDir = dir.data();
+
+    const std::string input = tempDir + "/predator_in.bc";
+    const std::string output = tempDir + "/predator.log";
 
     // write module to aux file
     {
-        std::ofstream ofs("predator_in.bc");
+        std::ofstream ofs(input, std::ios::binary);
+        if (!ofs.is_open()) {
+            llvm::errs() << "PredatorPlugin: failed to write " << input << "\n";
+            removeTempFiles();
+            return;
+        }
         llvm::raw_os_ostream ostream(ofs);
 #if (LLVM_VERSION_MAJOR > 6)
         llvm::WriteBitcodeToFile(*mod, ostream);
@@ -88,24 +162,118 @@ void PredatorPlugin::runPredator(llvm::Module* mod) {
     }
 
     // build predator command
-    std::stringstream cmd;
-    cmd << "predator_wrapper.py --out predator.log ";
+    std::vector<std::string> args = {"predator_wrapper.py", "--out", output};
     if (mod->getDataLayout().getPointerSizeInBits() <= 32) {
-        cmd << "--32 ";
+        args.push_back("--32");
+    }
+    args.push_back(input);
+
+    std::vector<char *> argv;
+    std::string cmd;
+    for (std::string& arg : args) {
+        argv.push_back(&arg[0]);
+        cmd += (cmd.empty() ? "" : " ") + arg;
     }
-    cmd << "predator_in.bc ";
+    argv.push_back(nullptr);
+
+    // run predator on that file in its own process group,
+    // so that it can be killed together with its children
+    llvm::errs() << "|> " << cmd << "\n";
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP);
+    posix_spawnattr_setpgroup(&attr, 0);
+    int err = posix_spawnp(&predatorPid, argv[0], nullptr, &attr, argv.data(), environ);
+    posix_spawnattr_destroy(&attr);
+    if (err != 0) {
+        llvm::errs() << "PredatorPlugin: failed to run predator_wrapper.py: "
+                     << std::strerror(err) << "\n";
+        predatorPid = -1;
+        removeTempFiles();
+        return;
+    }
+
+    startTime = std::chrono::steady_clock::now();
+    started = true;
+}
 
-    // run predator on that file
-    auto str = cmd.str();
-    llvm::errs() << "|> " << str << "\n";
-    if (std::system(str.c_str()) != 0) {
-        llvm::errs() << "Predator wrapper finished with non-0 exit status\n";
-        predatorSuccess = false;
+void PredatorPlugin::waitForPredator() {
+    if (finished)
+        return;
+    finished = true;
+
+    int status = 0;
+    if (timeout == 0) {
+        while (waitpid(predatorPid, &status, 0) < 0 && errno == EINTR)
+            ;
+    } else {
+        auto deadline = startTime + std::chrono::seconds(timeout);
+        while (waitpid(predatorPid, &status, WNOHANG) == 0) {
+            if (std::chrono::steady_clock::now() >= deadline) {
+                kill(-predatorPid, SIGKILL);
+                waitpid(predatorPid, &status, 0);
+                timedOut = true;
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
     }
+    predatorPid = -1;
+
+    if (timedOut) {
+        llvm::errs() << "PredatorPlugin: Predator did not finish in " << timeout
+                     << " s, always saying \"maybe\"\n";
+    } else {
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            llvm::errs() << "Predator wrapper finished with non-0 exit status\n";
+        }
+        loadPredatorOutput();
+        if (predatorSuccess) {
+            addReportsForLineErrors(module);
+            indexReportedValues(module);
+        }
+    }
+    removeTempFiles();
+}
+
+void PredatorPlugin::removeTempFiles() {
+    if (tempDir.empty())
+        return;
+    std::remove((tempDir + "/predator_in.bc").c_str());
+    std::remove((tempDir + "/predator.log").c_str());
+    rmdir(tempDir.c_str());
+    tempDir.clear();
+}
+
+PredatorPlugin::~PredatorPlugin() {
+    // no query was asked, Predator is not needed anymore
+    if (predatorPid > 0) {
+        kill(-predatorPid, SIGKILL);
+        waitpid(predatorPid, nullptr, 0);
+    }
+    removeTempFiles();
+}
+
+bool PredatorPlugin::setOption(const std::string& name, const std::string& value) {
+    if (name == "timeout") {
+        char *end;
+        unsigned long number = std::strtoul(value.c_str(), &end, 10);
+        if (value.empty() || *end != '\0')
+            return false;
+        timeout = number;
+        return true;
+    }
+    return false;
+}
+
+std::string PredatorPlugin::getStatistics() const {
+    if (timedOut)
+        return "Predator timed out after " + std::to_string(timeout) + " s";
+    return "";
 }
 
 void PredatorPlugin::loadPredatorOutput() {
-    std::ifstream is("predator.log");
+    std::ifstream is(tempDir + "/predator.log");
     if (!is.is_open()) {
         llvm::errs() << "PredatorPlugin: failed to open file with predator output\n";
         return;
@@ -116,7 +284,7 @@ void PredatorPlugin::loadPredatorOutput() {
     predatorSuccess = (result == "ok");
 
     if (result != "ok") {
-        llvm::errs() << "PredatorPlugin: Predator failed with '" << result << "', always saying \"maybe\" \n";
+        llvm::errs() << "PredatorPlugin: Predator failed with '" << result << "', ignoring it\n";
         return;
     }
 
@@ -165,10 +333,6 @@ void PredatorPlugin::loadPredatorOutput() {
 
 }
 
-bool PredatorPlugin::supports(const std::string& query) {
-    return predatorSuccess && (supportedQueries.find(query) != supportedQueries.end());
-}
-
 void PredatorPlugin::addReportsForLineErrors(llvm::Module* mod) {
     for (unsigned lineNumber : lineOnlyErrors) {
         bool found = false;
@@ -1,16 +1,29 @@
 #ifndef PREDATOR_PLUGIN_H
 #define PREDATOR_PLUGIN_H
 
+#include <chrono>
+#include <string>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
+#include <sys/types.h>
+
 #include <llvm/IR/Module.h>
 #include <llvm/Support/raw_ostream.h>
 #include "instr_plugin.hpp"
 
-class PredatorPlugin : public InstrPlugin
+class PredatorPlugin : public InstrPluginV2
 {
+public:
+    // Answers of a query, depending on whether the queried value
+    // has some error report (or is dangerous)
+    struct Answers {
+        const char *query;
+        QueryResult reported;
+        QueryResult clean;
+    };
+
 private:
 
     enum class ErrorType {
@@ -83,6 +96,13 @@ private:
     ErrorContainer<ErrorReport, EnumClassHash> errors;
     std::vector<unsigned> lineOnlyErrors;
     std::unordered_set<const llvm::Value *> dangerous;
+    // values that have some user with an error report, mapped
+    // to the bits (errorTypeBit) of the types of the reports
+    std::unordered_map<const llvm::Value *, unsigned> reportedValues;
+
+    static unsigned errorTypeBit(ErrorType et) {
+        return 1u << static_cast<unsigned>(et);
+    }
 
     /**
      * Return true if any user of @operand has an associated error report of type @et
@@ -91,76 +111,61 @@ private:
     bool someUserHasSomeErrorReport(const llvm::Value* operand) const;
 
     void addReportsForLineErrors(llvm::Module* mod);
+    // fills reportedValues, the module is walked only once, so instructions
+    // added by the instrumentation later (with copied debug locations) are
+    // not taken as reported
+    void indexReportedValues(llvm::Module* mod);
 
     void loadPredatorOutput();
     void runPredator(llvm::Module* mod);
+    void waitForPredator();
+    void removeTempFiles();
 
     bool isDangerous(const llvm::Value* v) const {
         return dangerous.find(v) != dangerous.end();
     }
 
-    bool predatorSuccess;
+    llvm::Module *module;
+    // private directory with the input and the output of Predator
+    std::string tempDir;
+    // process of the wrapper (it has its own process group), -1 if there is none
+    pid_t predatorPid = -1;
+    std::chrono::steady_clock::time_point startTime;
+    // seconds from the start of Predator until the plugin stops waiting for it,
+    // 0 means no limit
+    unsigned timeout = 0;
+    bool started = false;
+    bool finished = false;
+    bool timedOut = false;
+    bool predatorSuccess = false;
+
+    // answers of supported queries indexed by ids of queries
+    std::vector<const Answers *> queryAnswers;
+
+    bool isReported(const llvm::Value* v) const {
+        return someUserHasSomeErrorReport(v) || isDangerous(v);
+    }
 
 public:
-    PredatorPlugin(llvm::Module* module) : InstrPlugin("Predator") {
-        predatorSuccess = false;
+    // Predator is started here and runs in the background,
+    // the plugin waits for it when it gets the first query
+    PredatorPlugin(llvm::Module* module) : InstrPluginV2("Predator"), module(module) {
         llvm::errs() << "PredatorPlugin: Running Predator...\n";
         runPredator(module);
-        loadPredatorOutput();
-        addReportsForLineErrors(module);
     }
 
-    bool failed() const { return !predatorSuccess; }
-    bool supports(const std::string& query) override;
-
-    std::string query(const std::string& query,
-                      const std::vector<llvm::Value *>& operands) override {
-
-        if (!predatorSuccess) {
-            return "maybe";
-        }
-
-        if (query == "isInvalid") {
-            assert(operands.size() == 1);
-            if (someUserHasSomeErrorReport(operands[0]) || isDangerous(operands[0])) {
-                return "maybe";
-            } else {
-                return "false";
-            }
-        } else if (query == "isValidPointer") {
-            assert(operands.size() == 2);
-            if (someUserHasSomeErrorReport(operands[0]) || isDangerous(operands[0])) {
-                return "maybe";
-            } else {
-                return "true";
-            }
-        } else if (query == "mayBeLeaked") {
-            assert(operands.size() == 1);
-            if (someUserHasSomeErrorReport(operands[0]) || isDangerous(operands[0])) {
-                return "true";
-            } else {
-                return "false";
-            }
-        } else if (query == "mayBeLeakedOrFreed") {
-            assert(operands.size() == 1);
-            if (someUserHasSomeErrorReport(operands[0]) || isDangerous(operands[0])) {
-                return "true";
-            } else {
-                return "false";
-            }
-        } else if (query == "safeForFree") {
-            assert(operands.size() == 1);
-            if (someUserHasSomeErrorReport(operands[0]) || isDangerous(operands[0])) {
-                return "maybe";
-            } else {
-                return "true";
-            }
-        }
-
-        return "unsupported query";
+    bool failed() const { return !started; }
+    bool setOption(const std::string& name, const std::string& value) override;
+    std::string getStatistics() const override;
+    void bindQueries(const std::vector<std::string>& names) override;
+    bool supports(QueryId query) const override {
+        return query < queryAnswers.size() && queryAnswers[query];
     }
+    QueryResult query(QueryId query,
+                      llvm::ArrayRef<llvm::Value *> operands) override;
+    void queryBatch(llvm::MutableArrayRef<BatchQuery> queries) override;
 
-    virtual ~PredatorPlugin() = default;
+    virtual ~PredatorPlugin();
 };
 
 
@@ -0,0 +1,1045 @@
+//===--------------------- CSRConstraintGraph.cpp -------------------------===//
+//===-- Solves the constraint graph of the range analysis on flat arrays --===//
+//
+// The operations on intervals and the meet operators below follow those
+// of RangeAnalysis.cpp, only the bounds are int64_t instead of APInt.
+//
+//===----------------------------------------------------------------------===//
+
+#include "CSRConstraintGraph.h"
+
+#include <algorithm>
+#include <tuple>
+
+using namespace llvm;
+
+// The helpers of Range::Or from RangeAnalysis.cpp
+int64_t minOR(int64_t a, int64_t b, int64_t c, int64_t d);
+int64_t maxOR(int64_t a, int64_t b, int64_t c, int64_t d);
+
+// String used to identify sigmas (as in RangeAnalysis.cpp)
+static const char *sigmaPrefix = "vSSA_sigma";
+
+const unsigned CSRConstraintGraph::NoOperation;
+
+// ========================================================================== //
+// IntervalKernel64
+// ========================================================================== //
+
+IntervalKernel64::IntervalKernel64(unsigned width) : width(width) {
+	assert(width > 0 && width <= 64 && "Unsupported bit width");
+	mask = width == 64 ? ~0ull : (1ull << width) - 1;
+	max = (int64_t)(mask >> 1);
+	min = -max - 1;
+}
+
+int64_t IntervalKernel64::wrap(uint64_t value) const {
+	if (width == 64)
+		return (int64_t)value;
+	unsigned shift = 64 - width;
+	return (int64_t)(value << shift) >> shift;
+}
+
+unsigned IntervalKernel64::shiftAmount(int64_t value) const {
+	uint64_t amount = toUnsigned(value);
+	return amount > width ? width : (unsigned)amount;
+}
+
+Interval64 IntervalKernel64::make(int64_t l, int64_t u, RangeType type) const {
+	Interval64 result = {l, u, type};
+	if (l > u)
+		result.type = Empty;
+	return result;
+}
+
+// Returns the lowest and the highest of the candidates as a range.
+static Interval64 minMax(const IntervalKernel64& K, const int64_t (&candidates)[4]) {
+	int64_t min = candidates[0];
+	int64_t max = candidates[0];
+
+	for (unsigned i = 1; i < 4; ++i) {
+		if (candidates[i] > max)
+			max = candidates[i];
+		else if (candidates[i] < min)
+			min = candidates[i];
+	}
+
+	return K.make(min, max);
+}
+
+Interval64 IntervalKernel64::add(const Interval64& a, const Interval64& b) const {
+	int64_t l = min, u = max;
+	if (a.l != min && b.l != min) {
+		l = wrap((uint64_t)a.l + (uint64_t)b.l);
+		if ((a.l < 0) == (b.l < 0) && (a.l < 0) != (l < 0))
+			l = min;
+	}
+
+	if (a.u != max && b.u != max) {
+		u = wrap((uint64_t)a.u + (uint64_t)b.u);
+		if ((a.u < 0) == (b.u < 0) && (a.u < 0) != (u < 0))
+			u = max;
+	}
+
+	return make(l, u);
+}
+
+Interval64 IntervalKernel64::sub(const Interval64& a, const Interval64& b) const {
+	int64_t l = (a.l == min || b.u == max) ? min : wrap((uint64_t)a.l - (uint64_t)b.u);
+	int64_t u = (a.u == max || b.l == min) ? max : wrap((uint64_t)a.u - (uint64_t)b.l);
+	return make(l, u);
+}
+
+/// One candidate of Range::mul, including the way the MUL_OV and MUL_HELPER
+/// macros expand there (the overflow check is skipped when x is Max).
+int64_t IntervalKernel64::mulCandidate(int64_t x, int64_t y) const {
+	int64_t xy;
+	if (x == max)
+		xy = y < 0 ? min : (y == 0 ? 0 : max);
+	else if (y == max)
+		xy = x < 0 ? min : (x == 0 ? 0 : max);
+	else if (x == min)
+		xy = y < 0 ? max : (y == 0 ? 0 : min);
+	else if (y == min)
+		xy = x < 0 ? max : (x == 0 ? 0 : min);
+	else
+		xy = wrap((uint64_t)x * (uint64_t)y);
+
+	if (x == max)
+		return xy;
+	if ((x > 0) == (y > 0))
+		return xy < 0 ? max : xy;
+	return xy > 0 ? min : xy;
+}
+
+Interval64 IntervalKernel64::mul(const Interval64& a, const Interval64& b) const {
+	if (isMaxRange(a) || isMaxRange(b))
+		return make(min, max);
+
+	int64_t candidates[4] = {
+		mulCandidate(a.l, b.l), mulCandidate(a.l, b.u),
+		mulCandidate(a.u, b.l), mulCandidate(a.u, b.u)
+	};
+	return minMax(*this, candidates);
+}
+
+Interval64 IntervalKernel64::udiv(const Interval64& a, const Interval64& b) const {
+	if (a.type == Empty || b.type == Empty || b.u == 0 || isMaxRange(b))
+		return make(min, max);
+
+	uint64_t lower = toUnsigned(a.l) / toUnsigned(b.u);
+	uint64_t bmin = toUnsigned(b.l);
+	if (bmin == 0)
+		bmin = 1;
+	uint64_t upper = toUnsigned(a.u) / bmin;
+
+	if (lower == upper)
+		return make(min, max);
+
+	return make(wrap(lower), wrap(upper));
+}
+
+// Signed division of numbers of the bit width, Min / -1 wraps as in APInt
+static int64_t sdivWrapped(int64_t x, int64_t y) {
+	if (y == -1)
+		return x == INT64_MIN ? x : -x;
+	return x / y;
+}
+
+Interval64 IntervalKernel64::sdiv(const Interval64& a, const Interval64& b) const {
+	if (a.type == Empty || b.type == Empty || b.u == 0 || isMaxRange(b))
+		return make(min, max);
+
+	int64_t lower = wrap(sdivWrapped(a.l, b.u));
+	int64_t bmin = b.l == 0 ? 1 : b.l;
+	int64_t upper = wrap(sdivWrapped(a.u, bmin));
+
+	if (lower == upper)
+		return make(min, max);
+
+	return make(lower, upper);
+}
+
+Interval64 IntervalKernel64::urem(const Interval64& a, const Interval64& b) const {
+	if (b.l == 0 || b.u == 0)
+		return make(min, max);
+
+	int64_t candidates[4] = {min, min, max, max};
+	if (a.l != min && b.l != min)
+		candidates[0] = wrap(toUnsigned(a.l) % toUnsigned(b.l));
+	if (a.l != min && b.u != max)
+		candidates[1] = wrap(toUnsigned(a.l) % toUnsigned(b.u));
+	if (a.u != max && b.l != min)
+		candidates[2] = wrap(toUnsigned(a.u) % toUnsigned(b.l));
+	if (a.u != max && b.u != max)
+		candidates[3] = wrap(toUnsigned(a.u) % toUnsigned(b.u));
+
+	return minMax(*this, candidates);
+}
+
+// Signed remainder, Min % -1 is 0 as in APInt
+static int64_t sremWrapped(int64_t x, int64_t y) {
+	if (y == -1)
+		return 0;
+	return x % y;
+}
+
+Interval64 IntervalKernel64::srem(const Interval64& a, const Interval64& b) const {
+	if (b == make(0, 0) || b == make(min, max, Empty))
+		return make(min, max, Empty);
+
+	if ((b.l < 0 && b.u > 0) || b.l == 0 || b.u == 0)
+		return make(min, max);
+
+	int64_t candidates[4] = {min, min, max, max};
+	if (a.l != min && b.l != min)
+		candidates[0] = sremWrapped(a.l, b.l);
+	if (a.l != min && b.u != max)
+		candidates[1] = sremWrapped(a.l, b.u);
+	if (a.u != max && b.l != min)
+		candidates[2] = sremWrapped(a.u, b.l);
+	if (a.u != max && b.u != max)
+		candidates[3] = sremWrapped(a.u, b.u);
+
+	return minMax(*this, candidates);
+}
+
+Interval64 IntervalKernel64::shl(const Interval64& a, const Interval64& b) const {
+	auto shift = [this](int64_t x, int64_t y) -> int64_t {
+		unsigned amount = shiftAmount(y);
+		return amount == width ? 0 : wrap((uint64_t)x << amount);
+	};
+
+	int64_t candidates[4] = {min, min, max, max};
+	if (a.l != min && b.l != min)
+		candidates[0] = shift(a.l, b.l);
+	if (a.l != min && b.u != max)
+		candidates[1] = shift(a.l, b.u);
+	if (a.u != max && b.l != min)
+		candidates[2] = shift(a.u, b.l);
+	if (a.u != max && b.u != max)
+		candidates[3] = shift(a.u, b.u);
+
+	return minMax(*this, candidates);
+}
+
+Interval64 IntervalKernel64::lshr(const Interval64& a, const Interval64& b) const {
+	// If any of the bounds is negative, result is [0, +inf] automatically
+	if (a.l < 0 || a.u < 0)
+		return make(0, max);
+
+	auto shift = [this](int64_t x, int64_t y) -> int64_t {
+		unsigned amount = shiftAmount(y);
+		return amount == width ? 0 : wrap(toUnsigned(x) >> amount);
+	};
+
+	int64_t candidates[4] = {min, min, max, max};
+	if (a.l != min && b.l != min)
+		candidates[0] = shift(a.l, b.l);
+	if (a.l != min && b.u != max)
+		candidates[1] = shift(a.l, b.u);
+	if (a.u != max && b.l != min)
+		candidates[2] = shift(a.u, b.l);
+	if (a.u != max && b.u != max)
+		candidates[3] = shift(a.u, b.u);
+
+	return minMax(*this, candidates);
+}
+
+Interval64 IntervalKernel64::ashr(const Interval64& a, const Interval64& b) const {
+	auto shift = [this](int64_t x, int64_t y) -> int64_t {
+		unsigned amount = shiftAmount(y);
+		if (amount == width)
+			return x < 0 ? -1 : 0;
+		return x >> amount;
+	};
+
+	int64_t candidates[4] = {min, min, max, max};
+	if (a.l != min && b.l != min)
+		candidates[0] = shift(a.l, b.l);
+	if (a.l != min && b.u != max)
+		candidates[1] = shift(a.l, b.u);
+	if (a.u != max && b.l != min)
+		candidates[2] = shift(a.u, b.l);
+	if (a.u != max && b.u != max)
+		candidates[3] = shift(a.u, b.u);
+
+	return minMax(*this, candidates);
+}
+
+Interval64 IntervalKernel64::And(const Interval64& a, const Interval64& b) const {
+	if (a.type == Empty || b.type == Empty)
+		return make(min, max, Empty);
+
+	uint64_t umin = std::min(toUnsigned(b.u), toUnsigned(a.u));
+	if (umin == mask)
+		return make(min, max);
+	return make(0, wrap(umin));
+}
+
+Interval64 IntervalKernel64::Or(const Interval64& a, const Interval64& b) const {
+	if (a.type == Unknown || b.type == Unknown)
+		return make(min, max, Unknown);
+
+	unsigned char switchval = 0;
+	switchval += (a.l >= 0 ? 1 : 0);
+	switchval <<= 1;
+	switchval += (a.u >= 0 ? 1 : 0);
+	switchval <<= 1;
+	switchval += (b.l >= 0 ? 1 : 0);
+	switchval <<= 1;
+	switchval += (b.u >= 0 ? 1 : 0);
+
+	int64_t l = min, u = max;
+
+	switch (switchval) {
+		case 0:
+		case 3:
+		case 12:
+		case 15:
+			l = wrap(minOR(a.l, a.u, b.l, b.u));
+			u = wrap(maxOR(a.l, a.u, b.l, b.u));
+			break;
+		case 1:
+			l = a.l;
+			u = -1;
+			break;
+		case 4:
+			l = b.l;
+			u = -1;
+			break;
+		case 5:
+			l = a.l < b.l ? a.l : b.l;
+			u = wrap(maxOR(0, a.u, 0, b.u));
+			break;
+		case 7:
+			l = wrap(minOR(a.l, 0xFFFFFFFF, b.l, b.u));
+			u = wrap(minOR(0, a.u, b.l, b.u));
+			break;
+		case 13:
+			l = wrap(minOR(a.l, a.u, b.l, 0xFFFFFFFF));
+			u = wrap(maxOR(a.l, a.u, 0, b.u));
+			break;
+	}
+
+	return make(l, u);
+}
+
+Interval64 IntervalKernel64::Xor(const Interval64& /*a*/, const Interval64& /*b*/) const {
+	return make(min, max);
+}
+
+Interval64 IntervalKernel64::truncate(const Interval64& a, unsigned bitwidth) const {
+	if (bitwidth == 0 || bitwidth > width)
+		bitwidth = width;
+	int64_t maxupper = (int64_t)((~0ull >> (64 - bitwidth)) >> 1);
+	int64_t maxlower = -maxupper - 1;
+
+	if (a.l >= maxlower && a.u <= maxupper)
+		return a;
+	return make(maxlower, maxupper);
+}
+
+Interval64 IntervalKernel64::zextOrTrunc(const Interval64& /*a*/, unsigned bitwidth) const {
+	if (bitwidth == 0 || bitwidth > width)
+		bitwidth = width;
+	int64_t maxupper = (int64_t)((~0ull >> (64 - bitwidth)) >> 1);
+	return make(-maxupper - 1, maxupper);
+}
+
+Interval64 IntervalKernel64::intersectWith(const Interval64& a, const Interval64& b) const {
+	if (a.type == Empty || b.type == Empty)
+		return make(min, max, Empty);
+
+	if (a.type == Unknown)
+		return b;
+
+	if (b.type == Unknown)
+		return a;
+
+	return make(std::max(a.l, b.l), std::min(a.u, b.u));
+}
+
+Interval64 IntervalKernel64::unionWith(const Interval64& a, const Interval64& b) const {
+	if (a.type == Empty)
+		return b;
+
+	if (b.type == Empty)
+		return a;
+
+	if (a.type == Unknown)
+		return b;
+
+	if (b.type == Unknown)
+		return a;
+
+	return make(std::min(a.l, b.l), std::max(a.u, b.u));
+}
+
+Interval64 IntervalKernel64::fromRange(const Range& r) const {
+	RangeType type = r.isRegular() ? Regular : (r.isEmpty() ? Empty : Unknown);
+	Interval64 result = {r.getLower().getSExtValue(), r.getUpper().getSExtValue(), type};
+	return result;
+}
+
+Range IntervalKernel64::toRange(const Interval64& a) const {
+	Range r(APInt(width, a.l, true), APInt(width, a.u, true));
+	if (a.type == Unknown)
+		r.setUnknown();
+	else if (a.type == Empty)
+		r.setEmpty();
+	else
+		r.setRegular();
+	return r;
+}
+
+// ========================================================================== //
+// CSRConstraintGraph
+// ========================================================================== //
+
+CSRConstraintGraph::CSRConstraintGraph(ConstraintGraph& CG, const Function& F,
+		unsigned bitWidth) :
+		kernel(bitWidth > 64 ? 64 : bitWidth), valid(bitWidth <= 64) {
+	if (!valid)
+		return;
+
+	// Number the variables in the order of the function, so that the solution
+	// does not depend on the addresses of the values.
+	DenseMap<const Value*, unsigned> index;
+	auto addVar = [&](const Value *V) {
+		VarNodes::iterator vit = CG.vars.find(V);
+		if (vit == CG.vars.end() || index.count(V))
+			return;
+		index[V] = nodes.size();
+		nodes.push_back(vit->second);
+	};
+
+	for (const Argument& A : F.args())
+		addVar(&A);
+	for (const_inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I) {
+		addVar(&*I);
+		for (const Value *op : I->operands())
+			addVar(op);
+	}
+	for (VarNodes::iterator vit = CG.vars.begin(), vend = CG.vars.end();
+			vit != vend; ++vit) {
+		addVar(vit->first);
+	}
+
+	auto hasWidth = [this](const Range& r) {
+		return r.getLower().getBitWidth() == kernel.getWidth() &&
+		       r.getUpper().getBitWidth() == kernel.getWidth();
+	};
+
+	for (VarNode *node : nodes) {
+		Range r = node->getRange();
+		if (!hasWidth(r)) {
+			valid = false;
+			return;
+		}
+		const Value *V = node->getValue();
+		ranges.push_back(kernel.fromRange(r));
+		constant.push_back(isa<ConstantInt>(V));
+		sigmaName.push_back(V->getName().startswith(sigmaPrefix));
+	}
+
+	// Order the operations by their sinks
+	std::vector<std::tuple<unsigned, unsigned, BasicOp*>> sorted;
+	for (GenOprs::iterator oit = CG.oprs.begin(), oend = CG.oprs.end();
+			oit != oend; ++oit) {
+		BasicOp *op = *oit;
+		const VarNode *first = NULL;
+		if (const UnaryOp *uop = dyn_cast<UnaryOp>(op))
+			first = uop->getSource();
+		else if (const BinaryOp *bop = dyn_cast<BinaryOp>(op))
+			first = bop->getSource1();
+		else if (const PhiOp *pop = dyn_cast<PhiOp>(op))
+			first = pop->getNumSources() > 0 ? pop->getSource(0) : NULL;
+
+		if (!first || !index.count(first->getValue()) ||
+				!index.count(op->getSink()->getValue())) {
+			valid = false;
+			return;
+		}
+		sorted.emplace_back(index[op->getSink()->getValue()],
+				index[first->getValue()], op);
+	}
+	std::stable_sort(sorted.begin(), sorted.end(),
+			[](const std::tuple<unsigned, unsigned, BasicOp*>& a,
+			   const std::tuple<unsigned, unsigned, BasicOp*>& b) {
+		return std::get<0>(a) < std::get<0>(b) ||
+		       (std::get<0>(a) == std::get<0>(b) && std::get<1>(a) < std::get<1>(b));
+	});
+
+	DenseMap<const BasicOp*, unsigned> opIndex;
+	for (const auto& entry : sorted) {
+		BasicOp *bop = std::get<2>(entry);
+		Operation op;
+		op.unresolved = false;
+		op.opcode = 0;
+		op.sink = std::get<0>(entry);
+		op.sinkBits = bop->getSink()->getValue()->getType()->getPrimitiveSizeInBits();
+		op.source1 = op.source2 = 0;
+		op.firstSource = op.endSource = 0;
+		op.bound = -1;
+		op.pred = CmpInst::BAD_ICMP_PREDICATE;
+
+		if (const SigmaOp *sop = dyn_cast<SigmaOp>(bop)) {
+			op.kind = SigmaKind;
+			op.opcode = sop->getOpcode();
+			op.source1 = index[sop->getSource()->getValue()];
+			op.unresolved = sop->isUnresolved();
+		} else if (const UnaryOp *uop = dyn_cast<UnaryOp>(bop)) {
+			op.kind = UnaryKind;
+			op.opcode = uop->getOpcode();
+			op.source1 = index[uop->getSource()->getValue()];
+		} else if (const BinaryOp *binop = dyn_cast<BinaryOp>(bop)) {
+			op.kind = BinaryKind;
+			op.opcode = binop->getOpcode();
+			if (!index.count(binop->getSource2()->getValue())) {
+				valid = false;
+				return;
+			}
+			op.source1 = index[binop->getSource1()->getValue()];
+			op.source2 = index[binop->getSource2()->getValue()];
+		} else {
+			const PhiOp *pop = cast<PhiOp>(bop);
+			op.kind = PhiKind;
+			op.firstSource = phiSources.size();
+			for (unsigned i = 0, e = pop->getNumSources(); i < e; ++i) {
+				const Value *V = pop->getSource(i)->getValue();
+				if (!index.count(V)) {
+					valid = false;
+					return;
+				}
+				phiSources.push_back(index[V]);
+			}
+			op.endSource = phiSources.size();
+		}
+
+		const BasicInterval *intersect = bop->getIntersect();
+		if (!hasWidth(intersect->getRange())) {
+			valid = false;
+			return;
+		}
+		if (const SymbInterval *SI = dyn_cast<SymbInterval>(intersect)) {
+			if (!index.count(SI->getBound())) {
+				valid = false;
+				return;
+			}
+			op.bound = index[SI->getBound()];
+			op.pred = SI->getOperation();
+		}
+
+		opIndex[bop] = ops.size();
+		basicOps.push_back(bop);
+		ops.push_back(op);
+		intersects.push_back(kernel.fromRange(intersect->getRange()));
+	}
+
+	DefMap *defMap = CG.getDefMap();
+	defs.assign(nodes.size(), NoOperation);
+	for (unsigned i = 0, e = nodes.size(); i < e; ++i) {
+		DefMap::iterator dit = defMap->find(nodes[i]->getValue());
+		if (dit != defMap->end() && opIndex.count(dit->second))
+			defs[i] = opIndex[dit->second];
+	}
+
+	buildUses();
+}
+
+/// Builds the lists of uses of the variables. An operation is in the list
+/// of a variable once even if it uses the variable more times.
+void CSRConstraintGraph::buildUses() {
+	unsigned varsNum = nodes.size();
+	std::vector<unsigned> last(varsNum, NoOperation);
+
+	auto forEachSource = [this](unsigned i, auto f) {
+		const Operation& op = ops[i];
+		if (op.kind == PhiKind) {
+			for (unsigned s = op.firstSource; s < op.endSource; ++s)
+				f(phiSources[s]);
+		} else {
+			f(op.source1);
+			if (op.kind == BinaryKind)
+				f(op.source2);
+		}
+	};
+
+	useStart.assign(varsNum + 1, 0);
+	symbStart.assign(varsNum + 1, 0);
+	for (unsigned i = 0, e = ops.size(); i < e; ++i) {
+		forEachSource(i, [&](unsigned var) {
+			if (last[var] != i) {
+				last[var] = i;
+				++useStart[var + 1];
+			}
+		});
+		if (ops[i].bound >= 0)
+			++symbStart[ops[i].bound + 1];
+	}
+
+	for (unsigned v = 0; v < varsNum; ++v) {
+		useStart[v + 1] += useStart[v];
+		symbStart[v + 1] += symbStart[v];
+	}
+
+	useOps.resize(useStart[varsNum]);
+	symbOps.resize(symbStart[varsNum]);
+	std::vector<unsigned> usePos(useStart.begin(), useStart.end() - 1);
+	std::vector<unsigned> symbPos(symbStart.begin(), symbStart.end() - 1);
+	last.assign(varsNum, NoOperation);
+	for (unsigned i = 0, e = ops.size(); i < e; ++i) {
+		forEachSource(i, [&](unsigned var) {
+			if (last[var] != i) {
+				last[var] = i;
+				useOps[usePos[var]++] = i;
+			}
+		});
+		if (ops[i].bound >= 0)
+			symbOps[symbPos[ops[i].bound]++] = i;
+	}
+}
+
+/// Finds the strongly connected components of the graph (Tarjan's algorithm
+/// without recursion) and orders them topologically. Besides the uses,
+/// the graph has the control dependence edges of Nuutila, from the bounds
+/// of symbolic intervals to the sinks of their operations.
+void CSRConstraintGraph::findSCCs() {
+	unsigned varsNum = nodes.size();
+	const unsigned unvisited = ~0u;
+	std::vector<unsigned> dfs(varsNum, unvisited);
+	std::vector<unsigned> low(varsNum, 0);
+	std::vector<bool> onStack(varsNum, false);
+	std::vector<unsigned> stack;
+	// the visited variable and the next of its edges
+	std::vector<std::pair<unsigned, unsigned>> path;
+	// components in the reverse topological order
+	std::vector<unsigned> revStart;
+	std::vector<unsigned> revVars;
+	unsigned counter = 0;
+
+	auto edgesNum = [this](unsigned v) {
+		return (useStart[v + 1] - useStart[v]) + (symbStart[v + 1] - symbStart[v]);
+	};
+	auto edge = [this](unsigned v, unsigned k) {
+		unsigned uses = useStart[v + 1] - useStart[v];
+		if (k < uses)
+			return ops[useOps[useStart[v] + k]].sink;
+		return ops[symbOps[symbStart[v] + k - uses]].sink;
+	};
+
+	for (unsigned root = 0; root < varsNum; ++root) {
+		if (dfs[root] != unvisited)
+			continue;
+
+		path.emplace_back(root, 0);
+		dfs[root] = low[root] = counter++;
+		stack.push_back(root);
+		onStack[root] = true;
+
+		while (!path.empty()) {
+			unsigned v = path.back().first;
+			unsigned& k = path.back().second;
+
+			if (k < edgesNum(v)) {
+				unsigned w = edge(v, k++);
+				if (dfs[w] == unvisited) {
+					dfs[w] = low[w] = counter++;
+					stack.push_back(w);
+					onStack[w] = true;
+					path.emplace_back(w, 0);
+				} else if (onStack[w]) {
+					low[v] = std::min(low[v], dfs[w]);
+				}
+				continue;
+			}
+
+			path.pop_back();
+			if (!path.empty()) {
+				unsigned parent = path.back().first;
+				low[parent] = std::min(low[parent], low[v]);
+			}
+
+			if (low[v] == dfs[v]) {
+				revStart.push_back(revVars.size());
+				unsigned w;
+				do {
+					w = stack.back();
+					stack.pop_back();
+					onStack[w] = false;
+					revVars.push_back(w);
+				} while (w != v);
+			}
+		}
+	}
+	revStart.push_back(revVars.size());
+
+	unsigned sccNum = revStart.size() - 1;
+	sccStart.clear();
+	sccVars.clear();
+	sccOf.assign(varsNum, 0);
+	for (unsigned r = sccNum; r-- > 0;) {
+		sccStart.push_back(sccVars.size());
+		unsigned begin = sccVars.size();
+		sccVars.insert(sccVars.end(), revVars.begin() + revStart[r],
+				revVars.begin() + revStart[r + 1]);
+		std::sort(sccVars.begin() + begin, sccVars.end());
+		for (unsigned i = begin, e = sccVars.size(); i < e; ++i)
+			sccOf[sccVars[i]] = sccStart.size() - 1;
+	}
+	sccStart.push_back(sccVars.size());
+}
+
+void CSRConstraintGraph::setRange(unsigned var, const Interval64& range) {
+	ranges[var] = range;
+
+	// As in VarNode::setRange, an inverted range is empty
+	if (range.l > range.u)
+		ranges[var].type = Empty;
+}
+
+Interval64 CSRConstraintGraph::eval(const Operation& op) const {
+	const IntervalKernel64& K = kernel;
+	const Interval64& intersect = intersects[&op - ops.data()];
+
+	switch (op.kind) {
+	case SigmaKind:
+		return K.intersectWith(ranges[op.source1], intersect);
+
+	case UnaryKind: {
+		const Interval64& oprnd = ranges[op.source1];
+		Interval64 result = K.make(K.getMin(), K.getMax(), Unknown);
+
+		if (oprnd.type == Regular) {
+			switch (op.opcode) {
+			case Instruction::Trunc:
+			case Instruction::SExt:
+				result = K.truncate(oprnd, op.sinkBits);
+				break;
+			case Instruction::ZExt:
+				result = K.zextOrTrunc(oprnd, op.sinkBits);
+				break;
+			default:
+				// Loads and Stores are handled here.
+				result = oprnd;
+				break;
+			}
+		} else if (oprnd.type == Empty) {
+			result = K.make(K.getMin(), K.getMax(), Empty);
+		}
+
+		if (!K.isMaxRange(intersect))
+			result = K.intersectWith(result, intersect);
+		return result;
+	}
+
+	case BinaryKind: {
+		const Interval64& op1 = ranges[op.source1];
+		const Interval64& op2 = ranges[op.source2];
+		Interval64 result = K.make(K.getMin(), K.getMax(), Unknown);
+
+		if (op1.type == Regular && op2.type == Regular) {
+			switch (op.opcode) {
+			case Instruction::Add:  result = K.add(op1, op2); break;
+			case Instruction::Sub:  result = K.sub(op1, op2); break;
+			case Instruction::Mul:  result = K.mul(op1, op2); break;
+			case Instruction::UDiv: result = K.udiv(op1, op2); break;
+			case Instruction::SDiv: result = K.sdiv(op1, op2); break;
+			case Instruction::URem: result = K.urem(op1, op2); break;
+			case Instruction::SRem: result = K.srem(op1, op2); break;
+			case Instruction::Shl:  result = K.shl(op1, op2); break;
+			case Instruction::LShr: result = K.lshr(op1, op2); break;
+			case Instruction::AShr: result = K.ashr(op1, op2); break;
+			case Instruction::And:  result = K.And(op1, op2); break;
+			case Instruction::Or:   result = K.Or(op1, op2); break;
+			case Instruction::Xor:  result = K.Xor(op1, op2); break;
+			default: break;
+			}
+
+			// If resulting interval has become inconsistent, set it to max range for safety
+			if (result.l > result.u)
+				result = K.make(K.getMin(), K.getMax());
+
+			if (!K.isMaxRange(intersect))
+				result = K.intersectWith(result, intersect);
+		} else if (op1.type == Empty || op2.type == Empty) {
+			result = K.make(K.getMin(), K.getMax(), Empty);
+		}
+		return result;
+	}
+
+	case PhiKind: {
+		Interval64 result = ranges[phiSources[op.firstSource]];
+		for (unsigned s = op.firstSource + 1; s < op.endSource; ++s)
+			result = K.unionWith(result, ranges[phiSources[s]]);
+		return result;
+	}
+	}
+
+	return K.make(K.getMin(), K.getMax(), Unknown);
+}
+
+/// Replaces symbolic intervals bounded by the variables of the component
+/// with the intervals of the variables (SymbInterval::fixIntersects).
+void CSRConstraintGraph::fixIntersects(unsigned scc) {
+	const IntervalKernel64& K = kernel;
+
+	for (unsigned i = sccStart[scc]; i < sccStart[scc + 1]; ++i) {
+		unsigned var = sccVars[i];
+		int64_t l = ranges[var].l;
+		int64_t u = ranges[var].u;
+
+		for (unsigned s = symbStart[var]; s < symbStart[var + 1]; ++s) {
+			unsigned opIdx = symbOps[s];
+			const Operation& op = ops[opIdx];
+			int64_t lower = ranges[op.sink].l;
+			int64_t upper = ranges[op.sink].u;
+
+			Interval64 fixed;
+			switch (op.pred) {
+			case ICmpInst::ICMP_EQ:
+				fixed = K.make(l, u);
+				break;
+			case ICmpInst::ICMP_SLE:
+				fixed = K.make(lower, u);
+				break;
+			case ICmpInst::ICMP_SLT:
+				fixed = K.make(lower, u != K.getMax() ? (u == K.getMin() ? K.getMax() : u - 1) : u);
+				break;
+			case ICmpInst::ICMP_SGE:
+				fixed = K.make(l, upper);
+				break;
+			case ICmpInst::ICMP_SGT:
+				fixed = K.make(l != K.getMin() ? (l == K.getMax() ? K.getMin() : l + 1) : l, upper);
+				break;
+			default:
+				fixed = K.make(K.getMin(), K.getMax());
+				break;
+			}
+			intersects[opIdx] = fixed;
+		}
+	}
+}
+
+void CSRConstraintGraph::buildConstantVector(unsigned scc) {
+	constants.clear();
+
+	// Constants inside the component and sources of the operations
+	// that define its variables
+	for (unsigned i = sccStart[scc]; i < sccStart[scc + 1]; ++i) {
+		unsigned var = sccVars[i];
+		if (constant[var])
+			constants.push_back(ranges[var].l);
+
+		if (defs[var] == NoOperation)
+			continue;
+
+		const Operation& op = ops[defs[var]];
+		if (op.kind == BinaryKind) {
+			if (constant[op.source1])
+				constants.push_back(ranges[op.source1].l);
+			if (constant[op.source2])
+				constants.push_back(ranges[op.source2].l);
+		} else if (op.kind == PhiKind) {
+			for (unsigned s = op.firstSource; s < op.endSource; ++s) {
+				if (constant[phiSources[s]])
+					constants.push_back(ranges[phiSources[s]].l);
+			}
+		}
+	}
+
+	// Constants used in intersections generated for sigmas
+	for (unsigned i = sccStart[scc]; i < sccStart[scc + 1]; ++i) {
+		unsigned var = sccVars[i];
+		for (unsigned u = useStart[var]; u < useStart[var + 1]; ++u) {
+			const Operation& op = ops[useOps[u]];
+			if (op.kind != SigmaKind || sccOf[op.sink] != scc || op.bound >= 0)
+				continue;
+
+			const Interval64& intersect = intersects[useOps[u]];
+			if (intersect.l != kernel.getMin() && intersect.l != kernel.getMax())
+				constants.push_back(intersect.l);
+			if (intersect.u != kernel.getMin() && intersect.u != kernel.getMax())
+				constants.push_back(intersect.u);
+		}
+	}
+
+	std::sort(constants.begin(), constants.end());
+	constants.erase(std::unique(constants.begin(), constants.end()), constants.end());
+}
+
+void CSRConstraintGraph::generateEntryPoints(unsigned scc) {
+	for (unsigned i = sccStart[scc]; i < sccStart[scc + 1]; ++i) {
+		unsigned var = sccVars[i];
+
+		if (sigmaName[var] && defs[var] != NoOperation) {
+			Operation& op = ops[defs[var]];
+			if (op.kind == SigmaKind && op.unresolved) {
+				setRange(op.sink, eval(op));
+				op.unresolved = false;
+			}
+		}
+
+		if (ranges[var].type != Unknown) {
+			worklist.push_back(var);
+			inWorklist[var] = true;
+		}
+	}
+}
+
+void CSRConstraintGraph::generateActiveVars(unsigned scc) {
+	for (unsigned i = sccStart[scc]; i < sccStart[scc + 1]; ++i) {
+		unsigned var = sccVars[i];
+		if (!constant[var]) {
+			worklist.push_back(var);
+			inWorklist[var] = true;
+		}
+	}
+}
+
+void CSRConstraintGraph::propagateToNextSCC(unsigned scc) {
+	for (unsigned i = sccStart[scc]; i < sccStart[scc + 1]; ++i) {
+		unsigned var = sccVars[i];
+		for (unsigned u = useStart[var]; u < useStart[var + 1]; ++u) {
+			Operation& op = ops[useOps[u]];
+			setRange(op.sink, eval(op));
+
+			if (op.kind == SigmaKind && intersects[useOps[u]].type == Unknown)
+				op.unresolved = true;
+		}
+	}
+}
+
+/// Jump-set widening (Meet::widen).
+bool CSRConstraintGraph::widen(const Operation& op) {
+	Interval64 oldInterval = ranges[op.sink];
+	Interval64 newInterval = eval(op);
+
+	// the first constant not greater than the lower bound (compared
+	// as doubles, as in getFirstLessFromVector) and the first constant
+	// not less than the upper bound
+	int64_t nlconstant = kernel.getMin();
+	for (auto it = constants.rbegin(), end = constants.rend(); it != end; ++it) {
+		if ((double)*it <= (double)newInterval.l) {
+			nlconstant = *it;
+			break;
+		}
+	}
+	int64_t nuconstant = kernel.getMax();
+	for (int64_t c : constants) {
+		if (c >= newInterval.u) {
+			nuconstant = c;
+			break;
+		}
+	}
+
+	if (oldInterval.type == Unknown) {
+		setRange(op.sink, newInterval);
+	} else if (newInterval.l < oldInterval.l && newInterval.u > oldInterval.u) {
+		setRange(op.sink, kernel.make(nlconstant, nuconstant));
+	} else if (newInterval.l < oldInterval.l) {
+		setRange(op.sink, kernel.make(nlconstant, oldInterval.u));
+	} else if (newInterval.u > oldInterval.u) {
+		setRange(op.sink, kernel.make(oldInterval.l, nuconstant));
+	}
+
+	return oldInterval != ranges[op.sink];
+}
+
+/// Narrowing (Meet::narrow).
+bool CSRConstraintGraph::narrow(const Operation& op) {
+	int64_t oLower = ranges[op.sink].l;
+	int64_t oUpper = ranges[op.sink].u;
+	Interval64 newInterval = eval(op);
+	bool hasChanged = false;
+
+	if (oLower == kernel.getMin() && newInterval.l != kernel.getMin()) {
+		setRange(op.sink, kernel.make(newInterval.l, oUpper));
+		hasChanged = true;
+	} else if (oLower != std::min(oLower, newInterval.l)) {
+		setRange(op.sink, kernel.make(newInterval.l, oUpper));
+		hasChanged = true;
+	}
+
+	if (oUpper == kernel.getMax() && newInterval.u != kernel.getMax()) {
+		setRange(op.sink, kernel.make(ranges[op.sink].l, newInterval.u));
+		hasChanged = true;
+	} else if (oUpper != std::max(oUpper, newInterval.u)) {
+		setRange(op.sink, kernel.make(ranges[op.sink].l, newInterval.u));
+		hasChanged = true;
+	}
+
+	return hasChanged;
+}
+
+/// Applies the meet operator to the uses of the variables in the worklist
+/// until nothing changes, only operations inside the component are used.
+void CSRConstraintGraph::update(unsigned scc, bool widening) {
+	for (size_t head = 0; head < worklist.size(); ++head) {
+		unsigned var = worklist[head];
+		inWorklist[var] = false;
+
+		for (unsigned u = useStart[var]; u < useStart[var + 1]; ++u) {
+			const Operation& op = ops[useOps[u]];
+			if (sccOf[op.sink] != scc)
+				continue;
+
+			bool changed = widening ? widen(op) : narrow(op);
+			if (changed && !inWorklist[op.sink]) {
+				worklist.push_back(op.sink);
+				inWorklist[op.sink] = true;
+			}
+		}
+	}
+	worklist.clear();
+}
+
+void CSRConstraintGraph::findIntervals() {
+	assert(valid && "The graph cannot be solved");
+
+	findSCCs();
+	inWorklist.assign(nodes.size(), false);
+
+	const Interval64 full = kernel.make(kernel.getMin(), kernel.getMax());
+	for (unsigned scc = 0, e = sccStart.size() - 1; scc < e; ++scc) {
+		if (sccStart[scc + 1] - sccStart[scc] == 1) {
+			fixIntersects(scc);
+
+			unsigned var = sccVars[sccStart[scc]];
+			if (ranges[var].type == Unknown)
+				setRange(var, full);
+		} else {
+			buildConstantVector(scc);
+
+			generateEntryPoints(scc);
+			update(scc, true);
+			fixIntersects(scc);
+
+			for (unsigned i = sccStart[scc]; i < sccStart[scc + 1]; ++i) {
+				if (ranges[sccVars[i]].type == Unknown)
+					setRange(sccVars[i], full);
+			}
+
+			generateActiveVars(scc);
+			update(scc, false);
+		}
+		propagateToNextSCC(scc);
+	}
+
+	// Store the results in the original graph
+	for (unsigned i = 0, e = nodes.size(); i < e; ++i)
+		nodes[i]->setRange(kernel.toRange(ranges[i]));
+
+	for (unsigned i = 0, e = ops.size(); i < e; ++i) {
+		if (ops[i].bound >= 0)
+			basicOps[i]->setIntersect(kernel.toRange(intersects[i]));
+
+		if (SigmaOp *sop = dyn_cast<SigmaOp>(basicOps[i])) {
+			if (ops[i].unresolved)
+				sop->markUnresolved();
+			else
+				sop->markResolved();
+		}
+	}
+}
@@ -0,0 +1,189 @@
+//===---------------------- CSRConstraintGraph.h --------------------------===//
+//===-- Solves the constraint graph of the range analysis on flat arrays --===//
+//
+// The constraint graph of RangeAnalysis keeps every variable and operation
+// in its own heap object and the uses of variables in maps of pointer sets.
+// This file contains a solver that takes such a graph once it is built,
+// numbers its variables and operations, lays the uses out in compressed
+// sparse row arrays and finds the intervals with the same algorithm as
+// Cousot (widening and narrowing in the SCCs in the topological order),
+// working only with indices. The bounds are int64_t, so it is used only
+// for functions whose maximal bit width is at most 64.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_TRANSFORMS_RANGEANALYSIS_CSRCONSTRAINTGRAPH_H_
+#define LLVM_TRANSFORMS_RANGEANALYSIS_CSRCONSTRAINTGRAPH_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "RangeAnalysis.h"
+
+/// Interval with bounds sign-extended to 64 bits.
+struct Interval64 {
+	int64_t l;
+	int64_t u;
+	RangeType type;
+
+	bool operator==(const Interval64& other) const {
+		return type == other.type && l == other.l && u == other.u;
+	}
+	bool operator!=(const Interval64& other) const {
+		return !(*this == other);
+	}
+};
+
+/// Operations on intervals of the given bit width (at most 64). They give
+/// the same results as the operations of Range with MAX_BIT_INT equal
+/// to the bit width.
+class IntervalKernel64 {
+private:
+	unsigned width;
+	uint64_t mask;
+	int64_t min;
+	int64_t max;
+
+	/// Sign-extends the lowest width bits of the value.
+	int64_t wrap(uint64_t value) const;
+	/// Returns the value as an unsigned number of width bits.
+	uint64_t toUnsigned(int64_t value) const { return (uint64_t)value & mask; }
+	/// Returns the shift amount as APInt::shl and others take it.
+	unsigned shiftAmount(int64_t value) const;
+	int64_t mulCandidate(int64_t x, int64_t y) const;
+
+public:
+	IntervalKernel64(unsigned width);
+
+	unsigned getWidth() const { return width; }
+	int64_t getMin() const { return min; }
+	int64_t getMax() const { return max; }
+
+	/// Creates the interval as the constructor of Range does,
+	/// [l, u] with l > u is empty.
+	Interval64 make(int64_t l, int64_t u, RangeType type = Regular) const;
+	bool isMaxRange(const Interval64& a) const { return a.l == min && a.u == max; }
+
+	Interval64 add(const Interval64& a, const Interval64& b) const;
+	Interval64 sub(const Interval64& a, const Interval64& b) const;
+	Interval64 mul(const Interval64& a, const Interval64& b) const;
+	Interval64 udiv(const Interval64& a, const Interval64& b) const;
+	Interval64 sdiv(const Interval64& a, const Interval64& b) const;
+	Interval64 urem(const Interval64& a, const Interval64& b) const;
+	Interval64 srem(const Interval64& a, const Interval64& b) const;
+	Interval64 shl(const Interval64& a, const Interval64& b) const;
+	Interval64 lshr(const Interval64& a, const Interval64& b) const;
+	Interval64 ashr(const Interval64& a, const Interval64& b) const;
+	Interval64 And(const Interval64& a, const Interval64& b) const;
+	Interval64 Or(const Interval64& a, const Interval64& b) const;
+	Interval64 Xor(const Interval64& a, const Interval64& b) const;
+	Interval64 truncate(const Interval64& a, unsigned bitwidth) const;
+	Interval64 zextOrTrunc(const Interval64& a, unsigned bitwidth) const;
+	Interval64 intersectWith(const Interval64& a, const Interval64& b) const;
+	Interval64 unionWith(const Interval64& a, const Interval64& b) const;
+
+	/// Conversions from and to Range of the bit width.
+	Interval64 fromRange(const Range& r) const;
+	Range toRange(const Interval64& a) const;
+};
+
+/// The constraint graph laid out in arrays.
+class CSRConstraintGraph {
+private:
+	enum OperationKind : uint8_t {
+		UnaryKind,
+		SigmaKind,
+		BinaryKind,
+		PhiKind
+	};
+
+	/// An operation of the graph, the variables are given by indices.
+	struct Operation {
+		OperationKind kind;
+		// set for sigmas by propagateToNextSCC(), as in SigmaOp
+		bool unresolved;
+		unsigned opcode;
+		unsigned sink;
+		// bit width of the sink (for casts)
+		unsigned sinkBits;
+		// sources of unary and binary operations
+		unsigned source1;
+		unsigned source2;
+		// sources of phi operations are phiSources[firstSource, endSource)
+		unsigned firstSource;
+		unsigned endSource;
+		// variable bounding the symbolic interval of the operation or -1
+		int bound;
+		CmpInst::Predicate pred;
+	};
+
+	static const unsigned NoOperation = ~0u;
+
+	IntervalKernel64 kernel;
+
+	// variables
+	std::vector<VarNode*> nodes;
+	std::vector<Interval64> ranges;
+	std::vector<bool> constant;
+	std::vector<bool> sigmaName;
+	// the operation that defines the variable or NoOperation
+	std::vector<unsigned> defs;
+
+	// operations
+	std::vector<BasicOp*> basicOps;
+	std::vector<Operation> ops;
+	std::vector<Interval64> intersects;
+	std::vector<unsigned> phiSources;
+
+	// operations that use the variable i are
+	// useOps[useStart[i], useStart[i + 1])
+	std::vector<unsigned> useStart;
+	std::vector<unsigned> useOps;
+	// operations whose symbolic interval the variable bounds
+	std::vector<unsigned> symbStart;
+	std::vector<unsigned> symbOps;
+
+	// strongly connected components in the topological order,
+	// component i has variables sccVars[sccStart[i], sccStart[i + 1])
+	std::vector<unsigned> sccStart;
+	std::vector<unsigned> sccVars;
+	// the component of each variable
+	std::vector<unsigned> sccOf;
+
+	// constants of the current component for the jump-set widening
+	std::vector<int64_t> constants;
+	// worklist of update()
+	std::vector<unsigned> worklist;
+	std::vector<bool> inWorklist;
+
+	bool valid;
+
+	void buildUses();
+	void findSCCs();
+	void buildConstantVector(unsigned scc);
+
+	Interval64 eval(const Operation& op) const;
+	void setRange(unsigned var, const Interval64& range);
+	void fixIntersects(unsigned scc);
+	void generateEntryPoints(unsigned scc);
+	void generateActiveVars(unsigned scc);
+	void propagateToNextSCC(unsigned scc);
+	void update(unsigned scc, bool widen);
+	bool widen(const Operation& op);
+	bool narrow(const Operation& op);
+
+public:
+	/// Numbers the variables and operations of the graph, the graph
+	/// must be built (buildGraph() and buildVarNodes()).
+	CSRConstraintGraph(ConstraintGraph& CG, const Function& F, unsigned bitWidth);
+
+	/// Whether the graph can be solved here, it cannot if it has
+	/// values wider than 64 bits.
+	bool isValid() const { return valid; }
+
+	/// Finds the intervals of the variables and stores them
+	/// in the nodes of the original graph.
+	void findIntervals();
+};
+
+#endif /* LLVM_TRANSFORMS_RANGEANALYSIS_CSRCONSTRAINTGRAPH_H_ */
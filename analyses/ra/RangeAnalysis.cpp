@@ -13,18 +13,23 @@
 #define DEBUG_TYPE "range-analysis"
 
 #include "RangeAnalysis.h"
+#include "CSRConstraintGraph.h"
 #include "llvm/IR/InstIterator.h"
 #include "llvm/Support/FileSystem.h"
+#include <atomic>
+#include <thread>
 
 using namespace llvm;
 
 
 // The number of bits needed to store the largest variable of the function (APInt).
-unsigned MAX_BIT_INT = 1;
+// This and the values derived from it below are thread-local, so that
+// functions can be analyzed on more threads at once.
+thread_local unsigned MAX_BIT_INT = 1;
 
 // This map is used to store the number of times that the narrow_meet 
 // operator is called on a variable. It was a Fernando's suggestion.
-DenseMap<const Value*, unsigned> FerMap;
+thread_local DenseMap<const Value*, unsigned> FerMap;
 
 
 // ========================================================================== //
@@ -32,16 +37,16 @@ DenseMap<const Value*, unsigned> FerMap;
 // ========================================================================== //
 
 // The min and max integer values for a given bit width.
-APInt Min = APInt::getSignedMinValue(MAX_BIT_INT);
-APInt Max = APInt::getSignedMaxValue(MAX_BIT_INT);
-APInt Zero(MAX_BIT_INT, 0, true);
+thread_local APInt Min = APInt::getSignedMinValue(MAX_BIT_INT);
+thread_local APInt Max = APInt::getSignedMaxValue(MAX_BIT_INT);
+thread_local APInt Zero(MAX_BIT_INT, 0, true);
 
 // String used to identify sigmas
 const std::string sigmaString = "vSSA_sigma";
 
 // Used to print pseudo-edges in the Constraint Graph dot
-std::string pestring;
-raw_string_ostream pseudoEdgesString(pestring);
+thread_local std::string pestring;
+thread_local raw_string_ostream pseudoEdgesString(pestring);
 
 // Print name of variable according to its type
 static void printVarName(const Value *V, raw_ostream& OS) {
@@ -169,7 +174,7 @@ bool IntraProceduralRA::runOnFunction(Function &F) {
 	return false;
 }
 
-Cousot IntraProceduralRA::run(Function &F) {
+Cousot IntraProceduralRA::run(Function &F, bool csr, unsigned jobs) {
 //	if(CG) delete CG;
 	CG = new Cousot();
 
@@ -179,8 +184,43 @@ Cousot IntraProceduralRA::run(Function &F) {
 	CG->buildGraph(F);
 	CG->buildVarNodes();
 
-	CG->findIntervals();
-    return *CG;
+	for (auto &entry : entryRanges) {
+		VarNodes::iterator vit = CG->vars.find(entry.first);
+		if (vit == CG->vars.end() || CG->getDefMap()->count(entry.first))
+			continue;
+
+		APInt lower = entry.second.first, upper = entry.second.second;
+		if (lower.getBitWidth() > MAX_BIT_INT) {
+			// the range does not fit the function, keep the full range
+			if (!lower.isSignedIntN(MAX_BIT_INT) || !upper.isSignedIntN(MAX_BIT_INT))
+				continue;
+			lower = lower.trunc(MAX_BIT_INT);
+			upper = upper.trunc(MAX_BIT_INT);
+		} else {
+			lower = lower.sext(MAX_BIT_INT);
+			upper = upper.sext(MAX_BIT_INT);
+		}
+		vit->second->setRange(Range(lower, upper));
+	}
+
+	bool solved = false;
+	if (csr) {
+		CSRConstraintGraph CSR(*CG, F, MAX_BIT_INT);
+		if (CSR.isValid()) {
+			CSR.findIntervals();
+			solved = true;
+		}
+	}
+	if (!solved) {
+		CG->setJobs(jobs);
+		CG->findIntervals();
+	}
+
+	// The nodes of the graph are shared by the copy
+	Cousot graph = *CG;
+	delete CG;
+	CG = NULL;
+	return graph;
 }
 
 void IntraProceduralRA::getAnalysisUsage(AnalysisUsage &AU) const {
@@ -1778,6 +1818,7 @@ void ValueSwitchMap::clear() {
 
 ConstraintGraph::ConstraintGraph() {
 	this->func = NULL;
+	this->jobs = 1;
 }
 
 /// The dtor.
@@ -2361,7 +2402,7 @@ bool compareAPInt(const APInt &v1, const APInt &v2)
 /*
  * Used to insert constant in the right position
  */
-void ConstraintGraph::insertConstantIntoVector(APInt constantval)
+void ConstraintGraph::insertConstantIntoVector(APInt constantval, SmallVector<APInt, 2> &constantvector)
 {
 	if (constantval.getBitWidth() < MAX_BIT_INT) {
 		constantval = constantval.sext(MAX_BIT_INT);
@@ -2409,7 +2450,8 @@ APInt getFirstLessFromVector(const SmallVector<APInt, 2> &constantvector, const
  *   - Constants that are source of an edge to an entry point
  *   - Constants from intersections generated by sigmas
  */
-void ConstraintGraph::buildConstantVector(const SmallPtrSet<VarNode*, 32> &component, const UseMap &compusemap)
+void ConstraintGraph::buildConstantVector(const SmallPtrSet<VarNode*, 32> &component, const UseMap &compusemap,
+	SmallVector<APInt, 2> &constantvector)
 {
 	// Remove all elements from the vector
 	constantvector.clear();
@@ -2420,7 +2462,7 @@ void ConstraintGraph::buildConstantVector(const SmallPtrSet<VarNode*, 32> &compo
 		const ConstantInt *ci = NULL;
 		
 		if ((ci = dyn_cast<ConstantInt>(V))) {
-			insertConstantIntoVector(ci->getValue());
+			insertConstantIntoVector(ci->getValue(), constantvector);
 		}
 	}
 
@@ -2446,10 +2488,10 @@ void ConstraintGraph::buildConstantVector(const SmallPtrSet<VarNode*, 32> &compo
 			const ConstantInt *const1, *const2;
 
 			if ((const1 = dyn_cast<ConstantInt>(sourceval1))) {
-				insertConstantIntoVector(const1->getValue());
+				insertConstantIntoVector(const1->getValue(), constantvector);
 			}
 			if ((const2 = dyn_cast<ConstantInt>(sourceval2))) {
-				insertConstantIntoVector(const2->getValue());
+				insertConstantIntoVector(const2->getValue(), constantvector);
 			}
 		}
 		// Handle PhiOp case
@@ -2461,7 +2503,7 @@ void ConstraintGraph::buildConstantVector(const SmallPtrSet<VarNode*, 32> &compo
 				const ConstantInt *consti;
 
 				if ((consti = dyn_cast<ConstantInt>(sourceval))) {
-					insertConstantIntoVector(consti->getValue());
+					insertConstantIntoVector(consti->getValue(), constantvector);
 				}
 			}
 		}
@@ -2484,10 +2526,10 @@ void ConstraintGraph::buildConstantVector(const SmallPtrSet<VarNode*, 32> &compo
 				const APInt ub = rintersect.getUpper();
 
 				if (lb.ne(Min) && lb.ne(Max)) {
-					insertConstantIntoVector(lb);
+					insertConstantIntoVector(lb, constantvector);
 				}
 				if (ub.ne(Min) && ub.ne(Max)) {
-					insertConstantIntoVector(ub);
+					insertConstantIntoVector(ub, constantvector);
 				}
 			}
 		}
@@ -2688,19 +2730,21 @@ bool Meet::crop(BasicOp* op, const SmallVector<APInt, 2> * /*constantvector*/) {
 }
 
 void Cousot::preUpdate(const UseMap &compUseMap,
-		SmallPtrSet<const Value*, 6>& entryPoints) {
-	update(compUseMap, entryPoints, Meet::widen);
+		SmallPtrSet<const Value*, 6>& entryPoints,
+		const SmallVector<APInt, 2> &constantvector) {
+	update(compUseMap, entryPoints, Meet::widen, &constantvector);
 }
 
 void Cousot::posUpdate(const UseMap &compUseMap,
 		SmallPtrSet<const Value*, 6>& entryPoints,
 		const SmallPtrSet<VarNode*, 32> * /*component*/) {
-	update(compUseMap, entryPoints, Meet::narrow);
+	update(compUseMap, entryPoints, Meet::narrow, NULL);
 }
 
 void CropDFS::preUpdate(const UseMap &compUseMap,
-		SmallPtrSet<const Value*, 6>& entryPoints) {
-	update(compUseMap, entryPoints, Meet::growth);
+		SmallPtrSet<const Value*, 6>& entryPoints,
+		const SmallVector<APInt, 2> & /*constantvector*/) {
+	update(compUseMap, entryPoints, Meet::growth, NULL);
 }
 
 void CropDFS::posUpdate(const UseMap &compUseMap,
@@ -2751,7 +2795,8 @@ void CropDFS::crop(const UseMap &compUseMap, BasicOp *op) {
 }
 
 void ConstraintGraph::update(const UseMap &compUseMap,
-		SmallPtrSet<const Value*, 6>& actv, bool(*meet)(BasicOp* op, const SmallVector<APInt, 2> *constantvector)) {
+		SmallPtrSet<const Value*, 6>& actv, bool(*meet)(BasicOp* op, const SmallVector<APInt, 2> *constantvector),
+		const SmallVector<APInt, 2> *constantvector) {
 	while (!actv.empty()) {
 		const Value* V = *actv.begin();
 		actv.erase(V);
@@ -2769,7 +2814,7 @@ void ConstraintGraph::update(const UseMap &compUseMap,
 		SmallPtrSetIterator<BasicOp*> bgn = L.begin(), end = L.end();
 
 		for (; bgn != end; ++bgn) {
-			if (meet(*bgn, &constantvector)) {
+			if (meet(*bgn, constantvector)) {
 				// I want to use it as a set, but I also want
 				// keep an order or insertions and removals.
 				actv.insert((*bgn)->getSink()->getValue());
@@ -2806,71 +2851,178 @@ void ConstraintGraph::findIntervals() {
 	// List of SCCs
 	Nuutila sccList(&vars, &useMap, &symbMap);
 
+	if (jobs > 1) {
+		findIntervalsByLevels(sccList);
+		return;
+	}
+
 	// For each SCC in graph, do the following
 	for (Nuutila::iterator nit = sccList.begin(), nend = sccList.end();
 			nit != nend; ++nit) {
 		SmallPtrSet<VarNode*, 32> &component = *sccList.components[*nit];
 		//PRINTCOMPONENT(component)
 
-		if (component.size() == 1) {
-			fixIntersects(component);
-			
-			VarNode *var = *component.begin();
-			if (var->getRange().isUnknown()) {
-				var->setRange(Range(Min, Max));
-			}
-		}else{
+		solveComponent(component);
+		propagateToNextSCC(component);
+	}
 
-			UseMap compUseMap = buildUseMap(component);
 
-			// Get the entry points of the SCC
-			SmallPtrSet<const Value*, 6> entryPoints;
-			
+}
+
+void ConstraintGraph::solveComponent(SmallPtrSet<VarNode*, 32> &component) {
+	// Vector containing the constants from the SCC
+	SmallVector<APInt, 2> constantvector;
+
+	if (component.size() == 1) {
+		fixIntersects(component);
+		
+		VarNode *var = *component.begin();
+		if (var->getRange().isUnknown()) {
+			var->setRange(Range(Min, Max));
+		}
+	}else{
+
+		UseMap compUseMap = buildUseMap(component);
+
+		// Get the entry points of the SCC
+		SmallPtrSet<const Value*, 6> entryPoints;
+		
 #ifdef JUMPSET
-			// Create vector of constants inside component
-			// Comment this line below to deactivate jump-set
-			buildConstantVector(component, compUseMap);
+		// Create vector of constants inside component
+		// Comment this line below to deactivate jump-set
+		buildConstantVector(component, compUseMap, constantvector);
 #endif
 
-			//generateEntryPoints(component, entryPoints);
-			//iterate a fixed number of time before widening
-			//update(component.size()*2 /*| NUMBER_FIXED_ITERATIONS*/, compUseMap, entryPoints);
+		//generateEntryPoints(component, entryPoints);
+		//iterate a fixed number of time before widening
+		//update(component.size()*2 /*| NUMBER_FIXED_ITERATIONS*/, compUseMap, entryPoints);
 
 #ifdef PRINT_DEBUG
-			if (func)
-				printToFile(*func, "/tmp/" + func->getName() + "cgfixed.dot");
+		if (func)
+			printToFile(*func, "/tmp/" + func->getName() + "cgfixed.dot");
 #endif
+		
+		// Primeiro iterate till fix point
+		generateEntryPoints(component, entryPoints);
+		// Primeiro iterate till fix point
+		preUpdate(compUseMap, entryPoints, constantvector);
+		fixIntersects(component);
+		
+		// FIXME: Ensure that this code is not needed
+		for (SmallPtrSetIterator<VarNode*> cit = component.begin(), cend = component.end(); cit != cend; ++cit) {
+			VarNode* var = *cit;
 			
-			// Primeiro iterate till fix point
-			generateEntryPoints(component, entryPoints);
-			// Primeiro iterate till fix point
-			preUpdate(compUseMap, entryPoints);
-			fixIntersects(component);
-			
-			// FIXME: Ensure that this code is not needed
-			for (SmallPtrSetIterator<VarNode*> cit = component.begin(), cend = component.end(); cit != cend; ++cit) {
-				VarNode* var = *cit;
-				
-				if (var->getRange().isUnknown()) {
-					var->setRange(Range(Min, Max));
-				}
+			if (var->getRange().isUnknown()) {
+				var->setRange(Range(Min, Max));
 			}
+		}
 
-			//printResultIntervals();
+		//printResultIntervals();
 #ifdef PRINT_DEBUG
-			if (func)
-				printToFile(*func, "/tmp/" + func->getName() + "cgint.dot");
+		if (func)
+			printToFile(*func, "/tmp/" + func->getName() + "cgint.dot");
 #endif
 
-			// Segundo iterate till fix point
-			SmallPtrSet<const Value*, 6> activeVars;
-			generateActivesVars(component, activeVars);
-			posUpdate(compUseMap, activeVars, &component);
+		// Segundo iterate till fix point
+		SmallPtrSet<const Value*, 6> activeVars;
+		generateActivesVars(component, activeVars);
+		posUpdate(compUseMap, activeVars, &component);
+	}
+}
+
+/*
+ *	Components of the same level of the DAG of SCCs (the level is the length
+ *  of the longest path to the component) do not depend on each other, so
+ *  they are solved in parallel. The results are propagated to the next
+ *  levels in the order of Nuutila's worklist once the whole level is solved,
+ *  so they do not depend on the number of threads.
+ */
+void ConstraintGraph::findIntervalsByLevels(Nuutila &sccList) {
+	std::vector<SmallPtrSet<VarNode*, 32>*> components;
+	DenseMap<const Value*, unsigned> componentOf;
+	for (Nuutila::iterator nit = sccList.begin(), nend = sccList.end();
+			nit != nend; ++nit) {
+		SmallPtrSet<VarNode*, 32> *component = sccList.components[*nit];
+		for (VarNode *var : *component) {
+			componentOf[var->getValue()] = components.size();
+		}
+		components.push_back(component);
+	}
+
+	// The components are in the topological order, so the level of each
+	// one is known before it is visited. The futures are edges too, the
+	// intersects are fixed by the component of the bound.
+	std::vector<unsigned> level(components.size(), 0);
+	unsigned levelsNum = 0;
+	for (unsigned i = 0; i < components.size(); ++i) {
+		levelsNum = std::max(levelsNum, level[i] + 1);
+
+		for (VarNode *var : *components[i]) {
+			const Value *V = var->getValue();
+
+			for (const UseMap *edges : {&useMap, &symbMap}) {
+				UseMap::const_iterator p = edges->find(V);
+				if (p == edges->end()) {
+					continue;
+				}
+
+				for (BasicOp *op : p->second) {
+					unsigned sink = componentOf.lookup(op->getSink()->getValue());
+					if (sink != i) {
+						assert(sink > i && "SCCs are not in topological order");
+						level[sink] = std::max(level[sink], level[i] + 1);
+					}
+				}
+			}
 		}
-		propagateToNextSCC(component);
 	}
 
+	std::vector<std::vector<unsigned> > levels(levelsNum);
+	for (unsigned i = 0; i < components.size(); ++i) {
+		levels[level[i]].push_back(i);
+	}
+
+	// The bit width is thread-local
+	unsigned bitWidth = MAX_BIT_INT;
 
+	for (const std::vector<unsigned> &members : levels) {
+		// Single variables only fix the intersects, there is no point
+		// in giving them to other threads
+		std::vector<unsigned> large;
+		for (unsigned i : members) {
+			if (components[i]->size() == 1) {
+				solveComponent(*components[i]);
+			} else {
+				large.push_back(i);
+			}
+		}
+
+		std::atomic<size_t> next(0);
+		auto worker = [this, &components, &large, &next]() {
+			size_t i;
+			while ((i = next++) < large.size()) {
+				solveComponent(*components[large[i]]);
+			}
+		};
+
+		std::vector<std::thread> threads;
+		unsigned threadsNum = std::min<size_t>(jobs, large.size());
+		for (unsigned t = 1; t < threadsNum; ++t) {
+			threads.emplace_back([bitWidth, &worker]() {
+				MAX_BIT_INT = bitWidth;
+				RangeAnalysis::updateMinMax(bitWidth);
+				worker();
+			});
+		}
+		worker();
+		for (std::thread &thread : threads) {
+			thread.join();
+		}
+
+		for (unsigned i : members) {
+			propagateToNextSCC(*components[i]);
+		}
+	}
 }
 
 void ConstraintGraph::generateEntryPoints(SmallPtrSet<VarNode*, 32> &component
@@ -2951,10 +3103,45 @@ void ConstraintGraph::generateActivesVars(SmallPtrSet<VarNode*, 32> &component
 	}
 }
 
-// TODO: To implement it.
 /// Releases the memory used by the graph.
 void ConstraintGraph::clear() {
+	// Sigma operations share their intervals with the branch and switch
+	// maps, so the intervals are collected and each is deleted only once.
+	SmallPtrSet<BasicInterval*, 32> intervals;
+
+	for (GenOprs::iterator oit = oprs.begin(), oend = oprs.end(); oit != oend;
+			++oit) {
+		intervals.insert((*oit)->releaseIntersect());
+		delete *oit;
+	}
+
+	for (ValuesBranchMap::iterator vit = valuesBranchMap.begin(), vend =
+			valuesBranchMap.end(); vit != vend; ++vit) {
+		intervals.insert(vit->second.getItvT());
+		intervals.insert(vit->second.getItvF());
+	}
+
+	for (ValuesSwitchMap::iterator vit = valuesSwitchMap.begin(), vend =
+			valuesSwitchMap.end(); vit != vend; ++vit) {
+		for (unsigned idx = 0, e = vit->second.getNumOfCases(); idx < e; ++idx)
+			intervals.insert(vit->second.getItv(idx));
+	}
+
+	for (BasicInterval* I : intervals)
+		delete I;
+
+	for (VarNodes::iterator vit = vars.begin(), vend = vars.end();
+			vit != vend; ++vit) {
+		delete vit->second;
+	}
 
+	vars.clear();
+	oprs.clear();
+	defMap.clear();
+	useMap.clear();
+	symbMap.clear();
+	valuesBranchMap.clear();
+	valuesSwitchMap.clear();
 }
 
 /// Prints the content of the graph in dot format. For more informations
@@ -120,9 +120,9 @@ llvm::raw_fd_ostream _log_file(_log_fileName.str().c_str(), _log_ErrorInfo);
 //****************************************************************************//
 using namespace llvm;
 
-extern APInt Min;
-extern APInt Max;
-extern APInt Zero;
+extern thread_local APInt Min;
+extern thread_local APInt Max;
+extern thread_local APInt Zero;
 
 /// In our range analysis pass we have to perform operations on ranges all the
 /// time. LLVM has a class to perform operations on ranges: the class
@@ -338,6 +338,13 @@ public:
 	void setIntersect(const Range& newIntersect) {
 		this->intersect->setRange(newIntersect);
 	}
+	/// Takes the interval of the operation, it is not deleted
+	/// together with the operation then.
+	BasicInterval* releaseIntersect() {
+		BasicInterval* I = intersect;
+		intersect = NULL;
+		return I;
+	}
 	/// Returns the target of the operation, that is,
 	/// where the result will be stored.
 	const VarNode* getSink() const {return sink;}
@@ -615,6 +622,8 @@ typedef DenseMap<const Value*, ValueBranchMap> ValuesBranchMap;
 
 typedef DenseMap<const Value*, ValueSwitchMap> ValuesSwitchMap;
 
+class Nuutila;
+
 /// This class represents our constraint graph. This graph is used to
 /// perform all computations in our analysis.
 class ConstraintGraph {
@@ -638,10 +647,8 @@ private:
 	// obtained in the branches.
 	ValuesBranchMap valuesBranchMap;
 	ValuesSwitchMap valuesSwitchMap;
-	
-	// Vector containing the constants from a SCC
-	// It is cleared at the beginning of every SCC resolution
-	SmallVector<APInt, 2> constantvector;
+	// Number of threads that solve independent SCCs at once
+	unsigned jobs;
 	
 	/// Adds a BinaryOp in the graph.
 	void addBinaryOp(const Instruction* I);
@@ -657,20 +664,32 @@ private:
 	
 //	void clearValueMaps();
 
-	void insertConstantIntoVector(APInt constantval);
+	void insertConstantIntoVector(APInt constantval, SmallVector<APInt, 2> &constantvector);
 	APInt getFirstGreaterFromVector(const SmallVector<APInt, 2> &constantvector, const APInt &val);
 	APInt getFirstLessFromVector(const SmallVector<APInt, 2> &constantvector, const APInt &val);
-	void buildConstantVector(const SmallPtrSet<VarNode*, 32> &component, const UseMap &compusemap);
+	/// Fills the vector with the constants of the component, the vector
+	/// is local to the solving of the component, so that more components
+	/// can be solved at once.
+	void buildConstantVector(const SmallPtrSet<VarNode*, 32> &component, const UseMap &compusemap,
+		SmallVector<APInt, 2> &constantvector);
+	/// Finds the intervals of the variables in the component, the ranges
+	/// of the components it depends on must be known.
+	void solveComponent(SmallPtrSet<VarNode*, 32> &component);
+	/// Solves the components of the same level of the DAG of SCCs
+	/// in parallel, level by level.
+	void findIntervalsByLevels(Nuutila &sccList);
 	// Perform the widening and narrowing operations
 
 protected:
 	void update(const UseMap &compUseMap,
-		SmallPtrSet<const Value*, 6>& actv, bool (*meet)(BasicOp* op, const SmallVector<APInt, 2> *constantvector));
+		SmallPtrSet<const Value*, 6>& actv, bool (*meet)(BasicOp* op, const SmallVector<APInt, 2> *constantvector),
+		const SmallVector<APInt, 2> *constantvector);
 	void update(unsigned nIterations, const UseMap &compUseMap,
 			SmallPtrSet<const Value*, 6>& actv);
 
 	virtual void preUpdate(const UseMap &compUseMap,
-		SmallPtrSet<const Value*, 6>& entryPoints) = 0;
+		SmallPtrSet<const Value*, 6>& entryPoints,
+		const SmallVector<APInt, 2> &constantvector) = 0;
 	virtual void posUpdate(const UseMap &compUseMap,
 		SmallPtrSet<const Value*, 6>& activeVars,
 		const SmallPtrSet<VarNode*, 32> *component) = 0;
@@ -696,13 +715,18 @@ public:
 	UseMap buildUseMap(const SmallPtrSet<VarNode*, 32> &component);
 	void propagateToNextSCC(const SmallPtrSet<VarNode*, 32> &component);
 
+	/// Sets the number of threads that solve the SCCs of the graph,
+	/// with more than one the SCCs are solved level by level.
+	void setJobs(unsigned n) { jobs = n; }
 	/// Finds the intervals of the variables in the graph.
 	void findIntervals();
 	void generateEntryPoints(SmallPtrSet<VarNode*, 32> &component, SmallPtrSet<const Value*, 6> &entryPoints);
 	void fixIntersects(SmallPtrSet<VarNode*, 32> &component);
 	void generateActivesVars(SmallPtrSet<VarNode*, 32> &component, SmallPtrSet<const Value*, 6> &activeVars);
 
-	/// Releases the memory used by the graph.
+	/// Releases the memory used by the graph. The destructor does not do it,
+	/// because copies of the graph share its nodes, so this must be called
+	/// on the last copy only.
 	void clear();
 	/// Prints the content of the graph in dot format. For more informations
 	/// about the dot format, see: http://www.graphviz.org/pdf/dotguide.pdf
@@ -717,7 +741,8 @@ public:
 
 class Cousot: public ConstraintGraph {
 private:
-	void preUpdate(const UseMap &compUseMap, SmallPtrSet<const Value*, 6>& entryPoints);
+	void preUpdate(const UseMap &compUseMap, SmallPtrSet<const Value*, 6>& entryPoints,
+		const SmallVector<APInt, 2> &constantvector);
 	void posUpdate(const UseMap &compUseMap,
 		SmallPtrSet<const Value*, 6>& activeVars,
 		const SmallPtrSet<VarNode*, 32> *component);
@@ -728,7 +753,8 @@ public:
 
 class CropDFS: public ConstraintGraph{
 private:
-	void preUpdate(const UseMap &compUseMap, SmallPtrSet<const Value*, 6>& entryPoints);
+	void preUpdate(const UseMap &compUseMap, SmallPtrSet<const Value*, 6>& entryPoints,
+		const SmallVector<APInt, 2> &constantvector);
 	void posUpdate(const UseMap &compUseMap,
 		SmallPtrSet<const Value*, 6>& activeVars,
 		const SmallPtrSet<VarNode*, 32> *component);
@@ -813,13 +839,26 @@ private:
 };
 
 class IntraProceduralRA: RangeAnalysis{
+private:
+	// Ranges of arguments and results of calls given by the caller
+	DenseMap<const Value*, std::pair<APInt, APInt> > entryRanges;
 public:
 	static char ID; // Pass identification, replacement for typeid
 	IntraProceduralRA() { CG = NULL; /*errs() << "\nIntraProceduralRA ctor";*/ }
 	~IntraProceduralRA();
 	void getAnalysisUsage(AnalysisUsage &AU) const;
 	bool runOnFunction(Function &F);
-    Cousot run(Function &F);
+	/// Analyzes the function, with csr the intervals are found
+	/// by CSRConstraintGraph if the bit width allows it, otherwise
+	/// by the graph with the given number of threads.
+	Cousot run(Function &F, bool csr = false, unsigned jobs = 1);
+	/// Sets the range of a value that is not defined by any operation
+	/// of the graph (an argument or the result of a call), which is
+	/// otherwise the full range. The bounds are signed and are extended
+	/// to the bit width of the function, must be called before run().
+	void setEntryRange(const Value *v, const APInt &lower, const APInt &upper) {
+		entryRanges[v] = std::make_pair(lower, upper);
+	}
 
 	virtual APInt getMin();
 	virtual APInt getMax();
@@ -1,4 +1,6 @@
 #include "range_analysis_plugin.hpp"
+#include <atomic>
+#include <cstdlib>
 #include <limits>
 #include <cmath>
 #include <tuple>
@@ -14,60 +16,62 @@ bool checkUnknown(const Range& a, const Range& b) {
     return true;
 }
 
-std::string RangeAnalysisPlugin::canBeZero(Value* value) {
+QueryResult RangeAnalysisPlugin::canBeZero(Value* value) {
     // Support only instructions
     auto* inst = dyn_cast<Instruction>(value);
     if (!inst)
-        return "maybe";
+        return QueryResult::Maybe;
 
-    auto result = RA.find(inst->getFunction());
-    ConstraintGraph& CG = result->second;
-    Range r = getRange(CG, value);
+    const RangeTable *table = getTable(inst->getFunction());
+    if (!table)
+        return QueryResult::Maybe;
+
+    Range r = getRange(*table, value);
 
     if (!r.isRegular())
-        return "maybe";
+        return QueryResult::Maybe;
 
     double x = r.getLower().signedRoundToDouble();
     double y = r.getUpper().signedRoundToDouble();
 
     if (x > 0)
-        return "false";
+        return QueryResult::False;
 
     if (y < 0)
-        return "false";
+        return QueryResult::False;
 
-    return "true";
+    return QueryResult::True;
 }
 
-std::string RangeAnalysisPlugin::canOverflow(Value* value) {
+QueryResult RangeAnalysisPlugin::canOverflow(Value* value) {
     // Support only instructions
     auto* inst = dyn_cast<Instruction>(value);
     if (!inst)
-        return "unknown";
+        return QueryResult::Unknown;
 
     // Support only instruction of integer type
     const auto* intT = dyn_cast<IntegerType>(inst->getType());
     if (!intT)
-        return "unknown";
+        return QueryResult::Unknown;
 
-    auto result = RA.find(inst->getFunction());
-    if (result == RA.end())
-        return "unknown";
+    const RangeTable *table = getTable(inst->getFunction());
+    if (!table)
+        return QueryResult::Unknown;
 
-    ConstraintGraph& CG = result->second;
+    const RangeTable& CG = *table;
 
     if (const auto* binOp
         = dyn_cast<OverflowingBinaryOperator>(inst)) {
         // we are looking for bin. ops with nsw
         if (!binOp->hasNoSignedWrap())
-            return "false";
+            return QueryResult::False;
 
         Range a = getRange(CG, binOp->getOperand(0));
         Range b = getRange(CG, binOp->getOperand(1));
 
         // check for unknown ranges
         if (checkUnknown(a, b))
-            return "unknown";
+            return QueryResult::Unknown;
 
         // check addition
         if (isa<AddOperator>(inst))
@@ -88,7 +92,7 @@ std::string RangeAnalysisPlugin::canOverflow(Value* value) {
         Range a = getRange(CG, binOp->getOperand(0));
         Range b = getRange(CG, binOp->getOperand(1));
         if (checkUnknown(a, b))
-            return "true";
+            return QueryResult::True;
         return canOverflowDiv(a, b, *intT);
     }
 
@@ -107,21 +111,21 @@ std::string RangeAnalysisPlugin::canOverflow(Value* value) {
         return canOverflowShl(a, b, *intT);
     }
 
-    return "unknown";
+    return QueryResult::Unknown;
 }
 
-std::string RangeAnalysisPlugin::canOverflowShl(const Range& a, const Range& b,
+QueryResult RangeAnalysisPlugin::canOverflowShl(const Range& a, const Range& b,
                                                 const IntegerType& Ty) {
   assert(Ty.getBitWidth() <= 64);
   if (!a.isRegular() || !b.isRegular())
-    return "unknown";
+    return QueryResult::Unknown;
 
   if (b.getUpper().getZExtValue() >= a.getLower().getBitWidth())
-    return "true";
+    return QueryResult::True;
 
   // invalid number of positions
   if (b.getUpper().getZExtValue() >= Ty.getBitWidth())
-    return "true";
+    return QueryResult::True;
 
   uint64_t max = (1UL << (Ty.getBitWidth() - 1)) - 1;
   uint64_t e = 1UL << b.getUpper().getZExtValue();
@@ -135,40 +139,40 @@ std::string RangeAnalysisPlugin::canOverflowShl(const Range& a, const Range& b,
     l.negate();
 #endif
     if (l.getZExtValue() > (max >> e))
-      return "true";
+      return QueryResult::True;
   } else if (!a.getLower().isNegative()) {
     if (a.getUpper().getZExtValue() > ((max - 1) >> e))
-      return "true";
+      return QueryResult::True;
   }
   // else a == 0, which is fine
 
-  return "false";
+  return QueryResult::False;
 }
 
 
-std::string RangeAnalysisPlugin::canOverflowTrunc(const Range& a,
+QueryResult RangeAnalysisPlugin::canOverflowTrunc(const Range& a,
         const TruncInst& truncOp)
 {
     if (!a.isRegular())
-        return "unknown";
+        return QueryResult::Unknown;
 
     double x = a.getLower().signedRoundToDouble();
     double y = a.getUpper().signedRoundToDouble();
 
     const auto* t = dyn_cast<IntegerType>(truncOp.getDestTy());
     if (!t)
-        return "unknown";
+        return QueryResult::Unknown;
 
     if (y > 0 && y > (std::pow(2, t->getBitWidth() - 1) - 1))
-        return "true";
+        return QueryResult::True;
 
     if (x < 0 && x < (-std::pow(2, t->getBitWidth() - 1)))
-        return "true";
+        return QueryResult::True;
 
-    return "false";
+    return QueryResult::False;
 }
 
-Range RangeAnalysisPlugin::getRange(ConstraintGraph& CG,
+Range RangeAnalysisPlugin::getRange(const RangeTable& CG,
                         llvm::Value* val)
 {
     Range r = CG.getRange(val);
@@ -193,15 +197,15 @@ bool checkOverflowAdd(const APInt& ax, const APInt& ay, const IntegerType& t)
     return overflow;
 }
 
-std::string RangeAnalysisPlugin::canOverflowAdd(const Range& a,
+QueryResult RangeAnalysisPlugin::canOverflowAdd(const Range& a,
         const Range& b, const IntegerType& t)
 {
     if (checkOverflowAdd(a.getUpper(), b.getUpper(), t) ||
 	checkOverflowAdd(a.getLower(), b.getLower(), t)) {
-        return "true";
+        return QueryResult::True;
     }
 
-    return "false";
+    return QueryResult::False;
 }
 
 bool checkOverflowSub(APInt ax, APInt ay, const IntegerType& t) {
@@ -216,15 +220,15 @@ bool checkOverflowSub(APInt ax, APInt ay, const IntegerType& t) {
     return overflow;
 }
 
-std::string RangeAnalysisPlugin::canOverflowSub(const Range& a,
+QueryResult RangeAnalysisPlugin::canOverflowSub(const Range& a,
         const Range& b, const IntegerType& t)
 {
     if (checkOverflowSub(a.getUpper(), b.getLower(), t) ||
 	checkOverflowSub(a.getLower(), b.getUpper(), t)) {
-        return "true";
+        return QueryResult::True;
     }
 
-    return "false";
+    return QueryResult::False;
 }
 
 bool checkOverflowMul(APInt ax, APInt ay, const IntegerType& t) {
@@ -239,48 +243,542 @@ bool checkOverflowMul(APInt ax, APInt ay, const IntegerType& t) {
     return overflow;
 }
 
-std::string RangeAnalysisPlugin::canOverflowMul(const Range& a,
+QueryResult RangeAnalysisPlugin::canOverflowMul(const Range& a,
         const Range& b, const IntegerType& t)
 {
     if (checkOverflowMul(a.getUpper(), b.getUpper(), t) ||
 	checkOverflowMul(a.getLower(), b.getLower(), t) ||
 	checkOverflowMul(a.getUpper(), b.getLower(), t) ||
 	checkOverflowMul(a.getLower(), b.getUpper(), t)) {
-        return "true";
+        return QueryResult::True;
     }
 
-    return "false";
+    return QueryResult::False;
 }
 
-std::string RangeAnalysisPlugin::canOverflowDiv(const Range& a,
+QueryResult RangeAnalysisPlugin::canOverflowDiv(const Range& a,
         const Range& b, const IntegerType& t)
 {
     // TODO: Check also for division by zero?
     // if (b.getLower() <= 0 && b.getUpper() >= 0)
-    //    return "true";
+    //    return QueryResult::True;
 
     if (a.getLower().signedRoundToDouble() <= (-std::pow(2, t.getBitWidth() - 1))
          && b.getLower().signedRoundToDouble() <= -1
          && b.getUpper().signedRoundToDouble() >= -1)
-        return "true";
+        return QueryResult::True;
 
-    return "false";
+    return QueryResult::False;
 }
 
-static const std::string supportedQueries[] = {
-    "canOverflow",
-    "canBeZero",
-};
+bool RangeAnalysisPlugin::setOption(const std::string& name, const std::string& value) {
+    if (name == "jobs") {
+        char *end;
+        unsigned long number = std::strtoul(value.c_str(), &end, 10);
+        if (value.empty() || *end != '\0' || number == 0)
+            return false;
+        jobs = number;
+        return true;
+    }
+    if (name == "sccJobs") {
+        char *end;
+        unsigned long number = std::strtoul(value.c_str(), &end, 10);
+        if (value.empty() || *end != '\0' || number == 0)
+            return false;
+        sccJobs = number;
+        return true;
+    }
+    if (name == "lazy") {
+        if (value != "true" && value != "false")
+            return false;
+        lazy = value == "true";
+        return true;
+    }
+    if (name == "solver") {
+        if (value != "classic" && value != "csr")
+            return false;
+        csrSolver = value == "csr";
+        return true;
+    }
+    if (name == "interprocedural") {
+        if (value != "true" && value != "false")
+            return false;
+        interprocedural = value == "true";
+        return true;
+    }
+    if (name == "maxIterations") {
+        char *end;
+        unsigned long number = std::strtoul(value.c_str(), &end, 10);
+        if (value.empty() || *end != '\0' || number == 0)
+            return false;
+        maxIterations = number;
+        return true;
+    }
+    if (name == "maxGraphs") {
+        char *end;
+        unsigned long number = std::strtoul(value.c_str(), &end, 10);
+        if (value.empty() || *end != '\0')
+            return false;
+        maxGraphs = number;
+        return true;
+    }
+    return false;
+}
 
-bool RangeAnalysisPlugin::supports(const std::string& query) {
-    for (unsigned idx = 0; idx < sizeof(supportedQueries)/sizeof(*supportedQueries); ++idx) {
-        if (query == supportedQueries[idx])
-            return true;
+void RangeTable::build(const ConstraintGraph& CG) {
+    entries.reserve(CG.vars.size());
+    for (const auto& var : CG.vars) {
+        Range r = var.second->getRange();
+
+        Entry entry;
+        entry.value = var.first;
+        entry.bitWidth = r.getLower().getBitWidth();
+        entry.type = r.isRegular() ? Regular : (r.isEmpty() ? Empty : Unknown);
+        if (entry.bitWidth <= 64) {
+            entry.lower = r.getLower().getSExtValue();
+            entry.upper = r.getUpper().getSExtValue();
+        } else {
+            entry.lower = entry.upper = wide.size();
+            wide.emplace_back(r.getLower(), r.getUpper());
+        }
+        entries.push_back(entry);
+        bitWidth = std::max(bitWidth, entry.bitWidth);
     }
 
-    return false;
+    std::sort(entries.begin(), entries.end());
+    entries.shrink_to_fit();
+    wide.shrink_to_fit();
+}
+
+Range RangeTable::getRange(const Value *value) const {
+    Entry key;
+    key.value = value;
+    auto it = std::lower_bound(entries.begin(), entries.end(), key);
+    if (it == entries.end() || it->value != value)
+        return Range(APInt::getSignedMinValue(bitWidth),
+                     APInt::getSignedMaxValue(bitWidth), Unknown);
+
+    Range r;
+    if (it->bitWidth > 64) {
+        r.setLower(wide[it->lower].first);
+        r.setUpper(wide[it->lower].second);
+    } else {
+        r.setLower(APInt(it->bitWidth, it->lower, true));
+        r.setUpper(APInt(it->bitWidth, it->upper, true));
+    }
+
+    // the constructor of Range would change the type of some ranges
+    if (it->type == Unknown)
+        r.setUnknown();
+    else if (it->type == Empty)
+        r.setEmpty();
+    return r;
+}
+
+void RangeAnalysisPlugin::analyze(Function& F, RangeTable& table) {
+    IntraProceduralRA ra;
+
+    // Summaries are only read here, so more functions can be analyzed
+    // at once while they are not updated
+    if (!summaries.empty()) {
+        for (auto& arg : F.args()) {
+            auto it = summaries.find(&arg);
+            if (it != summaries.end() && it->second.known)
+                ra.setEntryRange(&arg, it->second.lower, it->second.upper);
+        }
+        for (auto& block : F) {
+            for (auto& inst : block) {
+                auto *call = dyn_cast<CallBase>(&inst);
+                if (!call || !call->getCalledFunction())
+                    continue;
+                auto it = summaries.find(call->getCalledFunction());
+                if (it != summaries.end() && it->second.known &&
+                    call->getType() == call->getCalledFunction()->getReturnType())
+                    ra.setEntryRange(call, it->second.lower, it->second.upper);
+            }
+        }
+    }
+
+    Cousot CG = ra.run(F, csrSolver, sccJobs);
+    table.build(CG);
+    // this is the only copy of the graph now
+    CG.clear();
+}
+
+const RangeTable *RangeAnalysisPlugin::getTable(Function *F) {
+    auto it = RA.find(F);
+    if (!lazy)
+        return it == RA.end() ? nullptr : &it->second;
+
+    if (it != RA.end()) {
+        recent.splice(recent.begin(), recent, recentPos[F]);
+        return &it->second;
+    }
+
+    // Queries are serialized (the plugin is not thread-safe),
+    // so the function can be analyzed right here
+    it = RA.emplace(F, RangeTable()).first;
+    analyze(*F, it->second);
+    recent.push_front(F);
+    recentPos[F] = recent.begin();
+
+    // Forget the table of the least recently queried function,
+    // it is analyzed again if it is queried later
+    if (maxGraphs > 0 && RA.size() > maxGraphs) {
+        Function *old = recent.back();
+        recent.pop_back();
+        recentPos.erase(old);
+        RA.erase(old);
+    }
+
+    return &it->second;
+}
+
+void RangeAnalysisPlugin::analyzeAll(const std::vector<Function*>& functions) {
+    // The functions are analyzed independently on more threads, each task
+    // has its own constraint graph (and the bit width of RangeAnalysis
+    // is thread-local). The entries of the map are created first, so that
+    // the tasks only fill them.
+    std::vector<RangeTable*> tables;
+    for (Function *F : functions)
+        tables.push_back(&RA[F]);
+
+    std::atomic<size_t> next(0);
+    auto worker = [this, &functions, &tables, &next]() {
+        size_t i;
+        while ((i = next++) < functions.size()) {
+            *tables[i] = RangeTable();
+            analyze(*functions[i], *tables[i]);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    unsigned threadsNum = std::min<size_t>(jobs, functions.size());
+    for (unsigned i = 1; i < threadsNum; ++i)
+        threads.emplace_back(worker);
+    worker();
+    for (auto& thread : threads)
+        thread.join();
 }
 
-extern "C" InstrPlugin* create_object(llvm::Module* module) {
+// whether all calls of the function are known, so that its arguments
+// can be given by the summaries
+static bool hasKnownCalls(const Function& F) {
+    return F.hasLocalLinkage() && !F.isVarArg() && !F.hasAddressTaken();
+}
+
+// whether the calls of the function return its returned values
+static bool hasKnownReturns(const Function& F) {
+    return F.getReturnType()->isIntegerTy() && !F.isInterposable();
+}
+
+// changes of a summary after which its moving bounds are widened
+static const unsigned summaryWidening = 3;
+
+bool RangeAnalysisPlugin::getSummaryRange(const RangeTable& table, Value *value,
+                                          APInt& lower, APInt& upper) const {
+    unsigned width = value->getType()->getIntegerBitWidth();
+    lower = APInt::getSignedMinValue(width);
+    upper = APInt::getSignedMaxValue(width);
+
+    if (auto *constant = dyn_cast<ConstantInt>(value)) {
+        lower = upper = constant->getValue();
+        return true;
+    }
+
+    Range r = table.getRange(value);
+    if (r.isUnknown()) {
+        // Values that are not used by the analyzed instructions are not
+        // in the table, but arguments and results of calls may have
+        // summaries
+        const Value *key = nullptr;
+        if (isa<Argument>(value))
+            key = value;
+        else if (auto *call = dyn_cast<CallBase>(value))
+            key = call->getCalledFunction();
+
+        auto it = key ? summaries.find(key) : summaries.end();
+        if (it != summaries.end() && it->second.known) {
+            lower = it->second.lower;
+            upper = it->second.upper;
+        }
+        return true;
+    }
+
+    // the value is not computed at all
+    if (r.isEmpty())
+        return false;
+
+    // the range has the bit width of the function, it can be wider
+    // than the type when the analysis does not wrap the values
+    if (r.getLower().getBitWidth() < width) {
+        lower = r.getLower().sext(width);
+        upper = r.getUpper().sext(width);
+    } else if (r.getLower().isSignedIntN(width) && r.getUpper().isSignedIntN(width)) {
+        lower = r.getLower().trunc(width);
+        upper = r.getUpper().trunc(width);
+    }
+    return true;
+}
+
+bool RangeAnalysisPlugin::updateSummary(const Value *key, bool known,
+                                        APInt lower, APInt upper) {
+    Summary& summary = summaries[key];
+    if (!known || (summary.known && lower == summary.lower && upper == summary.upper))
+        return false;
+
+    // The summary keeps changing (on recursive calls), so the bounds
+    // that move are widened to the bounds of the type
+    if (summary.known && ++summary.changes > summaryWidening) {
+        lower = lower.slt(summary.lower)
+                ? APInt::getSignedMinValue(lower.getBitWidth()) : summary.lower;
+        upper = upper.sgt(summary.upper)
+                ? APInt::getSignedMaxValue(upper.getBitWidth()) : summary.upper;
+        if (lower == summary.lower && upper == summary.upper)
+            return false;
+    }
+
+    summary.known = true;
+    summary.lower = lower;
+    summary.upper = upper;
+    return true;
+}
+
+void RangeAnalysisPlugin::computeSummaries() {
+    // defined functions and the direct calls among them
+    std::vector<Function*> functions;
+    std::unordered_map<const Function*, unsigned> index;
+    for (auto& f : *module) {
+        if (f.isDeclaration())
+            continue;
+        index[&f] = functions.size();
+        functions.push_back(&f);
+    }
+
+    unsigned n = functions.size();
+    std::vector<std::vector<unsigned>> callees(n), callers(n);
+    std::vector<std::vector<CallBase*>> calls(n);
+    for (unsigned f = 0; f < n; ++f) {
+        for (auto& block : *functions[f]) {
+            for (auto& inst : block) {
+                auto *call = dyn_cast<CallBase>(&inst);
+                if (!call || !call->getCalledFunction())
+                    continue;
+                auto it = index.find(call->getCalledFunction());
+                if (it == index.end())
+                    continue;
+                calls[it->second].push_back(call);
+                callees[f].push_back(it->second);
+                callers[it->second].push_back(f);
+            }
+        }
+    }
+    for (unsigned f = 0; f < n; ++f) {
+        for (auto *list : {&callees[f], &callers[f]}) {
+            std::sort(list->begin(), list->end());
+            list->erase(std::unique(list->begin(), list->end()), list->end());
+        }
+    }
+
+    // Strongly connected components of the call graph (Tarjan's algorithm),
+    // they are found callees first, so the level of a component (the length
+    // of the longest path to a function it calls) is known when it is found
+    std::vector<unsigned> order(n, ~0u), lowlink(n), level(n, ~0u), stack;
+    std::vector<char> onStack(n, 0);
+    std::vector<std::pair<unsigned, size_t>> path;
+    unsigned counter = 0, levelsNum = 0;
+    for (unsigned root = 0; root < n; ++root) {
+        if (order[root] != ~0u)
+            continue;
+
+        order[root] = lowlink[root] = counter++;
+        stack.push_back(root);
+        onStack[root] = 1;
+        path.emplace_back(root, 0);
+        while (!path.empty()) {
+            unsigned f = path.back().first;
+            if (path.back().second < callees[f].size()) {
+                unsigned g = callees[f][path.back().second++];
+                if (order[g] == ~0u) {
+                    order[g] = lowlink[g] = counter++;
+                    stack.push_back(g);
+                    onStack[g] = 1;
+                    path.emplace_back(g, 0);
+                } else if (onStack[g]) {
+                    lowlink[f] = std::min(lowlink[f], order[g]);
+                }
+                continue;
+            }
+
+            path.pop_back();
+            if (!path.empty()) {
+                unsigned parent = path.back().first;
+                lowlink[parent] = std::min(lowlink[parent], lowlink[f]);
+            }
+            if (lowlink[f] != order[f])
+                continue;
+
+            // the callees out of the component are in finished components
+            auto first = std::find(stack.begin(), stack.end(), f);
+            unsigned l = 0;
+            for (auto it = first; it != stack.end(); ++it) {
+                onStack[*it] = 0;
+                for (unsigned g : callees[*it]) {
+                    if (level[g] != ~0u)
+                        l = std::max(l, level[g] + 1);
+                }
+            }
+            for (auto it = first; it != stack.end(); ++it)
+                level[*it] = l;
+            stack.erase(first, stack.end());
+            levelsNum = std::max(levelsNum, l + 1);
+        }
+    }
+
+    std::vector<std::vector<unsigned>> levels(levelsNum);
+    for (unsigned f = 0; f < n; ++f)
+        levels[level[f]].push_back(f);
+
+    // Updates the summaries that depend on the table of the function
+    // and marks the functions that use the changed ones
+    std::vector<char> dirty(n, 1);
+    auto refresh = [&](unsigned f) {
+        Function *F = functions[f];
+        if (hasKnownReturns(*F)) {
+            bool known = false;
+            APInt lower, upper, l, u;
+            for (auto& block : *F) {
+                auto *ret = dyn_cast<ReturnInst>(block.getTerminator());
+                if (!ret || !ret->getReturnValue() ||
+                    !getSummaryRange(RA[F], ret->getReturnValue(), l, u))
+                    continue;
+                lower = known ? APIntOps::smin(lower, l) : l;
+                upper = known ? APIntOps::smax(upper, u) : u;
+                known = true;
+            }
+            if (updateSummary(F, known, lower, upper)) {
+                for (unsigned c : callers[f])
+                    dirty[c] = 1;
+            }
+        }
+
+        for (unsigned g : callees[f]) {
+            if (!hasKnownCalls(*functions[g]))
+                continue;
+            for (auto& arg : functions[g]->args()) {
+                if (!arg.getType()->isIntegerTy())
+                    continue;
+                bool known = false;
+                APInt lower, upper, l, u;
+                for (CallBase *call : calls[g]) {
+                    if (!getSummaryRange(RA[call->getFunction()],
+                                         call->getArgOperand(arg.getArgNo()), l, u))
+                        continue;
+                    lower = known ? APIntOps::smin(lower, l) : l;
+                    upper = known ? APIntOps::smax(upper, u) : u;
+                    known = true;
+                }
+                if (updateSummary(&arg, known, lower, upper))
+                    dirty[g] = 1;
+            }
+        }
+    };
+
+    // Functions of the same level do not call each other, so they are
+    // analyzed at once and the summaries are updated after the whole level
+    // in the order of the module, so they do not depend on the threads.
+    // The returned values go up from the callees, the arguments go down
+    // from the callers, so the levels are visited in both directions.
+    auto sweep = [&](bool bottomUp) {
+        for (unsigned k = 0; k < levelsNum; ++k) {
+            const auto& members = levels[bottomUp ? k : levelsNum - 1 - k];
+            std::vector<Function*> work;
+            std::vector<unsigned> analyzed;
+            for (unsigned f : members) {
+                if (!dirty[f])
+                    continue;
+                dirty[f] = 0;
+                work.push_back(functions[f]);
+                analyzed.push_back(f);
+            }
+            analyzeAll(work);
+            for (unsigned f : analyzed)
+                refresh(f);
+        }
+    };
+
+    unsigned iteration = 0;
+    while (std::find(dirty.begin(), dirty.end(), 1) != dirty.end()) {
+        if (iteration == maxIterations) {
+            // Some tables do not match the summaries, drop the summaries
+            llvm::errs() << "Range summaries not found in " << maxIterations
+                         << (maxIterations == 1 ? " iteration" : " iterations")
+                         << ", analyzing functions separately\n";
+            summaries.clear();
+            analyzeAll(functions);
+            return;
+        }
+        ++iteration;
+        sweep(true);
+        sweep(false);
+    }
+    summaryIterations = iteration;
+}
+
+void RangeAnalysisPlugin::initialize() {
+    if (interprocedural) {
+        llvm::errs() << "Running interprocedural range analysis...\n";
+        computeSummaries();
+        // the functions are analyzed again with the summaries in getTable()
+        if (lazy)
+            RA.clear();
+        llvm::errs() << "RA plugin done.\n";
+        return;
+    }
+
+    // functions are analyzed in getTable()
+    if (lazy)
+        return;
+
+    llvm::errs() << "Running range analysis...\n";
+
+    std::vector<Function*> functions;
+    for (auto& f : *module)
+        functions.push_back(&f);
+    analyzeAll(functions);
+
+    llvm::errs() << "RA plugin done.\n";
+}
+
+std::string RangeAnalysisPlugin::getStatistics() const {
+    if (!interprocedural)
+        return "";
+    if (summaryIterations == 0)
+        return "range analysis without summaries";
+    return "range analysis with summaries found in " +
+           std::to_string(summaryIterations) +
+           (summaryIterations == 1 ? " iteration" : " iterations");
+}
+
+void RangeAnalysisPlugin::bindQueries(const std::vector<std::string>& names) {
+    static const QueryHandlers<RangeAnalysisPlugin>::Entry entries[] = {
+        {"canOverflow", [](RangeAnalysisPlugin& p, ArrayRef<Value*> operands) {
+            assert(operands.size() == 1 && "Wrong number of operands");
+            return p.canOverflow(operands[0]);
+        }},
+        {"canBeZero", [](RangeAnalysisPlugin& p, ArrayRef<Value*> operands) {
+            assert(operands.size() == 1 && "Wrong number of operands");
+            return p.canBeZero(operands[0]);
+        }},
+    };
+    handlers.bind(names, entries);
+}
+
+// range analysis only reads the module
+extern "C" const unsigned instr_plugin_capabilities = PluginReadsModuleOnly;
+
+extern "C" InstrPluginV2* create_object_v2(llvm::Module* module, unsigned version) {
+    if (version != INSTR_PLUGIN_ABI_VERSION)
+        return nullptr;
     return new RangeAnalysisPlugin(module);
 }
@@ -4,53 +4,133 @@
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Value.h>
 #include <llvm/IR/Constants.h>
+#include <algorithm>
+#include <cstdint>
+#include <list>
 #include <map>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 #include "instr_plugin.hpp"
 #include "ra/RangeAnalysis.h"
 
-class RangeAnalysisPlugin : public InstrPlugin
+// Ranges of the values of a function found by the analysis, kept instead
+// of the constraint graph because the queries need nothing else
+class RangeTable
 {
 private:
-    std::map<llvm::Function*, Cousot> RA;
-    Range getRange(ConstraintGraph&, llvm::Value*);
-    std::string canOverflowTrunc(const Range&, const llvm::TruncInst&);
-    std::string canOverflowAdd(const Range&, const Range&,
+    struct Entry {
+        const llvm::Value *value;
+        // bounds of the range if the bit width is at most 64,
+        // otherwise the index of the bounds in wide
+        int64_t lower;
+        int64_t upper;
+        unsigned bitWidth;
+        RangeType type;
+
+        bool operator<(const Entry& other) const { return value < other.value; }
+    };
+
+    // sorted by values
+    std::vector<Entry> entries;
+    std::vector<std::pair<llvm::APInt, llvm::APInt>> wide;
+    // bit width of unknown ranges
+    unsigned bitWidth = 1;
+
+public:
+    /**
+     * Takes the ranges of the values from the graph.
+     * @param CG the analyzed constraint graph
+     */
+    void build(const ConstraintGraph& CG);
+
+    /**
+     * @param value the value
+     * @return range of the value, unknown range if it is not known
+     */
+    Range getRange(const llvm::Value *value) const;
+};
+
+class RangeAnalysisPlugin : public InstrPluginV2
+{
+private:
+    // Range of the values of an argument or of the returned values of
+    // a function over all its calls, the bounds have the bit width
+    // of the type
+    class Summary {
+    public:
+        // false if there is no call (return) to take the range from
+        bool known = false;
+        llvm::APInt lower;
+        llvm::APInt upper;
+        // how many times the range changed, it is widened after some
+        unsigned changes = 0;
+    };
+
+    QueryHandlers<RangeAnalysisPlugin> handlers;
+    llvm::Module *module;
+    std::map<llvm::Function*, RangeTable> RA;
+    // number of threads that analyze functions
+    unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+    // analyze functions only when they are queried
+    bool lazy = false;
+    // find the intervals by CSRConstraintGraph
+    bool csrSolver = false;
+    // number of threads that solve the SCCs of one function
+    unsigned sccJobs = 1;
+    // maximal number of tables kept in the lazy mode, 0 means no limit
+    unsigned maxGraphs = 0;
+    // use summaries of arguments and returned values of functions
+    bool interprocedural = false;
+    // maximal number of iterations over the call graph
+    unsigned maxIterations = 5;
+    // summaries of arguments (keyed by the arguments) and of returned
+    // values (keyed by the functions)
+    std::map<const llvm::Value*, Summary> summaries;
+    // iterations that found the summaries, 0 if they were not found
+    unsigned summaryIterations = 0;
+    // analyzed functions from the most recently queried (lazy mode)
+    std::list<llvm::Function*> recent;
+    std::unordered_map<llvm::Function*, std::list<llvm::Function*>::iterator> recentPos;
+    const RangeTable *getTable(llvm::Function*);
+    void analyze(llvm::Function&, RangeTable&);
+    void analyzeAll(const std::vector<llvm::Function*>&);
+    void computeSummaries();
+    bool getSummaryRange(const RangeTable&, llvm::Value*,
+                         llvm::APInt&, llvm::APInt&) const;
+    bool updateSummary(const llvm::Value*, bool, llvm::APInt, llvm::APInt);
+    Range getRange(const RangeTable&, llvm::Value*);
+    QueryResult canOverflowTrunc(const Range&, const llvm::TruncInst&);
+    QueryResult canOverflowAdd(const Range&, const Range&,
                                const llvm::IntegerType&);
-    std::string canOverflowMul(const Range&, const Range&,
+    QueryResult canOverflowMul(const Range&, const Range&,
                                const llvm::IntegerType&);
-    std::string canOverflowSub(const Range&, const Range&,
+    QueryResult canOverflowSub(const Range&, const Range&,
                                const llvm::IntegerType&);
-    std::string canOverflowDiv(const Range&, const Range&,
+    QueryResult canOverflowDiv(const Range&, const Range&,
                                const llvm::IntegerType&);
-    std::string canOverflowShl(const Range&, const Range&,
+    QueryResult canOverflowShl(const Range&, const Range&,
                                const llvm::IntegerType&);
-    std::string canOverflow(llvm::Value*);
-    std::string canBeZero(llvm::Value*);
+    QueryResult canOverflow(llvm::Value*);
+    QueryResult canBeZero(llvm::Value*);
 
 public:
-    bool supports(const std::string& query) override;
-    std::string query(const std::string& query,
-                      const std::vector<llvm::Value *>& operands) override
+    void bindQueries(const std::vector<std::string>& names) override;
+    bool supports(QueryId query) const override {
+        return handlers.supports(query);
+    }
+    QueryResult query(QueryId query,
+                      llvm::ArrayRef<llvm::Value *> operands) override
     {
-        if (query == "canOverflow") {
-            assert(operands.size() == 1 && "Wrong number of operands");
-            return canOverflow(operands[0]);
-        } else if (query == "canBeZero") {
-            assert(operands.size() == 1 && "Wrong number of operands");
-            return canBeZero(operands[0]);
-        } else {
-            return "unsupported query";
-        }
+        return handlers.answer(*this, query, operands);
     }
 
-    RangeAnalysisPlugin(llvm::Module* module) : InstrPlugin("RangeAnalysis") {
-        llvm::errs() << "Running range analysis...\n";
-        IntraProceduralRA ra;
-        for (auto& f : *module) {
-            RA.emplace(&f, ra.run(f));
-        }
-        llvm::errs() << "RA plugin done.\n";
-    }
+    RangeAnalysisPlugin(llvm::Module* module)
+        : InstrPluginV2("RangeAnalysis"), module(module) {}
+
+    bool setOption(const std::string& name, const std::string& value) override;
+    void initialize() override;
+    std::string getStatistics() const override;
 };
 
 #endif
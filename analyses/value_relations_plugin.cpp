@@ -8,12 +8,37 @@
 #include "dg/llvm/ValueRelations/RelationsAnalyzer.h"
 #include "dg/llvm/ValueRelations/StructureAnalyzer.h"
 
+#include <cstdlib>
+
 using namespace dg::vr;
 using Borders = ValueRelationsPlugin::Borders;
 
 ValueRelationsPlugin::ValueRelationsPlugin(llvm::Module *module)
-        : InstrPlugin("ValueRelationsPlugin"), structure(*module, codeGraph) {
+        : InstrPluginV2("ValueRelationsPlugin"), module(module), structure(*module, codeGraph) {
     assert(module);
+}
+
+bool ValueRelationsPlugin::setOption(const std::string &name, const std::string &value) {
+    if (name == "maxPass") {
+        char *end;
+        unsigned long number = std::strtoul(value.c_str(), &end, 10);
+        if (value.empty() || *end != '\0' || number == 0)
+            return false;
+        maxPass = number;
+        return true;
+    }
+    if (name == "maxMergedGraphs") {
+        char *end;
+        unsigned long number = std::strtoul(value.c_str(), &end, 10);
+        if (value.empty() || *end != '\0')
+            return false;
+        maxMergedGraphs = number;
+        return true;
+    }
+    return false;
+}
+
+void ValueRelationsPlugin::initialize() {
     GraphBuilder gb(*module, codeGraph);
     gb.build();
 
@@ -661,28 +686,84 @@ std::vector<bool> ValueRelationsPlugin::getValidMemory(const ValueRelations &rel
     return validMemory;
 }
 
-std::string ValueRelationsPlugin::isValidPointer(llvm::Value *ptr, llvm::Value *size) {
+const ValueRelationsPlugin::MergedRelations &
+ValueRelationsPlugin::getMergedRelations(const VRLocation &location, const llvm::Function *function,
+                                         const std::vector<CallRelation> &callRelations) {
+    auto it = mergedCache.find(&location);
+    if (it != mergedCache.end()) {
+        recent.splice(recent.begin(), recent, it->second.recentPos);
+        return it->second;
+    }
+
+    MergedRelations &result = mergedCache[&location];
+    recent.push_front(&location);
+    result.recentPos = recent.begin();
+
+    for (const CallRelation &callRels : callRelations) {
+        if (!satisfiesPreconditions(callRels, function)) {
+            result.unknown = true;
+            break;
+        }
+
+        auto validMemory = getValidMemory(location.relations, callRels.callSite->relations);
+        if (validMemory.empty()) {
+            result.unknown = true;
+            break;
+        }
+
+        std::unique_ptr<ValueRelations> merged(new ValueRelations());
+        // conflict during merge -> location is unreachable from call
+        // therefore it does not make sense to validate a memory access
+        if (!merge(location.relations, callRels, *merged))
+            continue;
+
+        if (!fillInBorderVals(function, *merged)) {
+            result.unknown = true;
+            break;
+        }
+
+        result.graphs.emplace_back(std::move(merged), std::move(validMemory));
+    }
+    if (result.unknown)
+        result.graphs.clear();
+    cachedGraphs += result.graphs.size();
+
+    // forget the least recently queried locations, their graphs
+    // are merged again if they are queried later
+    while (maxMergedGraphs > 0 && cachedGraphs > maxMergedGraphs && recent.size() > 1) {
+        auto old = mergedCache.find(recent.back());
+        recent.pop_back();
+        cachedGraphs -= old->second.graphs.size();
+        mergedCache.erase(old);
+    }
+
+    return result;
+}
+
+QueryResult ValueRelationsPlugin::isValidPointer(llvm::Value *ptr, llvm::Value *size) {
     assert(ptr->getType()->isPointerTy());
     auto inst = llvm::dyn_cast<llvm::Instruction>(ptr);
     if (!inst)
-        return "unknown";
+        return QueryResult::Unknown;
 
     bool correct;
     uint64_t readSize;
     std::tie(correct, readSize) = getReadSize(size);
     if (!correct)
-        return "unknown";
+        return QueryResult::Unknown;
     assert(readSize > 0 && readSize < ~((uint64_t) 0));
 
     if (!llvm::isa<llvm::GetElementPtrInst>(inst) && !llvm::isa<llvm::LoadInst>(inst))
-        return "unknown";
+        return QueryResult::Unknown;
 
-    const ValueRelations &relations = codeGraph.getVRLocation(inst).getSuccLocation(0)->relations;
+    const VRLocation &location = *codeGraph.getVRLocation(inst).getSuccLocation(0);
+    const ValueRelations &relations = location.relations;
     const std::vector<CallRelation> &callRelations = structure.getCallRelationsFor(inst);
 
     if (callRelations.empty())
-        return isValidForGraph(relations, relations.getValidAreas(), inst, readSize) ? "true"
-                                                                                     : "unknown";
+        return isValidForGraph(relations, relations.getValidAreas(), inst, readSize)
+                       ? QueryResult::True
+                       : QueryResult::Unknown;
 
 #if LLVM_VERSION_MAJOR == 3 && LLVM_VERSION_MINOR <= 7
     const llvm::Function *function = inst->getParent()->getParent();
@@ -691,31 +772,30 @@ std::string ValueRelationsPlugin::isValidPointer(llvm::Value *ptr, llvm::Value *
 #endif
 
     // else we have to check that access is valid in every case
-    for (const CallRelation &callRels : callRelations) {
-        if (!satisfiesPreconditions(callRels, function))
-            return "unknown";
-
-        auto validMemory = getValidMemory(relations, callRels.callSite->relations);
-        if (validMemory.empty())
-            return "unknown";
+    const MergedRelations &merged = getMergedRelations(location, function, callRelations);
+    if (merged.unknown)
+        return QueryResult::Unknown;
 
-        ValueRelations merged;
-        // conflict during merge -> location is unreachable from call
-        // therefore it does not make sense to validate a memory access
-        if (!merge(relations, callRels, merged))
-            continue;
-
-        bool result = fillInBorderVals(function, merged);
-        if (!result)
-            return "unknown";
-
-        result = isValidForGraph(merged, validMemory, inst, readSize);
-        if (!result)
-            return "unknown";
+    for (const auto &graph : merged.graphs) {
+        if (!isValidForGraph(*graph.first, graph.second, inst, readSize))
+            return QueryResult::Unknown;
     }
-    return "true";
+    return QueryResult::True;
 }
 
-extern "C" InstrPlugin *create_object(llvm::Module *module) {
+void ValueRelationsPlugin::bindQueries(const std::vector<std::string> &names) {
+    static const QueryHandlers<ValueRelationsPlugin>::Entry entries[] = {
+            {"isValidPointer",
+             [](ValueRelationsPlugin &p, llvm::ArrayRef<llvm::Value *> operands) {
+                 assert(operands.size() == 2 && "Wrong number of operands");
+                 return p.isValidPointer(operands[0], operands[1]);
+             }},
+    };
+    handlers.bind(names, entries);
+}
+
+extern "C" InstrPluginV2 *create_object_v2(llvm::Module *module, unsigned version) {
+    if (version != INSTR_PLUGIN_ABI_VERSION)
+        return nullptr;
     return new ValueRelationsPlugin(module);
 }
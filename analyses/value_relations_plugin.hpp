@@ -6,20 +6,43 @@
 #include "dg/llvm/ValueRelations/getValName.h"
 #include "instr_plugin.hpp"
 #include <llvm/IR/Value.h>
+#include <list>
+#include <map>
+#include <memory>
 #include <vector>
 
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Value.h>
 
-class ValueRelationsPlugin : public InstrPlugin {
+class ValueRelationsPlugin : public InstrPluginV2 {
   public:
     using Borders = std::map<size_t, const llvm::Value *>;
 
   private:
+    QueryHandlers<ValueRelationsPlugin> handlers;
+    llvm::Module *module;
     dg::vr::VRCodeGraph codeGraph;
     dg::vr::StructureAnalyzer structure;
 
-    const unsigned maxPass = 20;
+    // maximal number of passes of the relations analysis over the module
+    unsigned maxPass = 20;
+    // maximal number of merged graphs kept in mergedCache, 0 means no limit
+    unsigned maxMergedGraphs = 1000;
+
+    // relations of a location merged with the relations of each call
+    // of its function, shared by all accesses through the same pointer
+    struct MergedRelations {
+        // some call makes every access at the location unknown
+        bool unknown = false;
+        // merged graphs and valid memory for the calls that can reach the location
+        std::vector<std::pair<std::unique_ptr<dg::vr::ValueRelations>, std::vector<bool>>> graphs;
+        std::list<const dg::vr::VRLocation *>::iterator recentPos;
+    };
+
+    std::map<const dg::vr::VRLocation *, MergedRelations> mergedCache;
+    // cached locations from the most recently queried
+    std::list<const dg::vr::VRLocation *> recent;
+    size_t cachedGraphs = 0;
 
     std::vector<dg::vr::AllocatedSizeView>
     getAllocatedViews(const dg::vr::ValueRelations &relations, const std::vector<bool> &validMemory,
@@ -68,21 +91,23 @@ class ValueRelationsPlugin : public InstrPlugin {
     std::vector<bool> getValidMemory(const dg::vr::ValueRelations &relations,
                                      const dg::vr::ValueRelations &callRels) const;
 
-    std::string isValidPointer(llvm::Value *ptr, llvm::Value *len);
+    const MergedRelations &getMergedRelations(const dg::vr::VRLocation &location,
+                                              const llvm::Function *function,
+                                              const std::vector<dg::vr::CallRelation> &callRelations);
+
+    QueryResult isValidPointer(llvm::Value *ptr, llvm::Value *len);
 
   public:
-    bool supports(const std::string &query) override { return query == "isValidPointer"; }
-
-    std::string query(const std::string &query,
-                      const std::vector<llvm::Value *> &operands) override {
-        if (query == "isValidPointer") {
-            assert(operands.size() == 2 && "Wrong number of operands");
-            return isValidPointer(operands[0], operands[1]);
-        }
-        return "unsupported query";
+    void bindQueries(const std::vector<std::string> &names) override;
+    bool supports(QueryId query) const override { return handlers.supports(query); }
+    QueryResult query(QueryId query, llvm::ArrayRef<llvm::Value *> operands) override {
+        return handlers.answer(*this, query, operands);
     }
 
     ValueRelationsPlugin(llvm::Module *module);
+
+    bool setOption(const std::string &name, const std::string &value) override;
+    void initialize() override;
 };
 
 #endif
@@ -4,26 +4,109 @@
 #include <string>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Value.h>
+#include <functional>
 #include <list>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 #include "instr_plugin.hpp"
+#include "query_cache.hpp"
 #include "rewriter.hpp"
 
 class Logger;
 
-class Analyzer
+// Adapts a plugin with the string interface to the typed interface
+class StringPluginAdapter : public InstrPluginV2
 {
+    std::unique_ptr<InstrPlugin> plugin;
+    std::vector<std::string> queryNames;
+    // whether the plugin supports the query, indexed by ids of queries
+    std::vector<bool> supported;
+
+public:
+    StringPluginAdapter(std::unique_ptr<InstrPlugin> plugin)
+        : InstrPluginV2(plugin->getName()), plugin(std::move(plugin)) {}
+
+    void bindQueries(const std::vector<std::string>& names) override;
+    bool supports(QueryId query) const override;
+    QueryResult query(QueryId query,
+                      llvm::ArrayRef<llvm::Value *> operands) override;
+
+    bool isThreadSafe() const override { return plugin->isThreadSafe(); }
+    bool isCacheable(QueryId query) const override;
+};
+
+// Values remembered by rules together with the functions that the rules
+// call, each pair only once and in the order in which they were remembered
+class RememberedValues
+{
+public:
+    typedef std::pair<llvm::Value*, std::string> Entry;
 
-    using RememberedValues = std::vector<std::pair<llvm::Value*, std::string>>;
-    using ValuesVector = std::vector<llvm::Value*>;
+    /**
+     * @param value the remembered value
+     * @param function the function called by the rule
+     * @return false if the pair was remembered already
+     */
+    bool insert(llvm::Value* value, const std::string& function) {
+        Entry entry(value, function);
+        if (!index.insert(entry).second)
+            return false;
+        entries.push_back(std::move(entry));
+        return true;
+    }
+
+    std::vector<Entry>::const_iterator begin() const { return entries.begin(); }
+    std::vector<Entry>::const_iterator end() const { return entries.end(); }
+    size_t size() const { return entries.size(); }
+
+private:
+    struct EntryHash {
+        size_t operator()(const Entry& entry) const {
+            return std::hash<llvm::Value*>()(entry.first) ^
+                   (std::hash<std::string>()(entry.second) << 1);
+        }
+    };
+
+    std::vector<Entry> entries;
+    std::unordered_set<Entry, EntryHash> index;
+};
+
+class Analyzer
+{
 
 public:
-    static std::unique_ptr<InstrPlugin> analyze(const std::string &path,
-                                                llvm::Module* module);
+    /**
+     * Loads the plugin, plugins with the string interface
+     * are wrapped into StringPluginAdapter.
+     * @param path path to the library with the plugin
+     * @param module analyzed module
+     * @return the plugin or nullptr if it cannot be loaded
+     */
+    static std::unique_ptr<InstrPluginV2> analyze(const std::string &path,
+                                                  llvm::Module* module);
+    /**
+     * Gets the capabilities declared by the plugin library
+     * (instr_plugin_capabilities).
+     * @param path path to the library with the plugin
+     * @return the capabilities, 0 if the library declares none
+     *         or cannot be opened
+     */
+    static unsigned getCapabilities(const std::string &path);
+    /**
+     * Asks the plugin the query of the condition.
+     * @param answered set to false if the plugin answered that it does not
+     *        support the query (it cannot answer it after all), the plugin
+     *        is then ignored as if it was not loaded
+     * @return true if the answer is one of the expected results
+     */
     static bool shouldInstrument(const RememberedValues& rememberedValues,
-                                 InstrPlugin* plugin,
+                                 InstrPluginV2* plugin,
                                  const Condition &condition,
-                                 const ValuesVector& parameters,
-                                 Logger& logger);
+                                 llvm::ArrayRef<llvm::Value*> parameters,
+                                 QueryCache& cache,
+                                 Logger& logger,
+                                 bool& answered);
 
 private:
      Analyzer() {}
@@ -3,6 +3,7 @@
 
 #include <ostream>
 #include <iostream>
+#include <mutex>
 #include <string>
 
 #include <llvm/IR/Function.h>
@@ -12,6 +13,8 @@
 
 class Logger {
     std::ofstream stream;
+    // the log is written from more threads when planning in parallel
+    std::mutex mutex;
   public:
     Logger(const std::string& path) {
         stream.open(path, std::ios::out | std::ios::trunc);
@@ -23,6 +26,7 @@ class Logger {
     }
 
     void write_error(const std::string &text, bool totty = false) {
+        std::lock_guard<std::mutex> lock(mutex);
         stream << "Error: " << text << "\n";
         if (totty) {
             std::cerr << "Error: " << text << "\n";
@@ -30,6 +34,7 @@ class Logger {
     }
 
     void write_info(const std::string &text, bool totty = false) {
+        std::lock_guard<std::mutex> lock(mutex);
         stream << "Info: " << text << "\n";
         if (totty) {
             std::cout << "Info: " << text << "\n";
@@ -51,7 +56,7 @@ class Logger {
      * @param foundInstrs found instructions for instrumentation
      * @param newInstr name of the new instruction
      */
-    void log_insertion(InstrumentSequence foundInstrs, std::string newInstr);
+    void log_insertion(const InstrumentSequence& foundInstrs, const std::string& newInstr);
 };
 
 #endif
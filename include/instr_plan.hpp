@@ -0,0 +1,79 @@
+#ifndef INSTR_PLAN_H
+#define INSTR_PLAN_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Instruction.h>
+#include <llvm/IR/Module.h>
+
+#include "json/json.h"
+
+// Kinds of planned insertions of calls
+enum class InsertionKind {
+    BEFORE,  // before the site
+    AFTER,   // after the site
+    REPLACE, // after the site, then the replaced instructions are removed
+    ENTRY,   // at the beginning of the function, without arguments
+    RETURN,  // before the site (a return instruction), without arguments
+    GLOBAL   // before the first instruction of the function
+};
+
+// Argument of a planned call
+class PlannedArgument {
+ public:
+    // nullptr if the argument could not be bound and is skipped
+    llvm::Value *value = nullptr;
+    // the value is cast to the type of the parameter when it differs
+    bool cast = false;
+};
+
+// Insertion of one call instruction
+class Insertion {
+ public:
+    InsertionKind kind = InsertionKind::BEFORE;
+    // function to which the call is inserted
+    llvm::Function *function = nullptr;
+    // instruction relative to which the call is inserted,
+    // nullptr for ENTRY and GLOBAL
+    llvm::Instruction *site = nullptr;
+    // index of the rule that planned the insertion (rules for instructions
+    // go first, then rules for global variables)
+    unsigned rule = 0;
+    std::vector<PlannedArgument> arguments;
+    // instructions removed by REPLACE in the order of the sequence
+    std::vector<llvm::Instruction*> replaced;
+};
+
+// Insertions planned in one phase in the order they are applied
+class PhasePlan {
+ public:
+    // names of functions called by the rules, indexed by rules
+    std::vector<std::string> callees;
+    std::vector<Insertion> insertions;
+    // number of insertions of each function blocked by conditions
+    std::map<std::string, unsigned> suppressed;
+};
+
+/**
+ * Serializes the plan of a phase. Instructions are identified by their
+ * position in the function, so this must be called before the plan
+ * is applied.
+ * @param plan plan of the phase
+ * @param M module the plan was made for
+ * @return the plan in json
+ */
+Json::Value planToJson(const PhasePlan& plan, const llvm::Module& M);
+
+/**
+ * Loads the plan of a phase made for the module in its current state.
+ * Throws runtime_error if the plan does not fit the module.
+ * @param json the plan in json
+ * @param M module to which the plan will be applied
+ * @param plan loaded plan
+ */
+void planFromJson(const Json::Value& json, llvm::Module& M, PhasePlan& plan);
+
+#endif
@@ -1,8 +1,36 @@
 #ifndef INSTR_PLUGIN_H
 #define INSTR_PLUGIN_H
 
+#include <atomic>
+#include <cassert>
+#include <mutex>
 #include <string>
+#include <vector>
 
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/IR/Value.h>
+
+#include "query.hpp"
+
+// Version of the interface InstrPluginV2. Plugins with this interface
+// export
+//
+//   extern "C" InstrPluginV2* create_object_v2(llvm::Module*, unsigned version);
+//
+// that returns nullptr if the plugin does not implement the version.
+// Plugins with the string interface InstrPlugin export create_object.
+#define INSTR_PLUGIN_ABI_VERSION 3
+
+// Capabilities of plugins, a plugin library declares them by exporting
+//
+//   extern "C" const unsigned instr_plugin_capabilities = ...;
+//
+// Creating the plugin (and its initialize()) only reads the module,
+// it changes neither the module nor the LLVM context (no new constants,
+// types or metadata), so it can run concurrently with other such plugins.
+const unsigned PluginReadsModuleOnly = 1u << 0;
+
+// Plugin with the string interface (version 1)
 class InstrPlugin
 {
     private:
@@ -15,6 +43,16 @@ class InstrPlugin
 
       const std::string& getName() { return name; }
 
+      // Whether query() can be called from more threads at once
+      // (and does not change the module or the LLVM context).
+      // Queries of plugins that are not thread-safe are serialized,
+      // supports() must always be thread-safe.
+      virtual bool isThreadSafe() const { return false; }
+
+      // Whether the answer to the query depends only on its operands,
+      // so that it can be reused when the same query is asked again
+      virtual bool isCacheable(const std::string& /*query*/) const { return true; }
+
       InstrPlugin() {}
       InstrPlugin(const std::string& pluginName) : name(pluginName) {}
 
@@ -23,4 +61,132 @@ class InstrPlugin
       virtual ~InstrPlugin() {}
 };
 
+// Query that is answered together with other queries
+class BatchQuery
+{
+    public:
+      QueryId query;
+      llvm::ArrayRef<llvm::Value *> operands;
+      // filled in by the plugin
+      QueryResult result = QueryResult::Unknown;
+};
+
+// Plugin with the typed interface (version 2). The core tells the plugin
+// names of all queries it may ask right after the plugin is created,
+// the queries are then identified by their positions in the names.
+class InstrPluginV2
+{
+    private:
+      std::string name{};
+      std::once_flag initializeOnce;
+      std::atomic<bool> initialized{false};
+
+    public:
+      /**
+       * Sets an option given for the plugin in the config (pluginOptions)
+       * or on the command line, called before bindQueries().
+       * @param name name of the option
+       * @param value value of the option
+       * @return false if the option or its value is not valid
+       */
+      virtual bool setOption(const std::string& /*name*/,
+                             const std::string& /*value*/) { return false; }
+
+      /**
+       * Called once before any query is asked.
+       * @param names names of queries indexed by their ids
+       */
+      virtual void bindQueries(const std::vector<std::string>& names) = 0;
+      virtual bool supports(QueryId query) const = 0;
+      virtual QueryResult query(QueryId query,
+                                llvm::ArrayRef<llvm::Value *> operands) = 0;
+
+      /**
+       * Answers more queries at once, usually all queries about one function.
+       * Plugins can override this to share work among the queries,
+       * by default query() is asked for each of them.
+       * @param queries supported queries, the answers are stored in them
+       */
+      virtual void queryBatch(llvm::MutableArrayRef<BatchQuery> queries) {
+          for (BatchQuery& q : queries)
+              q.result = query(q.query, q.operands);
+      }
+
+      /**
+       * Runs the analysis of the plugin. The core calls it once before
+       * the first query (right after creating the plugin unless plugins
+       * are initialized lazily), so the constructor should do only
+       * what bindQueries() and supports() need.
+       */
+      virtual void initialize() {}
+
+      // Calls initialize() if it has not been called yet,
+      // can be called from more threads at once
+      void ensureInitialized() {
+          std::call_once(initializeOnce, [this]() {
+              initialize();
+              initialized = true;
+          });
+      }
+
+      bool isInitialized() const { return initialized; }
+
+      // Information about the analysis of the plugin for the statistics,
+      // empty if there is none
+      virtual std::string getStatistics() const { return ""; }
+
+      const std::string& getName() const { return name; }
+
+      // Same as for InstrPlugin
+      virtual bool isThreadSafe() const { return false; }
+      virtual bool isCacheable(QueryId /*query*/) const { return true; }
+      // Answering the query changes the state of the plugin, so that
+      // the answers to later queries depend on the order of the queries
+      virtual bool changesState(QueryId /*query*/) const { return false; }
+
+      InstrPluginV2() {}
+      InstrPluginV2(const std::string& pluginName) : name(pluginName) {}
+
+      virtual ~InstrPluginV2() {}
+};
+
+// Table of queries of a plugin with the typed interface, maps ids
+// of queries to the functions that answer them.
+template <typename Plugin>
+class QueryHandlers
+{
+    public:
+      typedef QueryResult (*Handler)(Plugin&, llvm::ArrayRef<llvm::Value *>);
+
+      class Entry {
+       public:
+          const char *name;
+          Handler handler;
+      };
+
+      template <size_t N>
+      void bind(const std::vector<std::string>& names, const Entry (&entries)[N]) {
+          handlers.assign(names.size(), nullptr);
+          for (QueryId id = 0; id < names.size(); ++id) {
+              for (const Entry& entry : entries) {
+                  if (names[id] == entry.name)
+                      handlers[id] = entry.handler;
+              }
+          }
+      }
+
+      bool supports(QueryId query) const {
+          return query < handlers.size() && handlers[query];
+      }
+
+      QueryResult answer(Plugin& plugin, QueryId query,
+                         llvm::ArrayRef<llvm::Value *> operands) const {
+          assert(supports(query) && "Unsupported query");
+          return handlers[query](plugin, operands);
+      }
+
+    private:
+      std::vector<Handler> handlers;
+};
+
 #endif
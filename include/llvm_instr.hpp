@@ -1,9 +1,13 @@
 #ifndef LLVM_INSTR_H
 #define LLVM_INSTR_H
 
+#include <array>
+#include <deque>
 #include <list>
 #include <string>
 #include <map>
+#include <mutex>
+#include <unordered_set>
 
 #include "rewriter.hpp"
 #include "instr_analyzer.hpp"
@@ -11,21 +15,54 @@
 
 #include <llvm/IR/Module.h>
 
-typedef std::map<std::string, llvm::Value*> Variables;
+// Values of variables of a rule, indexed by slots of the variables
+typedef std::array<llvm::Value*, MaxRuleVariables> Variables;
+
+// State of matching sequences of instructions in a basic block
+class SequenceScan {
+    public:
+        SequenceMatcher::State state = SequenceMatcher::Start;
+        // last instructions fed to the matcher (at most the length
+        // of the longest sequence), the last one is the current one
+        std::deque<llvm::Instruction*> window;
+
+        void reset() {
+            state = SequenceMatcher::Start;
+            window.clear();
+        }
+};
 
 class LLVMInstrumentation {
     public:
         llvm::Module& module;
         llvm::Module& definitionsModule;
-        std::list<std::unique_ptr<InstrPlugin>> plugins;
+        std::list<std::unique_ptr<InstrPluginV2>> plugins;
+        // plugins that support the query, indexed by ids of queries
+        std::vector<std::vector<InstrPluginV2*>> queryPlugins;
         std::string outputName;
-        std::vector<std::pair<llvm::Value*, std::string>> rememberedValues;
-        std::vector<llvm::Value*> rememberedPTSets;
+        RememberedValues rememberedValues;
+        // points-to sets of rememberedValues united by ppPlugin
+        RememberedPointsTo rememberedPointsTo;
+        // targets of remembered points-to sets (for isRemembered+)
+        std::unordered_set<llvm::Value*> rememberedPTSets;
         bool rememberedUnknown = false;
-        Variables variables;
         Rewriter rewriter;
+        // functions called by the rules of the current phase,
+        // looked up when the rule is applied for the first time
+        std::vector<llvm::Function*> callees;
 		std::set<const llvm::Function*> reachableFunctions;
         PointsToPlugin* ppPlugin = nullptr;
+        // number of threads that plan the instrumentation of functions
+        unsigned jobs = 1;
+        // analyses of plugins run when they are asked the first query
+        bool lazyPlugins = false;
+        // serializes changes of data shared by functions while planning
+        // in parallel: creating constants in the LLVM context, computing
+        // sizes of types (the data layout caches them) and queries
+        // of plugins that are not thread-safe
+        std::mutex contextLock;
+        // answers of plugins to queries
+        QueryCache queryCache{contextLock};
 
 
         LLVMInstrumentation(llvm::Module& m, llvm::Module& dm)
@@ -0,0 +1,52 @@
+#ifndef QUERY_H
+#define QUERY_H
+
+#include <string>
+
+// Queries to plugins are identified by numbers that the core assigns
+// to their names when it loads the configuration
+typedef unsigned QueryId;
+
+// Queries asked by the core itself (for isRemembered and pointsToRemembered),
+// they always get these numbers
+const QueryId PointsToQuery = 0;
+const QueryId PointsToSetsOverlapQuery = 1;
+
+// Answers of plugins to queries
+enum class QueryResult : unsigned char {
+    True,
+    False,
+    Maybe,
+    Unknown,
+    // the plugin did not recognize the query or its answer
+    Unsupported
+};
+
+// Set of answers, the bit of an answer is toQueryResults(answer)
+typedef unsigned QueryResults;
+
+inline QueryResults toQueryResults(QueryResult result) {
+    return 1u << static_cast<unsigned>(result);
+}
+
+inline const char *getQueryResultName(QueryResult result) {
+    static const char *names[] = {
+        "true", "false", "maybe", "unknown", "unsupported query"
+    };
+    return names[static_cast<unsigned>(result)];
+}
+
+/**
+ * Converts the answer of a plugin with the string interface.
+ * @param name answer of the plugin
+ * @return the answer, Unsupported if it is not known
+ */
+inline QueryResult parseQueryResult(const std::string& name) {
+    for (unsigned r = 0; r < static_cast<unsigned>(QueryResult::Unsupported); ++r) {
+        if (name == getQueryResultName(static_cast<QueryResult>(r)))
+            return static_cast<QueryResult>(r);
+    }
+    return QueryResult::Unsupported;
+}
+
+#endif
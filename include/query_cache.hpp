@@ -0,0 +1,127 @@
+#ifndef QUERY_CACHE_H
+#define QUERY_CACHE_H
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/IR/Value.h>
+
+#include "instr_plugin.hpp"
+
+class QueryBatch;
+
+// Answers of plugins to queries, so that a plugin is asked only once
+// about the same values no matter how many rules, phases or conditions
+// ask it (plugins analyze the module when they are loaded, so the answers
+// do not change while instrumenting).
+class QueryCache {
+ public:
+    // Queries with more operands are not cached
+    static const unsigned MaxOperands = 3;
+
+    /**
+     * @param pluginLock lock that serializes queries of plugins
+     *        that are not thread-safe
+     */
+    QueryCache(std::mutex& pluginLock) : pluginLock(pluginLock) {}
+
+    /**
+     * Gets the answer of the plugin to the query, asks the plugin only
+     * if the answer is not known yet or the query is not cacheable.
+     * @param plugin the plugin
+     * @param query id of the query
+     * @param operands operands of the query
+     * @return the answer of the plugin
+     */
+    QueryResult query(InstrPluginV2* plugin, QueryId query,
+                      llvm::ArrayRef<llvm::Value*> operands);
+
+    /**
+     * Asks each plugin all the queries of the batch that are not answered
+     * yet in one call, so that the answers are then found in the cache.
+     * @param batch collected queries
+     */
+    void answerBatch(const QueryBatch& batch);
+
+    /**
+     * Forgets all answers, must be called when some values
+     * are removed from the module.
+     */
+    void clear();
+
+    uint64_t getHits() const { return hits; }
+    uint64_t getMisses() const { return misses; }
+    uint64_t getUncached() const { return uncached; }
+    uint64_t getBatches() const { return batches; }
+
+ private:
+    class Key {
+     public:
+        InstrPluginV2 *plugin;
+        QueryId query;
+        unsigned operandsNum;
+        std::array<llvm::Value*, MaxOperands> operands;
+
+        bool operator==(const Key& other) const {
+            return plugin == other.plugin && query == other.query &&
+                   operandsNum == other.operandsNum &&
+                   operands == other.operands;
+        }
+    };
+
+    class KeyHash {
+     public:
+        size_t operator()(const Key& key) const;
+    };
+
+    friend class QueryBatch;
+
+    /**
+     * Checks whether the plugin allows caching answers to the query,
+     * must be called with the lock held.
+     */
+    bool isCacheable(InstrPluginV2* plugin, QueryId query);
+
+    /**
+     * Initializes the plugin if it is not initialized yet
+     * (with plugins initialized lazily).
+     */
+    void initialize(InstrPluginV2* plugin);
+
+    std::mutex& pluginLock;
+    // guards all the members below
+    std::mutex lock;
+    // whether the plugin allows caching answers to the query
+    std::map<std::pair<const InstrPluginV2*, QueryId>, bool> cacheable;
+    std::unordered_map<Key, QueryResult, KeyHash> answers;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t uncached = 0;
+    uint64_t batches = 0;
+};
+
+// Queries collected to be answered at once by QueryCache::answerBatch
+class QueryBatch {
+ public:
+    /**
+     * Adds the query, queries that cannot be cached are ignored.
+     * @param plugin plugin that will be asked
+     * @param query id of the query
+     * @param operands operands of the query
+     */
+    void add(InstrPluginV2* plugin, QueryId query,
+             llvm::ArrayRef<llvm::Value*> operands);
+
+    bool empty() const { return keys.empty(); }
+
+ private:
+    friend class QueryCache;
+    std::vector<QueryCache::Key> keys;
+};
+
+#endif
@@ -8,6 +8,8 @@
 #include <fstream>
 #include <map>
 
+#include "query.hpp"
+
 // Configuration
 enum class InstrumentPlacement {
     BEFORE,
@@ -17,6 +19,13 @@ enum class InstrumentPlacement {
     ENTRY
 };
 
+// Maximal number of distinct variables (e.g., <t1>) in one rule
+const unsigned MaxRuleVariables = 16;
+// Slot of a name that is not a variable of the rule
+const int NoSlot = -1;
+// Slot of the special variable <this> that denotes the found instruction
+const int ThisSlot = -2;
+
 enum class BinOpType {
     NBOP,
     INT32,
@@ -25,6 +34,36 @@ enum class BinOpType {
     INT8
 };
 
+// Compiled operand of a found instruction
+enum class OperandKind {
+    ANY,      // "*", matches anything
+    VARIABLE, // "<x>", binds the operand to the variable
+    NAME      // matches the operand with the given name
+};
+
+class OperandPattern {
+ public:
+    OperandKind kind = OperandKind::ANY;
+    int slot = NoSlot;
+    bool stripInboundsOffsets = false;
+    std::string name;
+};
+
+// Compiled argument of a new instruction
+enum class ArgumentKind {
+    VARIABLE,
+    CONSTANT,
+    INVALID,     // not a variable nor a number
+    OUT_OF_RANGE // a number that does not fit into int
+};
+
+class CallArgument {
+ public:
+    ArgumentKind kind = ArgumentKind::INVALID;
+    int slot = NoSlot;
+    int value = 0;
+};
+
 class InstrumentInstruction {
  public:
     std::string returnValue;
@@ -37,12 +76,40 @@ class InstrumentInstruction {
     std::list<std::string> getPInfoMinMaxTo;
     BinOpType type;
     std::string getDestType;
+    // opcode of instruction (see llvm::Instruction::getOpcode()),
+    // 0 if the name does not denote any instruction
+    unsigned opcode = 0;
+
+    // Compiled form of the fields above (filled in by Rewriter::parseConfig).
+    // Variables are replaced by indices of slots where their values are bound.
+    int returnValueSlot = NoSlot;
+    int getSizeToSlot = NoSlot;
+    int getDestTypeSlot = NoSlot;
+    bool anyOperands = false;
+    std::vector<OperandPattern> operands;
+    std::vector<int> getPointerInfoSlots;
+    std::vector<int> getPointerInfoMinSlots;
+    std::vector<int> getPInfoMinMaxSlots;
+    // arguments and the called function of a new instruction
+    std::vector<CallArgument> arguments;
+    std::string calledFunction;
 };
 
 class InstrumentGlobalVar {
  public:
 	std::string globalVariable;
 	std::string getSizeTo;
+	int globalVariableSlot = NoSlot;
+	int getSizeToSlot = NoSlot;
+};
+
+// Kinds of conditions
+enum class ConditionKind {
+    QUERY,                // asks plugins the query of the condition
+    FLAG,                 // checks the value of a flag
+    IS_REMEMBERED,        // asks pointsTo about the remembered values
+    POINTS_TO_REMEMBERED, // asks pointsToSetsOverlap about the remembered values
+    IS_REMEMBERED_PLUS    // checks the remembered points-to sets, then asks plugins
 };
 
 class Condition {
@@ -50,6 +117,13 @@ class Condition {
         std::string name;
         std::list<std::string> arguments;
         std::list<std::string> expectedValues;
+        // slots of arguments, NoSlot if the argument is not a variable
+        std::vector<int> argumentSlots;
+        ConditionKind kind = ConditionKind::QUERY;
+        // id of the query asked to plugins
+        QueryId query = 0;
+        // expectedValues as a set of answers of plugins
+        QueryResults expectedResults = 0;
 };
 
 
@@ -60,6 +134,7 @@ class GlobalVarsRule {
     std::string inFunction;
     std::list<Condition> conditions;
     bool mustHoldForAll = false;
+    unsigned variablesNum = 0;
 };
 
 typedef std::list<InstrumentInstruction> InstrumentSequence;
@@ -70,22 +145,99 @@ class RewriteRule {
  public:
     InstrumentSequence foundInstrs;
     InstrumentInstruction newInstr;
-    InstrumentPlacement where;
+    InstrumentPlacement where = InstrumentPlacement::BEFORE;
     std::string inFunction;
     std::list<Condition> conditions;
     bool mustHoldForAll = false;
     Flags setFlags;
     std::string remember;
     std::string rememberPTSet;
+    int rememberSlot = NoSlot;
+    int rememberPTSetSlot = NoSlot;
+    unsigned variablesNum = 0;
 };
 
-typedef std::list<RewriteRule> RewriterConfig;
+typedef std::vector<RewriteRule> RewriterConfig;
 typedef std::list<GlobalVarsRule> RewriterGlobalsConfig;
+typedef std::vector<unsigned> RuleIndices;
+
+// Automaton over opcodes (Aho-Corasick) that recognizes the sequences
+// of found instructions of all multi-instruction rules of a phase at once.
+// It is fed with opcodes of instructions of a basic block one by one
+// and after each step it reports the rules whose sequence ends
+// at the last fed instruction.
+class SequenceMatcher {
+ public:
+    typedef unsigned State;
+    static const State Start = 0;
+
+    SequenceMatcher() : nodes(1) {}
+
+    /**
+     * Adds the sequence of opcodes of a rule.
+     * @param opcodes opcodes of the found instructions (all non-zero)
+     * @param rule index of the rule in the phase
+     */
+    void addSequence(const std::vector<unsigned>& opcodes, unsigned rule);
+
+    /**
+     * Computes the transition table, must be called after
+     * all sequences were added.
+     * @param opcodesNum number of opcodes (all opcodes are smaller)
+     */
+    void build(unsigned opcodesNum);
+
+    bool empty() const { return maxLength == 0; }
+    unsigned getMaxLength() const { return maxLength; }
+    unsigned getSequencesNum() const { return sequencesNum; }
+    size_t getStatesNum() const { return nodes.size(); }
+
+    State next(State state, unsigned opcode) const {
+        return opcode < opcodesNum ? transitions[state * opcodesNum + opcode]
+                                   : Start;
+    }
+
+    // Rules whose sequence ends in the given state, sorted by index
+    const RuleIndices& getMatches(State state) const {
+        return nodes[state].matches;
+    }
+
+ private:
+    class Node {
+     public:
+        std::map<unsigned, State> children;
+        State fail = Start;
+        RuleIndices matches;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<State> transitions;
+    unsigned opcodesNum = 0;
+    unsigned maxLength = 0;
+    unsigned sequencesNum = 0;
+};
 
 class Phase {
  public:
     RewriterConfig config;
     RewriterGlobalsConfig gconfig;
+
+    // Indices of rules from config that look for a single instruction,
+    // sorted into buckets by its opcode (bucket for opcode 0 is empty).
+    // The order of rules in each bucket is the order from the config.
+    std::vector<RuleIndices> opcodeRules;
+    // Rules that look for a sequence of more instructions
+    SequenceMatcher sequences;
+    RuleIndices entryRules;
+    RuleIndices returnRules;
+    // Some rules set flags or remember values (or pointed-to objects),
+    // so that the matching depends on the instrumentation planned before
+    bool changesState = false;
+
+    const RuleIndices& getRulesFor(unsigned opcode) const {
+        static const RuleIndices none;
+        return opcode < opcodeRules.size() ? opcodeRules[opcode] : none;
+    }
 };
 
 typedef std::list<Phase> Phases;
@@ -94,13 +246,18 @@ typedef std::list<Phase> Phases;
 class Rewriter {
     Phases phases;
     Flags flags;
+    // names of queries to plugins indexed by their ids
+    std::vector<std::string> queryNames{"pointsTo", "pointsToSetsOverlap"};
     public:
         std::vector<std::vector<std::string>> analysisPaths;
-        const Phases& getPhases();
+        // options of plugins indexed by names of the plugins and the options
+        std::map<std::string, std::map<std::string, std::string>> pluginOptions;
+        const Phases& getPhases() const;
         void parseConfig(std::ifstream &config_file);
-        void setFlag(std::string name, std::string value);
-        bool isFlag(std::string name);
-        std::string getFlagValue(std::string name);
+        void setFlag(const std::string& name, const std::string& value);
+        bool isFlag(const std::string& name) const;
+        const std::string& getFlagValue(const std::string& name) const;
+        const std::vector<std::string>& getQueryNames() const { return queryNames; }
 };
 
 #endif
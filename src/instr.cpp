@@ -1,11 +1,15 @@
+#include <algorithm>
+#include <atomic>
 #include <exception>
 #include <fstream>
 #include <iostream>
 #include <memory>
 #include <string>
 #include <set>
+#include <thread>
 #include <tuple>
 
+#include <llvm/ADT/SmallVector.h>
 #include <llvm/IR/Constants.h>
 #include "llvm/Linker/Linker.h"
 #include <llvm/IR/DebugInfoMetadata.h>
@@ -16,6 +20,7 @@
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/PassManager.h>
+#include <llvm/IR/TypeFinder.h>
 #include <llvm/IR/Verifier.h>
 #include <llvm/IRReader/IRReader.h>
 #include <llvm/Pass.h>
@@ -36,6 +41,7 @@
 #include "rewriter.hpp"
 #include "instr_log.hpp"
 #include "instr_analyzer.hpp"
+#include "instr_plan.hpp"
 #include "dg_points_to_plugin.hpp"
 
 #include "git-version.h"
@@ -56,6 +62,13 @@ void usage(char *name) {
     cerr << "Options:" << endl;
     cerr << "--version     Prints the git version." << endl;
     cerr << "--no-linking  Disables linking of definitions of instrumentation functions." << endl;
+    cerr << "--jobs=N      Plans the instrumentation of functions on N threads." << endl;
+    cerr << "--lazy-plugins  Runs the analysis of a plugin only when it is asked the first query." << endl;
+    cerr << "--plugin-option=PLUGIN.NAME=VALUE  Sets the option NAME of the plugin PLUGIN," << endl;
+    cerr << "                   overrides pluginOptions of the config." << endl;
+    cerr << "--emit-plan=FILE  Stores the planned insertions of all phases to FILE." << endl;
+    cerr << "--apply-plan=FILE  Performs insertions planned in FILE instead of planning them," << endl;
+    cerr << "                   no plugins are loaded." << endl;
 }
 
 /**
@@ -66,6 +79,9 @@ void getPointsToPlugin(LLVMInstrumentation& instr) {
     for (auto& plugin : instr.plugins) {
         if (plugin->getName() == "PointsTo") {
             instr.ppPlugin = static_cast<PointsToPlugin*>(plugin.get());
+            // we use the results directly (reachability of functions,
+            // pointer infos), so it cannot wait for the first query
+            instr.ppPlugin->ensureInitialized();
         }
     }
 }
@@ -91,8 +107,12 @@ PointerInfo getPointerInfoMinMax(Instruction *I, LLVMInstrumentation& instr)
         return PointerInfo();
     }
 
-    if (instr.ppPlugin)
-        return instr.ppPlugin->getPInfoMinMax(op, instr.rememberedPTSets);
+    if (instr.ppPlugin) {
+        std::vector<Value*> ptset;
+        PointerInfo info = instr.ppPlugin->getPInfoMinMax(op, ptset);
+        instr.rememberedPTSets.insert(ptset.begin(), ptset.end());
+        return info;
+    }
 
     return PointerInfo();
 }
@@ -159,7 +179,7 @@ uint64_t getAllocatedSize(Instruction *I, const Module& M) {
 
 /**
  * Get information corresponding to getPointerInfo* fields.
- * @param variables map of config variables
+ * @param variables values of config variables
  * @param iIns instruction rule
  * @param I instruction.
  * @param ins LLVMInstrumentation object.
@@ -168,47 +188,49 @@ uint64_t getAllocatedSize(Instruction *I, const Module& M) {
 bool getPointerInfos(Variables& variables, const InstrumentInstruction& iIns,
                         Instruction *ins, LLVMInstrumentation& instr)
 {
-    if (iIns.getPointerInfoTo.size() == 3) {
+    if (iIns.getPointerInfoSlots.empty() && iIns.getPointerInfoMinSlots.empty() &&
+            iIns.getPInfoMinMaxSlots.empty())
+        return true;
+
+    // The points-to plugin is not thread-safe
+    std::lock_guard<std::mutex> lock(instr.contextLock);
+    Type *Int64Ty = Type::getInt64Ty(instr.module.getContext());
+
+    if (!iIns.getPointerInfoSlots.empty()) {
         PointerInfo pointerInfo = getPointerInfo(ins, instr);
         // Do not apply this rule, if there was no relevant answer
         // from pointer analysis
         if (!pointerInfo.getPointer())
              return false;
-        variables[iIns.getPointerInfoTo.front()] = pointerInfo.getPointer();
-        variables[*(std::next(iIns.getPointerInfoTo.begin(), 1))] = ConstantInt::get(Type::getInt64Ty(instr.module.getContext()),
-                                                                        pointerInfo.getMinOffset());
-
-        variables[iIns.getPointerInfoTo.back()] = ConstantInt::get(Type::getInt64Ty(instr.module.getContext()),
-                                                                         pointerInfo.getMinSpace());
+        const auto& slots = iIns.getPointerInfoSlots;
+        variables[slots[0]] = pointerInfo.getPointer();
+        variables[slots[1]] = ConstantInt::get(Int64Ty, pointerInfo.getMinOffset());
+        variables[slots[2]] = ConstantInt::get(Int64Ty, pointerInfo.getMinSpace());
      }
 
-    if (iIns.getPointerInfoMinTo.size() == 3) {
+    if (!iIns.getPointerInfoMinSlots.empty()) {
         PointerInfo pointerInfo = getPointerInfo(ins, instr, true);
         // Do not apply this rule, if there was no relevant answer
         // from pointer analysis
         if (!pointerInfo.getPointer())
             return false;
-        variables[iIns.getPointerInfoMinTo.front()] = pointerInfo.getPointer();
-        variables[*(std::next(iIns.getPointerInfoMinTo.begin(), 1))] = ConstantInt::get(Type::getInt64Ty(instr.module.getContext()),
-                                                                           pointerInfo.getMinOffset());
-        variables[iIns.getPointerInfoMinTo.back()] = ConstantInt::get(Type::getInt64Ty(instr.module.getContext()),
-                                                                           pointerInfo.getMinSpace());
+        const auto& slots = iIns.getPointerInfoMinSlots;
+        variables[slots[0]] = pointerInfo.getPointer();
+        variables[slots[1]] = ConstantInt::get(Int64Ty, pointerInfo.getMinOffset());
+        variables[slots[2]] = ConstantInt::get(Int64Ty, pointerInfo.getMinSpace());
     }
 
-    if (iIns.getPInfoMinMaxTo.size() == 5) {
+    if (!iIns.getPInfoMinMaxSlots.empty()) {
         PointerInfo pointerInfo = getPointerInfoMinMax(ins, instr);
         // Do not apply this rule, if there was no relevant answer from pointer analysis
         if (!pointerInfo.getPointer())
             return false;
-        variables[iIns.getPInfoMinMaxTo.front()] = pointerInfo.getPointer();
-        variables[*(std::next(iIns.getPInfoMinMaxTo.begin(), 1))] = ConstantInt::get(Type::getInt64Ty(instr.module.getContext()),
-                                                                           pointerInfo.getMinOffset());
-        variables[*(std::next(iIns.getPInfoMinMaxTo.begin(), 2))] = ConstantInt::get(Type::getInt64Ty(instr.module.getContext()),
-                                                                           pointerInfo.getMinSpace());
-        variables[*(std::next(iIns.getPInfoMinMaxTo.begin(), 3))] = ConstantInt::get(Type::getInt64Ty(instr.module.getContext()),
-                                                                           pointerInfo.getMaxOffset());
-        variables[iIns.getPInfoMinMaxTo.back()] = ConstantInt::get(Type::getInt64Ty(instr.module.getContext()),
-                                                                           pointerInfo.getMaxSpace());
+        const auto& slots = iIns.getPInfoMinMaxSlots;
+        variables[slots[0]] = pointerInfo.getPointer();
+        variables[slots[1]] = ConstantInt::get(Int64Ty, pointerInfo.getMinOffset());
+        variables[slots[2]] = ConstantInt::get(Int64Ty, pointerInfo.getMinSpace());
+        variables[slots[3]] = ConstantInt::get(Int64Ty, pointerInfo.getMaxOffset());
+        variables[slots[4]] = ConstantInt::get(Int64Ty, pointerInfo.getMaxSpace());
     }
 
 
@@ -308,58 +330,32 @@ bool cloneMetadata(const llvm::Instruction *i1, llvm::Instruction *i2) {
 }
 
 /**
- * Returns the next instruction after the one specified.
- * @param ins specified instruction
- * @return next instruction or null, if ins is the last one.
- */
-Instruction* getNextInstruction(Instruction* ins) {
-    BasicBlock::iterator I(ins);
-    if (++I == ins->getParent()->end())
-        return nullptr;
-    return &*I;
-}
-
-/**
- * Returns the previous instruction before the one specified.
- * @param ins specified instruction
- * @return previous instruction or null, if ins is the first one.
- */
-Instruction* getPreviousInstruction(Instruction* ins) {
-    BasicBlock::iterator I(ins);
-    if (--I == ins->getParent()->begin())
-        return nullptr;
-    return &*I;
-}
-
-/**
- * Inserts new call instruction.
- * @param I first instruction to be removed
- * @param count number of instructions to be removed
+ * Removes an instruction replaced by a new call instruction.
+ * @param I instruction to be removed
+ * @param newInstr the new call instruction
  */
-void eraseInstructions(Instruction* I, int count) {
-    Instruction* currentInstr = I;
-    for (int i = 0; i < count; i++) {
-        if (!currentInstr) {
-            return;
-        }
-        Instruction* prevInstr = getPreviousInstruction(currentInstr);
-        currentInstr->eraseFromParent();
-        currentInstr = prevInstr;
+void eraseReplacedInstruction(Instruction* I, Instruction* newInstr) {
+    if (!I->use_empty()) {
+        // Values computed by the replaced sequence are given by the call
+        // if it has the right type, otherwise they are unknown
+        if (newInstr->getType() == I->getType())
+            I->replaceAllUsesWith(newInstr);
+        else
+            I->replaceAllUsesWith(UndefValue::get(I->getType()));
     }
-
+    I->eraseFromParent();
 }
 
 /**
  * Inserts new call instruction.
  * @param CalleeF function to be called
  * @param args arguments of the function to be called
- * @param rw_rule relevant rewrite rule
- * @param currentInstr current instruction
- * @param Iiterator pointer to instructions iterator
+ * @param kind kind of the planned insertion
+ * @param currentInstr instruction relative to which the call is inserted
+ * @return the new call instruction
  */
-void insertCallInstruction(Function* CalleeF, vector<Value *> args,
-        RewriteRule rw_rule, Instruction *currentInstr,
-        inst_iterator *Iiterator) {
+CallInst* insertCallInstruction(Function* CalleeF, const vector<Value *>& args,
+        InsertionKind kind, Instruction *currentInstr) {
     // update statistics
     ++statistics.inserted_calls[CalleeF];
 
@@ -372,149 +368,100 @@ void insertCallInstruction(Function* CalleeF, vector<Value *> args,
     // when all other instructions have metadata
     cloneMetadata(currentInstr, newInstr);
 
-    if (rw_rule.where == InstrumentPlacement::BEFORE) {
+    if (kind == InsertionKind::BEFORE || kind == InsertionKind::GLOBAL) {
         // Insert before
         newInstr->insertBefore(currentInstr);
         logger.log_insertion("before", CalleeF, currentInstr);
     }
-    else if (rw_rule.where == InstrumentPlacement::AFTER) {
+    else if (kind == InsertionKind::AFTER) {
         // Insert after
         newInstr->insertAfter(currentInstr);
         logger.log_insertion("after", CalleeF, currentInstr);
     }
-    else if (rw_rule.where == InstrumentPlacement::REPLACE) {
-        // In the end we move the iterator to the newInst position
-        // so we can safely remove the sequence of instructions being
-        // replaced
+    else if (kind == InsertionKind::REPLACE) {
+        // The replaced sequence is removed by the caller
         newInstr->insertAfter(currentInstr);
-        inst_iterator helper(*Iiterator);
-        *Iiterator = ++helper;
-        eraseInstructions(currentInstr, rw_rule.foundInstrs.size());
-        logger.log_insertion(rw_rule.foundInstrs, rw_rule.newInstr.instruction);
+        logger.log_insertion("after", CalleeF, currentInstr);
     } else {
         assert("Invalid position for inserting");
         abort();
     }
-}
 
-/**
- * Inserts new call instruction for globals.
- * @param CalleeF function to be called
- * @param args arguments of the function to be called
- * @param currentInstr current instruction
- */
-void insertCallInstruction(Function* CalleeF, vector<Value *> args,
-                           Instruction *currentInstr)
-{
-    // update statistics
-    ++statistics.inserted_calls[CalleeF];
-    // Create new call instruction
-    CallInst *newInstr = CallInst::Create(CalleeF, args);
-
-    // Duplicate the metadata of the instruction for which we
-    // instrument the code, some passes (e.g. inliner) can
-    // break the code when there's an instruction without metadata
-    // when all other instructions have metadata
-    cloneMetadata(currentInstr, newInstr);
-
-    // Insert before
-    newInstr->insertBefore(currentInstr);
-    logger.log_insertion("before", CalleeF, currentInstr);
+    return newInstr;
 }
 
 /**
- * Inserts an argument.
- * @param rw_newInstr rewrite rule - new instruction
+ * Inserts arguments of a planned call.
+ * @param arguments planned arguments
  * @param I instruction
  * @param CalleeF function to be called
- * @param variables map of found parameters from config
- * @param where position of the placement of the new instruction
- * @return a vector of arguments for the call that is to be inserted
- *         and a pointer to the instruction after/before the new call
+ * @param kind kind of the planned insertion
+ * @param args a vector of arguments for the call that is to be inserted
+ * @return a pointer to the instruction after/before the new call
  *         is going to be inserted (it is either I or some newly added
  *         argument)
  */
-tuple<vector<Value *>, Instruction*> insertArgument(InstrumentInstruction rw_newInstr, Instruction *I,
-        Function* CalleeF, const Variables& variables, InstrumentPlacement where)
+Instruction* insertArguments(const vector<PlannedArgument>& arguments, Instruction *I,
+        Function* CalleeF, InsertionKind kind, vector<Value *>& args)
 {
-    std::vector<Value *> args;
     unsigned i = 0;
     Instruction* nI = I;
-    for (const string& arg : rw_newInstr.parameters) {
-
-        if (i == rw_newInstr.parameters.size() - 1) {
-            break;
-        }
+    for (const PlannedArgument& arg : arguments) {
+        Value *var = arg.value;
+
+        if (!var) {
+            // the argument was skipped when planning
+        } else if (!arg.cast) {
+            args.push_back(var);
+        } else if (i < CalleeF->arg_size()) {
+            Value *argV = &*std::next(CalleeF->arg_begin(), i);
+
+            if (argV->getType() != var->getType()) {
+                if (!var->getType()->isPtrOrPtrVectorTy() && !var->getType()->isIntegerTy()) {
+                    args.push_back(var);
+                } else {
+                    CastInst *CastI;
+                    if (var->getType()->isPtrOrPtrVectorTy()) {
+                        CastI = CastInst::CreatePointerCast(var, argV->getType());
+                    } else {
+                        CastI = CastInst::CreateIntegerCast(var, argV->getType(), true);
+                    }
 
-        auto var = variables.find(arg);
-        if (var == variables.end()) {
-            int argInt;
-            try {
-                argInt = stoi(arg);
-                Value *intValue = ConstantInt::get(Type::getInt32Ty(I->getContext()), argInt);
-                args.push_back(intValue);
-            } catch (invalid_argument&) {
-                logger.write_error("Problem with instruction arguments: invalid argument.");
-            } catch (out_of_range&) {
-                logger.write_error("Problem with instruction arguments: out of range.");
-            }
-        } else {
-            unsigned argIndex = 0;
-            for (auto& arg : CalleeF->args()) {
-                Value *argV = &arg;
-
-                if (i == argIndex) {
-                    if (argV->getType() != var->second->getType()) {
-                        if (!var->second->getType()->isPtrOrPtrVectorTy() && !var->second->getType()->isIntegerTy()) {
-                            args.push_back(var->second);
-                        } else {
-                            CastInst *CastI;
-                            if (var->second->getType()->isPtrOrPtrVectorTy()) {
-                                CastI = CastInst::CreatePointerCast(var->second, argV->getType());
-                            } else {
-                                CastI = CastInst::CreateIntegerCast(var->second, argV->getType(), true);
-                            }
-
-                            if (Instruction *Inst = dyn_cast<Instruction>(var->second))
-                                cloneMetadata(Inst, CastI);
-
-                            if (where == InstrumentPlacement::BEFORE) {
-                                // We want to insert before I, that is:
-                                // %c = cast ...
-                                // newInstr
-                                // I
-                                //
-                                // NOTE that we do not set nI in this case,
-                                // so that the new instruction that we will insert
-                                // is inserted before I (and after all arguments
-                                // we added here)
-                                CastI->insertBefore(I);
-                            } else {
-                                // We want to insert after I, that is:
-                                // I
-                                // %c = cast ...
-                                // newInstr
-                                //
-                                // --> we must update the nI, so that the new
-                                // instruction is inserted after the arguments
-                                CastI->insertAfter(nI);
-                                nI = CastI;
-                            }
-                            args.push_back(CastI);
-                        }
+                    if (Instruction *Inst = dyn_cast<Instruction>(var))
+                        cloneMetadata(Inst, CastI);
+
+                    if (kind == InsertionKind::BEFORE || kind == InsertionKind::GLOBAL) {
+                        // We want to insert before I, that is:
+                        // %c = cast ...
+                        // newInstr
+                        // I
+                        //
+                        // NOTE that we do not set nI in this case,
+                        // so that the new instruction that we will insert
+                        // is inserted before I (and after all arguments
+                        // we added here)
+                        CastI->insertBefore(I);
                     } else {
-                        args.push_back(var->second);
+                        // We want to insert after I, that is:
+                        // I
+                        // %c = cast ...
+                        // newInstr
+                        //
+                        // --> we must update the nI, so that the new
+                        // instruction is inserted after the arguments
+                        CastI->insertAfter(nI);
+                        nI = CastI;
                     }
-                    break;
+                    args.push_back(CastI);
                 }
-
-                argIndex++;
+            } else {
+                args.push_back(var);
             }
         }
 
         i++;
     }
-    return make_tuple(args,nI);
+    return nI;
 }
 
 static llvm::Function *getOrInsertFunc(LLVMInstrumentation& I,
@@ -542,85 +489,222 @@ static llvm::Function *getOrInsertFunc(LLVMInstrumentation& I,
 }
 
 /**
- * Applies a rule.
+ * Gets the function called by a rule. The function is looked up
+ * only the first time the rule is applied in the current phase.
+ * @param instr instrumentation object
+ * @param plan plan of the current phase
+ * @param rule index of the rule in the plan
+ * @return the called function or nullptr if it is unknown
+ */
+static llvm::Function *getCalledFunction(LLVMInstrumentation& instr, const PhasePlan& plan,
+                                         unsigned rule)
+{
+    assert(rule < instr.callees.size());
+    Function *&CalleeF = instr.callees[rule];
+    if (!CalleeF)
+        CalleeF = getOrInsertFunc(instr, plan.callees[rule]);
+
+    return CalleeF;
+}
+
+/**
+ * Binds arguments of the new instruction of a rule.
+ * @param rw_newInstr rewrite rule - new instruction
+ * @param variables values of variables from config
+ * @param instr instrumentation object
+ * @param arguments planned arguments
+ */
+void planArguments(const InstrumentInstruction& rw_newInstr, const Variables& variables,
+        LLVMInstrumentation& instr, vector<PlannedArgument>& arguments)
+{
+    arguments.resize(rw_newInstr.arguments.size());
+    unsigned i = 0;
+    for (const CallArgument& arg : rw_newInstr.arguments) {
+        PlannedArgument& planned = arguments[i++];
+        Value *var = arg.kind == ArgumentKind::VARIABLE ? variables[arg.slot] : nullptr;
+
+        if (var) {
+            planned.value = var;
+            planned.cast = true;
+        } else if (arg.kind == ArgumentKind::CONSTANT) {
+            std::lock_guard<std::mutex> lock(instr.contextLock);
+            planned.value = ConstantInt::get(Type::getInt32Ty(instr.module.getContext()), arg.value);
+        } else if (arg.kind == ArgumentKind::OUT_OF_RANGE) {
+            logger.write_error("Problem with instruction arguments: out of range.");
+        } else {
+            logger.write_error("Problem with instruction arguments: invalid argument.");
+        }
+    }
+}
+
+/**
+ * Plans application of a rule.
  * @param instr instrumentation object
+ * @param plan plan of the current phase
+ * @param F current function
  * @param currentInstr current instruction
  * @param rw_rule rule to apply
- * @param variables map of found parameters form config
- * @param Iiterator pointer to instructions iterator
+ * @param idx index of the rule in the current phase
+ * @param variables values of variables from config
  * @return false if there was an error, true otherwise
  */
-bool applyRule(LLVMInstrumentation& instr, Instruction *currentInstr, RewriteRule rw_rule,
-        const Variables& variables, inst_iterator *Iiterator)
+bool planRule(LLVMInstrumentation& instr, PhasePlan& plan, Function *F,
+        Instruction *currentInstr, const RewriteRule& rw_rule,
+        unsigned idx, const Variables& variables)
 {
     logger.write_info("Applying rule...");
 
     // Work just with call instructions for now...
-    if (rw_rule.newInstr.instruction != "call") {
+    if (rw_rule.newInstr.opcode != Instruction::Call) {
         logger.write_error("Not working with this instruction: " + rw_rule.newInstr.instruction);
         return false;
     }
 
-    // Get operands
-    std::vector<Value *> args;
-
-    // Get name of function
-    const string& param = *(--rw_rule.newInstr.parameters.end());
-    Function *CalleeF = getOrInsertFunc(instr, param);
-    if (!CalleeF) {
-        logger.write_error("Unknown function: " + param);
-        return false;
+    Insertion insertion;
+    switch (rw_rule.where) {
+        case InstrumentPlacement::BEFORE:
+            insertion.kind = InsertionKind::BEFORE;
+            break;
+        case InstrumentPlacement::AFTER:
+            insertion.kind = InsertionKind::AFTER;
+            break;
+        case InstrumentPlacement::REPLACE:
+            insertion.kind = InsertionKind::REPLACE;
+            logger.log_insertion(rw_rule.foundInstrs, rw_rule.newInstr.instruction);
+            break;
+        default:
+            logger.write_error("Invalid position for inserting: " + rw_rule.newInstr.instruction);
+            return false;
     }
 
-    // Insert arguments
-    tuple<vector<Value*>, Instruction*> argsTuple = insertArgument(rw_rule.newInstr, currentInstr,
-                                                        CalleeF, variables, rw_rule.where);
-    args = get<0>(argsTuple);
-
-    // Insert new call instruction
-    insertCallInstruction(CalleeF, args, rw_rule, get<1>(argsTuple), Iiterator);
+    insertion.function = F;
+    insertion.site = currentInstr;
+    insertion.rule = idx;
+    planArguments(rw_rule.newInstr, variables, instr, insertion.arguments);
+    plan.insertions.push_back(std::move(insertion));
 
     return true;
 }
 
 /**
- * Applies a rule for global variables.
+ * Plans application of a rule for global variables.
  * @param instr instrumentation object
- * @param I current instruction
+ * @param plan plan of the current phase
+ * @param F function to which the call is inserted
  * @param rw_newInstr rule to apply - new instruction
- * @param variables map of found parameters form config
+ * @param idx index of the rule in the plan
+ * @param variables values of variables from config
  * @return false if there was an error, true otherwise
  */
-bool applyRule(LLVMInstrumentation& instr, Instruction *currentInstr, InstrumentInstruction rw_newInstr,
+bool planRule(LLVMInstrumentation& instr, PhasePlan& plan, Function *F,
+        const InstrumentInstruction& rw_newInstr, unsigned idx,
         const Variables& variables)
 {
     logger.write_info("Applying rule for global variable...");
 
     // Work just with call instructions
-    if (rw_newInstr.instruction != "call") {
+    if (rw_newInstr.opcode != Instruction::Call) {
         logger.write_error("Not working with this instruction: " + rw_newInstr.instruction);
         return false;
     }
 
-    // Get operands
-    std::vector<Value *> args;
+    Insertion insertion;
+    insertion.kind = InsertionKind::GLOBAL;
+    insertion.function = F;
+    insertion.rule = idx;
+    planArguments(rw_newInstr, variables, instr, insertion.arguments);
+    plan.insertions.push_back(std::move(insertion));
 
-    // Get name of function
-    const string& param = *(--rw_newInstr.parameters.end());
-    Function *CalleeF = getOrInsertFunc(instr, param);
+    return true;
+}
+
+/**
+ * Performs a planned insertion.
+ * @param instr instrumentation object
+ * @param plan plan of the current phase
+ * @param insertion the insertion
+ * @return false if there was an error, true otherwise
+ */
+bool applyInsertion(LLVMInstrumentation& instr, const PhasePlan& plan,
+        const Insertion& insertion)
+{
+    Function *F = insertion.function;
+    Function *CalleeF = getCalledFunction(instr, plan, insertion.rule);
     if (!CalleeF) {
-        logger.write_error("Unknown function: " + param);
+        logger.write_error("Unknown function: " + plan.callees[insertion.rule]);
         return false;
     }
 
+    if (insertion.kind == InsertionKind::ENTRY) {
+        // Insert at the beginning of function
+        Instruction* firstInstr = (&*(F->begin()))->getFirstNonPHIOrDbg();
+        if (firstInstr == nullptr)
+            return true;
+
+        CallInst *newInstr = CallInst::Create(CalleeF);
+        newInstr->insertBefore(firstInstr);
+        cloneMetadata(firstInstr, newInstr);
+        logger.write_info("Inserting instruction at the beginning of function " + F->getName().str());
+        return true;
+    }
+
+    if (insertion.kind == InsertionKind::RETURN) {
+        CallInst *newInstr = CallInst::Create(CalleeF);
+        newInstr->insertBefore(insertion.site);
+        cloneMetadata(insertion.site, newInstr);
+        logger.write_info("Inserting instruction at the end of function " + F->getName().str());
+        return true;
+    }
+
+    Instruction *currentInstr = insertion.site;
+    if (insertion.kind == InsertionKind::GLOBAL)
+        currentInstr = &*inst_begin(F);
+
     // Insert arguments
-    tuple<vector<Value*>, Instruction*> argsTuple = insertArgument(rw_newInstr, currentInstr,
-                                                        CalleeF, variables, InstrumentPlacement::BEFORE);
-    args = get<0>(argsTuple);
+    std::vector<Value *> args;
+    Instruction *where = insertArguments(insertion.arguments, currentInstr,
+                                         CalleeF, insertion.kind, args);
 
     // Insert new call instruction
-    insertCallInstruction(CalleeF, args, get<1>(argsTuple));
+    CallInst *newInstr = insertCallInstruction(CalleeF, args, insertion.kind, where);
 
+    if (insertion.kind == InsertionKind::REPLACE) {
+        // Remove the sequence from its end, so that uses
+        // inside the sequence go first
+        for (auto it = insertion.replaced.rbegin(); it != insertion.replaced.rend(); ++it)
+            eraseReplacedInstruction(*it, newInstr);
+    }
+
+    return true;
+}
+
+/**
+ * Performs all insertions planned in a phase.
+ * @param instr instrumentation object
+ * @param plan plan of the phase
+ * @return false if there was an error, true otherwise
+ */
+bool applyPlan(LLVMInstrumentation& instr, const PhasePlan& plan) {
+    // Functions called by the rules are looked up once per phase
+    instr.callees.assign(plan.callees.size(), nullptr);
+
+    for (const Insertion& insertion : plan.insertions) {
+        if (!applyInsertion(instr, plan, insertion)) {
+            logger.write_error("Cannot apply rule.");
+            return false;
+        }
+    }
+
+    for (const auto& it : plan.suppressed)
+        statistics.suppresed_instr[it.first] += it.second;
+
+    // Replaced instructions were removed, their addresses may be reused
+    for (const Insertion& insertion : plan.insertions) {
+        if (insertion.kind == InsertionKind::REPLACE) {
+            instr.queryCache.clear();
+            break;
+        }
+    }
 
     return true;
 }
@@ -629,30 +713,28 @@ bool applyRule(LLVMInstrumentation& instr, Instruction *currentInstr, Instrument
  * Checks if the operands of instruction match.
  * @param rwIns instruction from rewrite rule.
  * @param ins instruction to be checked.
- * @param variables map for remembering some parameters.
+ * @param variables values of variables to be bound.
  * @return true if OK, false otherwise
  */
-bool checkOperands(InstrumentInstruction rwIns, Instruction* ins, Variables& variables) {
-    unsigned opIndex = 0;
-
-    for(const string& param : rwIns.parameters) {
-        if (rwIns.parameters.size() == 1 && param=="*") {
-            return true;
-        }
+bool checkOperands(const InstrumentInstruction& rwIns, Instruction* ins, Variables& variables) {
+    if (rwIns.anyOperands)
+        return true;
 
-        if(opIndex > ins->getNumOperands() - 1) {
+    unsigned opIndex = 0;
+    for (const OperandPattern& param : rwIns.operands) {
+        if (opIndex >= ins->getNumOperands()) {
             return false;
         }
 
         llvm::Value *op = ins->getOperand(opIndex);
-        if (param[0] == '<' && param[param.size() - 1] == '>') {
-            if (rwIns.stripInboundsOffsets != param) {
-                variables[param] = op;
+        if (param.kind == OperandKind::VARIABLE) {
+            if (!param.stripInboundsOffsets) {
+                variables[param.slot] = op;
             } else {
-                variables[param] = op->stripInBoundsOffsets();
+                variables[param.slot] = op->stripInBoundsOffsets();
             }
-        } else if (param != "*"
-                && param != (op->stripPointerCasts()->getName()).str()) {
+        } else if (param.kind == OperandKind::NAME
+                && op->stripPointerCasts()->getName() != param.name) {
             // NOTE: we're comparing a name of the value, but the name
             // is set only sometimes. Since we're now matching just CallInst
             // it is OK, but it may not be OK in the future
@@ -671,8 +753,8 @@ bool checkOperands(InstrumentInstruction rwIns, Instruction* ins, Variables& var
  * @param rewriter rewriter
  * @return true if satisfied, false otherwise
 **/
-bool checkFlag(Condition condition, Rewriter rewriter) {
-    string value = rewriter.getFlagValue(condition.name);
+bool checkFlag(const Condition& condition, const Rewriter& rewriter) {
+    const string& value = rewriter.getFlagValue(condition.name);
     for (const auto& expV : condition.expectedValues) {
         if (expV == value)
             return true;
@@ -680,6 +762,24 @@ bool checkFlag(Condition condition, Rewriter rewriter) {
     return false;
 }
 
+/**
+ * Checks the isRemembered or pointsToRemembered condition against the union
+ * of the points-to sets of the remembered values.
+ * @param instr instrumentation object
+ * @param condition the condition
+ * @param value the parameter of the condition
+ * @return true if the points-to plugin answers true or maybe
+ *         for some remembered value
+ */
+bool checkRememberedPointsTo(LLVMInstrumentation& instr, const Condition& condition,
+                             Value *value)
+{
+    std::lock_guard<std::mutex> lock(instr.contextLock);
+    if (condition.kind == ConditionKind::IS_REMEMBERED)
+        return instr.ppPlugin->mayBePointedToByRemembered(value, instr.rememberedPointsTo);
+    return instr.ppPlugin->mayOverlapRemembered(value, instr.rememberedPointsTo);
+}
+
 /**
  * Runs all plugins for static analyses and decides, whether to
  * instrument or not.
@@ -695,16 +795,14 @@ bool checkAnalysis(Value *ins, const Condition& condition, bool forAll,
 {
     assert(condition.name != "" && "Empty condition passed");
 
-    vector<Value*> parameters;
-    parameters.reserve(condition.arguments.size());
-    for (const auto& arg : condition.arguments) {
-        if (arg == "<this>") { // special variable for this instruction
+    SmallVector<Value*, 4> parameters;
+    for (int slot : condition.argumentSlots) {
+        if (slot == ThisSlot) { // special variable for this instruction
             parameters.push_back(ins);
             continue;
         }
-        auto search = variables.find(arg);
-        if (search != variables.end()) {
-            parameters.push_back(search->second);
+        if (slot != NoSlot && variables[slot]) {
+            parameters.push_back(variables[slot]);
         }
         else {
             // Wrong parameters passed to the condition,
@@ -717,63 +815,18 @@ bool checkAnalysis(Value *ins, const Condition& condition, bool forAll,
 
     // check isRemembered+ condition
     // XXX refactor into a method
-    if (condition.name == "isRemembered+") {
+    if (condition.kind == ConditionKind::IS_REMEMBERED_PLUS) {
         if (instr.rememberedUnknown)
             return true;
 
         assert(parameters.size() == 1);
 
-        for (auto* v : instr.rememberedPTSets) {
-            if (*(parameters.begin()) == v)
-                return true;
-        }
-    }
-
-    // XXX: refactor into a method
-    // check whether the query is supported by some plugin at all
-    static std::set<std::string> none_supports;
-    static std::set<std::string> some_supports;
-
-    if (some_supports.count(condition.name) == 0 &&
-        none_supports.count(condition.name) == 0) {
-
-        // we haven't run into this query yet...
-        bool issupported = false;
-        static std::set<std::pair<InstrPlugin *, const std::string>> unsupported;
-        std::string query = condition.name;
-        // we support these internal queries if we support "pointsTo" or
-        // "pointsToSetsOverlap"
-        if (query == "isRemembered")
-            query = "pointsTo";
-        else if (query == "pointsToRemembered")
-            query = "pointsToSetsOverlap";
-
-        for (auto& plugin : instr.plugins) {
-            if (plugin->supports(query)) {
-                // yay!
-                issupported = true;
-                // do not break to let the user know which plugins does support the query
-            } else {
-                if (unsupported.insert({plugin.get(), condition.name}).second) {
-                    logger.write_info("Plugin " + plugin->getName() +
-                                      " does not support query '" + condition.name + "'.");
-                }
-            }
-        }
-
-        if (!issupported) {
-            if (none_supports.insert(condition.name).second) {
-                logger.write_error("No plugin supports the query '" + condition.name + "'. "
-                                   "Every condition with this query will be false!");
-            }
-
+        if (instr.rememberedPTSets.count(parameters[0]))
             return true;
-        } else {
-            some_supports.insert(condition.name);
-        }
     }
 
-    if (none_supports.count(condition.name) > 0) {
+    // plugins that support the query were found when they were loaded
+    if (instr.queryPlugins[condition.query].empty()) {
         logger.write_info("No plugin supports the query " + condition.name +
                           " I'm instrumenting");
         // none plugin supports this query, we should instrument since the condition
@@ -781,19 +834,38 @@ bool checkAnalysis(Value *ins, const Condition& condition, bool forAll,
         return true;
     }
 
-    assert((some_supports.count(condition.name) > 0)
-            && "BUG: Supported conditions check failed");
-
+    bool remembered = condition.kind == ConditionKind::IS_REMEMBERED ||
+                      condition.kind == ConditionKind::POINTS_TO_REMEMBERED;
+    // the union of remembered points-to sets tells only whether
+    // some remembered value gets the answer true or maybe
+    const QueryResults mayBeTrue = toQueryResults(QueryResult::True) |
+                                   toQueryResults(QueryResult::Maybe);
+    bool useUnion = remembered &&
+                    (condition.expectedResults &
+                     (mayBeTrue | toQueryResults(QueryResult::False))) == mayBeTrue;
+    bool someAnswered = false;
     for (auto& plugin : instr.plugins) {
-        if (!(plugin->supports(condition.name) ||
-              condition.name == "isRemembered" ||
-              condition.name == "pointsToRemembered")) {
+        if (!(remembered || plugin->supports(condition.query))) {
             continue;
         }
 
-        bool answer = Analyzer::shouldInstrument(instr.rememberedValues,
-                                                 plugin.get(), condition,
-                                                 parameters, logger);
+        bool answer;
+        bool answered = true;
+        if (useUnion && plugin.get() == instr.ppPlugin &&
+            plugin->supports(condition.query)) {
+            answer = checkRememberedPointsTo(instr, condition, parameters[0]);
+        } else {
+            answer = Analyzer::shouldInstrument(instr.rememberedValues,
+                                                plugin.get(), condition,
+                                                parameters, instr.queryCache,
+                                                logger, answered);
+        }
+        // the plugin cannot answer after all (e.g. its analysis failed),
+        // it is ignored as if it was not loaded
+        if (!answered)
+            continue;
+        someAnswered = true;
+
         if (answer && !forAll) {
             // Some plugin told us that we should instrument
             logger.write_info("Query for '" + condition.name +
@@ -806,6 +878,12 @@ bool checkAnalysis(Value *ins, const Condition& condition, bool forAll,
         }
     }
 
+    if (!someAnswered) {
+        logger.write_info("No plugin answered the query " + condition.name +
+                          " I'm instrumenting");
+        return true;
+    }
+
     if (forAll) {
       logger.write_info("Query for '" + condition.name + "' got no negative answer");
     } else {
@@ -829,7 +907,7 @@ bool checkConditions(Instruction *ins, const std::list<Condition>& conditions,
 {
     // check the conditions
     for (const auto& condition : conditions) {
-        if (instr.rewriter.isFlag(condition.name)) {
+        if (condition.kind == ConditionKind::FLAG) {
             if (!checkFlag(condition, instr.rewriter)) {
                 return false;
             }
@@ -855,153 +933,216 @@ void setFlags(const RewriteRule& rule, Rewriter& rewriter) {
 /**
  * Adds values that should be remembered into
  * instr's list.
- * @param name name of the value to be remembered
+ * @param slot slot of the value to be remembered
  * @param instr instrumentation object
- * @param variables list of variables
+ * @param variables values of variables
 **/
-void rememberValues(string name, LLVMInstrumentation& instr, Variables variables, const RewriteRule& rw) {
-    auto search = variables.find(name);
-    if (search != variables.end()) {
-        std::string calledFunction = rw.newInstr.parameters.back();
-        instr.rememberedValues.push_back(std::make_pair(search->second, calledFunction));
+void rememberValues(int slot, LLVMInstrumentation& instr, const Variables& variables, const RewriteRule& rw) {
+    if (slot != NoSlot && variables[slot]) {
+        // the points-to set of a value that is remembered already
+        // is in rememberedPointsTo
+        if (!instr.rememberedValues.insert(variables[slot], rw.newInstr.calledFunction))
+            return;
+        if (instr.ppPlugin) {
+            std::lock_guard<std::mutex> lock(instr.contextLock);
+            instr.ppPlugin->remember(variables[slot], instr.rememberedPointsTo);
+        }
     }
 }
 
 /**
  * Adds ptset values that should be remembered into
  * instr's list.
- * @param name name of the value to be remembered
+ * @param slot slot of the value to be remembered
  * @param instr instrumentation object
- * @param variables list of variables
+ * @param variables values of variables
 **/
-void rememberPTSet(string name, LLVMInstrumentation& instr, Variables variables, const RewriteRule& rw) {
-    auto search = variables.find(name);
-    std::string calledFunction = rw.newInstr.parameters.back();
-    if (search != variables.end() && calledFunction != "__INSTR_check_bounds_min_max") {
-        bool containsUnknown = instr.ppPlugin->getPointsTo(search->second, instr.rememberedPTSets);
+void rememberPTSet(int slot, LLVMInstrumentation& instr, const Variables& variables, const RewriteRule& rw) {
+    if (slot != NoSlot && variables[slot] &&
+        rw.newInstr.calledFunction != "__INSTR_check_bounds_min_max") {
+        std::vector<Value*> ptset;
+        bool containsUnknown = instr.ppPlugin->getPointsTo(variables[slot], ptset);
+        instr.rememberedPTSets.insert(ptset.begin(), ptset.end());
         if (containsUnknown)
             instr.rememberedUnknown = true;
     }
 }
 
 /**
- * Checks if the given instruction should be instrumented.
- * @param ins instruction to be checked.
- * @param rw_config parsed rules to apply.
- * @param Iiterator pointer to instructions iterator
+ * Checks whether the instruction matches an instruction of a rule
+ * with the same opcode and binds variables of the rule.
+ * @param checkInstr instruction from the rule
+ * @param currentInstr instruction to be checked
+ * @param variables values of variables from config
  * @param instr instrumentation object
- * @return true if OK, false otherwise
+ * @return true if the instruction matches, false otherwise
  */
-bool checkInstruction(Instruction* ins, Function* F, RewriterConfig rw_config, inst_iterator *Iiterator, LLVMInstrumentation& instr) {
-    // Iterate through rewrite rules
-    for (RewriteRule& rw : rw_config) {
-        // Check if this rule should be applied in this function
-        string functionName = F->getName().str();
+bool matchInstruction(const InstrumentInstruction& checkInstr, Instruction* currentInstr,
+        Variables& variables, LLVMInstrumentation& instr)
+{
+    assert(currentInstr->getOpcode() == checkInstr.opcode);
 
-        if (rw.inFunction != "*" && rw.inFunction != functionName)
-            continue;
+    // Check operands
+    if (!checkOperands(checkInstr, currentInstr, variables))
+        return false;
 
-        // Check sequence of instructions
-        Variables variables;
-        bool instrument = false;
-        Instruction* currentInstr = ins;
-        for (list<InstrumentInstruction>::iterator iit=rw.foundInstrs.begin(); iit != rw.foundInstrs.end(); ++iit) {
-            if (currentInstr == nullptr) {
-                break;
-            }
+    if (checkInstr.getDestTypeSlot != NoSlot) {
+        int size = getDestType(currentInstr);
+        if (size == -1)
+            return false;
+        std::lock_guard<std::mutex> lock(instr.contextLock);
+        variables[checkInstr.getDestTypeSlot] = ConstantInt::get(
+                            Type::getInt32Ty(instr.module.getContext()), size);
+    }
 
-            InstrumentInstruction checkInstr = *iit;
+    if (checkInstr.type != BinOpType::NBOP &&
+          !compareType(currentInstr, checkInstr.type)) {
+        return false;
+    }
 
-            // Check the name
-            if (currentInstr->getOpcodeName() == checkInstr.instruction) {
-                // Check operands
-                if (!checkOperands(checkInstr, currentInstr, variables)) {
-                    break;
-                }
+    // Check return value
+    if (checkInstr.returnValueSlot != NoSlot)
+        variables[checkInstr.returnValueSlot] = currentInstr;
 
-                if (!checkInstr.getDestType.empty() &&
-                      !checkInstr.getDestType.empty()) {
-                    int size = getDestType(currentInstr);
-                    if (size == -1)
-                        break;
-                    variables[checkInstr.getDestType] = ConstantInt::get(
-                                        Type::getInt32Ty(instr.module.getContext()), size);
-                }
+    return true;
+}
 
-                if (checkInstr.type != BinOpType::NBOP &&
-                      !compareType(currentInstr, checkInstr.type)) {
-                    break;
-                }
+/**
+ * Feeds the instruction to the matcher of sequences of the phase.
+ * @param scan state of matching in the current basic block
+ * @param sequences matcher of sequences
+ * @param ins next instruction of the block
+ * @return rules whose sequence of instructions ends with ins
+ */
+const RuleIndices& feedSequenceScan(SequenceScan& scan, const SequenceMatcher& sequences,
+        Instruction* ins)
+{
+    scan.state = sequences.next(scan.state, ins->getOpcode());
+    scan.window.push_back(ins);
+    if (scan.window.size() > sequences.getMaxLength())
+        scan.window.pop_front();
 
-                // Check return value
-                if (checkInstr.returnValue != "*") {
-                    if (checkInstr.returnValue[0] == '<'
-                            && checkInstr.returnValue[checkInstr.returnValue.size() - 1] == '>') {
-                        variables[checkInstr.returnValue] = currentInstr;
-                    }
-                }
+    return sequences.getMatches(scan.state);
+}
 
-                // Load next instruction to be checked
-                list<InstrumentInstruction>::iterator final_iter = rw.foundInstrs.end();
-                --final_iter;
-                if (iit != final_iter) {
-                    currentInstr = getNextInstruction(ins);
-                }
-                else {
-                    instrument = true;
-                }
-            }
-            else {
+/**
+ * Checks if the given instruction should be instrumented.
+ * @param ins instruction to be checked.
+ * @param F function of the instruction
+ * @param phase current phase with parsed rules to apply.
+ * @param instr instrumentation object
+ * @param scan state of matching sequences in the current basic block
+ * @param plan plan of the current phase
+ * @return true if OK, false otherwise
+ */
+bool checkInstruction(Instruction* ins, Function* F, const Phase& phase,
+        LLVMInstrumentation& instr, SequenceScan& scan, PhasePlan& plan) {
+    static const RuleIndices noRules;
+    const RuleIndices& rules = phase.getRulesFor(ins->getOpcode());
+    const RuleIndices& sequenceRules = !phase.sequences.empty()
+                                       ? feedSequenceScan(scan, phase.sequences, ins)
+                                       : noRules;
+    if (rules.empty() && sequenceRules.empty())
+        return true;
+
+    Variables variables;
+
+    // Iterate through rewrite rules that can match this instruction
+    // (rules for single instruction and rules for sequences ending
+    // with this instruction are merged, so that they are applied
+    // in the order from the config)
+    auto singleIt = rules.begin();
+    auto sequenceIt = sequenceRules.begin();
+    while (singleIt != rules.end() || sequenceIt != sequenceRules.end()) {
+        unsigned idx;
+        if (sequenceIt == sequenceRules.end() ||
+                (singleIt != rules.end() && *singleIt < *sequenceIt)) {
+            idx = *singleIt++;
+        } else {
+            idx = *sequenceIt++;
+        }
+
+        const RewriteRule& rw = phase.config[idx];
+
+        // Check if this rule should be applied in this function
+        if (rw.inFunction != "*" && F->getName() != rw.inFunction)
+            continue;
+
+        // Found instructions, the sequence ends with ins
+        const size_t length = rw.foundInstrs.size();
+        auto found = [&](size_t i) {
+            return length == 1 ? ins : scan.window[scan.window.size() - length + i];
+        };
+
+        // Check sequence of instructions
+        std::fill_n(variables.begin(), rw.variablesNum, nullptr);
+        bool instrument = true;
+        size_t i = 0;
+        for (const InstrumentInstruction& checkInstr : rw.foundInstrs) {
+            if (!matchInstruction(checkInstr, found(i++), variables, instr)) {
+                instrument = false;
                 break;
             }
         }
 
         // If all instructions match and conditions are satisfied
         // try to instrument the code
-        if (instrument) {
-            InstrumentInstruction iIns = rw.foundInstrs.front();
+        if (!instrument)
+            continue;
 
-            if (!iIns.getSizeTo.empty()) {
-                variables[iIns.getSizeTo] = ConstantInt::get(Type::getInt64Ty(instr.module.getContext()), getAllocatedSize(ins, instr.module));
-            }
+        Instruction* first = found(0);
+        const InstrumentInstruction& iIns = rw.foundInstrs.front();
 
-            if (!checkConditions(ins, rw.conditions, rw.mustHoldForAll,
-                                 instr, variables))
-            {
-                const string& func = *(--rw.newInstr.parameters.end());
-                ++statistics.suppresed_instr[func];
-                logger.write_info("Suppresed insertion of '" + func + "'");
-                continue;
-            }
+        if (iIns.getSizeToSlot != NoSlot) {
+            std::lock_guard<std::mutex> lock(instr.contextLock);
+            variables[iIns.getSizeToSlot] = ConstantInt::get(Type::getInt64Ty(instr.module.getContext()), getAllocatedSize(first, instr.module));
+        }
 
-            if (rw.foundInstrs.size() == 1) {
-                if (!getPointerInfos(variables, iIns, ins, instr))
-                    return false;
-            }
+        if (!checkConditions(first, rw.conditions, rw.mustHoldForAll,
+                             instr, variables))
+        {
+            const string& func = rw.newInstr.calledFunction;
+            ++plan.suppressed[func];
+            logger.write_info("Suppresed insertion of '" + func + "'");
+            continue;
+        }
 
-            // Set flags
-            setFlags(rw, instr.rewriter);
+        if (length == 1) {
+            if (!getPointerInfos(variables, iIns, ins, instr))
+                return false;
+        }
 
-            // Remember values that should be remembered
-            rememberValues(rw.remember, instr, variables, rw);
-            rememberPTSet(rw.rememberPTSet, instr, variables, rw);
+        // Set flags
+        setFlags(rw, instr.rewriter);
 
-            // Try to apply rule
-            Instruction *where;
-            if (rw.where == InstrumentPlacement::BEFORE) {
-                where = ins;
-            }
-            else {
-                // It is important in the REPLACE case that
-                // we first place the new instruction after
-                // the sequence
-                where = currentInstr;
-            }
+        // Remember values that should be remembered
+        rememberValues(rw.rememberSlot, instr, variables, rw);
+        rememberPTSet(rw.rememberPTSetSlot, instr, variables, rw);
 
-            if (!applyRule(instr, where, rw, variables, Iiterator)) {
-                logger.write_error("Cannot apply rule.");
-                return false;
-            }
+        // Try to apply rule
+        Instruction *where;
+        if (rw.where == InstrumentPlacement::BEFORE) {
+            where = first;
+        }
+        else {
+            // It is important in the REPLACE case that
+            // we first place the new instruction after
+            // the sequence
+            where = ins;
+        }
+
+        if (!planRule(instr, plan, F, where, rw, idx, variables)) {
+            logger.write_error("Cannot apply rule.");
+            return false;
+        }
+
+        if (rw.where == InstrumentPlacement::REPLACE) {
+            // The sequence will be removed, so no other rules can match it
+            Insertion& insertion = plan.insertions.back();
+            for (size_t i = 0; i < length; ++i)
+                insertion.replaced.push_back(found(i));
+            scan.reset();
+            return true;
         }
     }
     return true;
@@ -1022,16 +1163,22 @@ uint64_t getGlobalVarSize(GlobalVariable* GV, const Module& M) {
 }
 
 /**
- * Instruments global variable if they should be instrumented according to the given rule.
+ * Plans instrumentation of global variables according to the given rule.
  * @param instr LLVMInstrumentation object
  * @param g_rule a rule to be applied
- * @return true if instrumentation of global variables was done without problems, false otherwise
+ * @param idx index of the rule in the plan
+ * @param plan plan of the current phase
+ * @return true if instrumentation of global variables was planned without problems, false otherwise
  */
-bool instrumentGlobal(LLVMInstrumentation& instr, const GlobalVarsRule& g_rule) {
+bool planGlobal(LLVMInstrumentation& instr, const GlobalVarsRule& g_rule,
+                unsigned idx, PhasePlan& plan) {
     // If there is no rule for global variables, do not try to instrument
     if (g_rule.inFunction.empty() || g_rule.globalVar.globalVariable.empty())
         return true;
 
+    Function *F = nullptr;
+    Variables variables;
+
     // Iterate through global variables
     Module::global_iterator GI = instr.module.global_begin(), GE = instr.module.global_end();
     for ( ; GI != GE; ++GI) {
@@ -1044,20 +1191,26 @@ bool instrumentGlobal(LLVMInstrumentation& instr, const GlobalVarsRule& g_rule)
             logger.write_error("Rule for global variables can be inserted only to a specific function!");
         }
         else {
-            Function* F = getOrInsertFunc(instr, g_rule.inFunction);
+            if (!F) {
+                F = instr.module.getFunction(g_rule.inFunction);
+                if (!F || F->isDeclaration()) {
+                    logger.write_error("Rule for global variables must be inserted to a defined function: " + g_rule.inFunction);
+                    return false;
+                }
+            }
             // Get operands of new instruction
-            map <string, Value*> variables;
+            std::fill_n(variables.begin(), g_rule.variablesNum, nullptr);
 
-            if (g_rule.globalVar.globalVariable != "*")
-                variables[g_rule.globalVar.globalVariable] = GV;
-            if (!g_rule.globalVar.getSizeTo.empty()) {
-                variables[g_rule.globalVar.getSizeTo] = ConstantInt::get(Type::getInt64Ty(instr.module.getContext()),
+            if (g_rule.globalVar.globalVariableSlot != NoSlot)
+                variables[g_rule.globalVar.globalVariableSlot] = GV;
+            if (g_rule.globalVar.getSizeToSlot != NoSlot) {
+                variables[g_rule.globalVar.getSizeToSlot] = ConstantInt::get(Type::getInt64Ty(instr.module.getContext()),
                                                                              getGlobalVarSize(GV, instr.module));
             }
 
             // Check the conditions
             bool satisfied = true;
-            for (auto condition : g_rule.conditions) {
+            for (const auto& condition : g_rule.conditions) {
                 if (!checkAnalysis(GV, condition, g_rule.mustHoldForAll,
                                    instr, variables))
                 {
@@ -1068,10 +1221,7 @@ bool instrumentGlobal(LLVMInstrumentation& instr, const GlobalVarsRule& g_rule)
 
             // Try to instrument the code
             if (satisfied) {
-                // Try to apply rule
-                inst_iterator IIterator = inst_begin(F);
-                Instruction *firstI = &*IIterator;
-                if (!applyRule(instr, firstI, g_rule.newInstr, variables)) {
+                if (!planRule(instr, plan, F, g_rule.newInstr, idx, variables)) {
                     logger.write_error("Cannot apply rule.");
                     return false;
                 }
@@ -1083,14 +1233,17 @@ bool instrumentGlobal(LLVMInstrumentation& instr, const GlobalVarsRule& g_rule)
 }
 
 /**
- * Instruments global variables if they should be instrumented.
+ * Plans instrumentation of global variables.
  * @param instr LLVMInstrumentation object.
  * @param phase current phase.
- * @return true if instrumentation of global variables was done without problems, false otherwise
+ * @param plan plan of the phase
+ * @return true if instrumentation of global variables was planned without problems, false otherwise
  */
-bool instrumentGlobals(LLVMInstrumentation& instr, const Phase& phase) {
+bool planGlobals(LLVMInstrumentation& instr, const Phase& phase, PhasePlan& plan) {
+    // Rules for global variables are indexed after the rules for instructions
+    unsigned idx = phase.config.size();
     for (const auto& g_rule : phase.gconfig) {
-        if (!instrumentGlobal(instr, g_rule))
+        if (!planGlobal(instr, g_rule, idx++, plan))
             return false;
     }
 
@@ -1098,87 +1251,54 @@ bool instrumentGlobals(LLVMInstrumentation& instr, const Phase& phase) {
 }
 
 /**
- * Instruments new insruction at the entry of the given function.
- * @param M module
+ * Plans new instructions at the entry of the given function.
  * @param F function to be instrumented
- * @param rw_config set of rules
- * @return true if instrumented, false otherwise
+ * @param phase current phase with set of rules
+ * @param plan plan of the phase
  */
-bool instrumentEntryPoints(LLVMInstrumentation& instr, Function* F, RewriterConfig rw_config) {
+void planEntryPoints(Function* F, const Phase& phase, PhasePlan& plan) {
     if (F->isDeclaration())
-        return true;
-    for (RewriteRule& rw : rw_config) {
+        return;
+    for (unsigned idx : phase.entryRules) {
+        const RewriteRule& rw = phase.config[idx];
 
-        // Check type of the rule
-        if (rw.where != InstrumentPlacement::ENTRY)
-            continue;
         // Check if the function should be instrumented
-        string functionName = F->getName().str();
-        if (rw.inFunction != "*" && rw.inFunction != functionName)
+        if (rw.inFunction != "*" && F->getName() != rw.inFunction)
             continue;
 
-        // Get name of a function to be instrumented
-        const string& param = *(--rw.newInstr.parameters.end());
-        Function *CalleeF = getOrInsertFunc(instr, param);
-        if (!CalleeF) {
-            logger.write_error("Unknown function: " + param);
-            return false;
-        }
-
-        // Create new call instruction
-        std::vector<Value *> args;
-        CallInst *newInstr = CallInst::Create(CalleeF, args);
-
-        // Insert at the beginning of function
-        Instruction* firstInstr = (&*(F->begin()))->getFirstNonPHIOrDbg();
-        if (firstInstr == nullptr)
-            continue;
-        newInstr->insertBefore(firstInstr);
-        cloneMetadata(firstInstr, newInstr);
-
-        logger.write_info("Inserting instruction at the beginning of function " + functionName);
+        Insertion insertion;
+        insertion.kind = InsertionKind::ENTRY;
+        insertion.function = F;
+        insertion.rule = idx;
+        plan.insertions.push_back(std::move(insertion));
     }
-
-    return true;
 }
 
 /**
- * Instruments new instruction before all return instructions in a given
+ * Plans new instruction before all return instructions in a given
  * function.
- * @param M module
  * @param F function to be instrumented
- * @param rw_config set fo rules
- * @return true if instrumented, false otherwise
+ * @param phase current phase with set of rules
+ * @param plan plan of the phase
  */
-bool instrumentReturns(LLVMInstrumentation& instr, Function* F, RewriterConfig rw_config) {
-    for (RewriteRule& rw : rw_config) {
+void planReturns(Function* F, const Phase& phase, PhasePlan& plan) {
+    for (unsigned idx : phase.returnRules) {
+        const RewriteRule& rw = phase.config[idx];
 
-        // Check type of the rule
-        if (rw.where != InstrumentPlacement::RETURN)
-            continue;
         // Check whether the function should be instrumented
-        string functionName = F->getName().str();
-        if (rw.inFunction != "*" && rw.inFunction != functionName)
+        if (rw.inFunction != "*" && F->getName() != rw.inFunction)
             continue;
 
-        // Get name of a function to be instrumented
-        const string& param = *(--rw.newInstr.parameters.end());
-        Function *CalleeF = getOrInsertFunc(instr, param);
-        if (!CalleeF) {
-            logger.write_error("Unknown function: " + param);
-            return false;
-        }
-
-        std::vector<Value *> args;
         bool inserted = false;
         for (auto& block : *F) {
             if (isa<ReturnInst>(block.getTerminator())) {
-                llvm::Instruction *termInst = block.getTerminator();
-                CallInst *newInstr = CallInst::Create(CalleeF, args);
-                newInstr->insertBefore(termInst);
+                Insertion insertion;
+                insertion.kind = InsertionKind::RETURN;
+                insertion.function = F;
+                insertion.site = block.getTerminator();
+                insertion.rule = idx;
+                plan.insertions.push_back(std::move(insertion));
                 inserted = true;
-                cloneMetadata(termInst, newInstr);
-                logger.write_info("Inserting instruction at the end of function " + functionName);
             }
         }
 
@@ -1187,7 +1307,6 @@ bool instrumentReturns(LLVMInstrumentation& instr, Function* F, RewriterConfig r
                          << F->getName() << "'\n";
         }
     }
-    return true;
 }
 
 /**
@@ -1207,14 +1326,221 @@ static bool isReachableFun(const Function& f, LLVMInstrumentation& instr) {
 }
 
 /**
- * Runs one phase of instrumentation rules.
+ * Collects the queries that conditions of rules for single instructions
+ * will ask about the function and lets each plugin answer them in one
+ * batch. Only the first query of a rule is collected (the following ones
+ * are not asked if it fails) and only for the first plugin that supports
+ * it (the others are not asked if its answer decides), so that nothing
+ * is computed in vain. Plugins that are not initialized yet are skipped,
+ * they run their analyses only when they are really asked. Conditions
+ * on flags are taken into account only when the phase does not change
+ * flags, queries about remembered values are not collected since they
+ * depend on the preceding insertions.
+ * @param instr instrumentation object
+ * @param F the function
+ * @param phase current phase of instrumentation.
+ */
+void prefetchQueries(LLVMInstrumentation& instr, Function* F, const Phase& phase) {
+    // the query collected for each rule and the plugin that answers it
+    std::vector<std::pair<const Condition*, InstrPluginV2*>> prefetched(phase.config.size(),
+                                                                        {nullptr, nullptr});
+    bool any = false;
+    for (size_t idx = 0; idx < phase.config.size(); ++idx) {
+        const RewriteRule& rw = phase.config[idx];
+        if (rw.inFunction != "*" && F->getName() != rw.inFunction)
+            continue;
+
+        for (const auto& condition : rw.conditions) {
+            if (condition.kind == ConditionKind::FLAG) {
+                if (phase.changesState || !checkFlag(condition, instr.rewriter))
+                    break;
+                continue;
+            }
+            if (condition.kind == ConditionKind::QUERY &&
+                !instr.queryPlugins[condition.query].empty()) {
+                InstrPluginV2 *plugin = instr.queryPlugins[condition.query].front();
+                // the answers to the queries that change the state of the plugin
+                // depend on the order in which they are asked
+                if (plugin->isInitialized() && !plugin->changesState(condition.query)) {
+                    prefetched[idx] = {&condition, plugin};
+                    any = true;
+                }
+            }
+            break;
+        }
+    }
+    if (!any)
+        return;
+
+    QueryBatch batch;
+    Variables variables;
+    SmallVector<Value*, 4> parameters;
+
+    for (Instruction& I : instructions(F)) {
+        for (unsigned idx : phase.getRulesFor(I.getOpcode())) {
+            const Condition *condition = prefetched[idx].first;
+            if (!condition)
+                continue;
+
+            const RewriteRule& rw = phase.config[idx];
+            std::fill_n(variables.begin(), rw.variablesNum, nullptr);
+            const InstrumentInstruction& iIns = rw.foundInstrs.front();
+            if (!matchInstruction(iIns, &I, variables, instr))
+                continue;
+
+            if (iIns.getSizeToSlot != NoSlot) {
+                std::lock_guard<std::mutex> lock(instr.contextLock);
+                variables[iIns.getSizeToSlot] = ConstantInt::get(Type::getInt64Ty(instr.module.getContext()), getAllocatedSize(&I, instr.module));
+            }
+
+            parameters.clear();
+            for (int slot : condition->argumentSlots) {
+                if (slot == ThisSlot)
+                    parameters.push_back(&I);
+                else if (slot != NoSlot && variables[slot])
+                    parameters.push_back(variables[slot]);
+                else
+                    break;
+            }
+            if (parameters.size() != condition->argumentSlots.size())
+                continue;
+
+            batch.add(prefetched[idx].second, condition->query, parameters);
+        }
+    }
+
+    if (!batch.empty())
+        instr.queryCache.answerBatch(batch);
+}
+
+/**
+ * Checks whether some plugin changes its state when it answers a query
+ * of the conditions.
+ * @param instr instrumentation object
+ * @param conditions conditions of a rule
+ * @return true if the answers depend on the order of the queries
+ */
+bool queriesChangeState(const LLVMInstrumentation& instr, const std::list<Condition>& conditions) {
+    for (const auto& condition : conditions) {
+        if (condition.kind == ConditionKind::FLAG)
+            continue;
+        for (InstrPluginV2 *plugin : instr.queryPlugins[condition.query]) {
+            if (plugin->changesState(condition.query))
+                return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Checks whether some plugin changes its state when it answers a query
+ * of the rules of the phase.
+ * @param instr instrumentation object
+ * @param phase current phase of instrumentation.
+ * @return true if the functions must be planned in order
+ */
+bool queriesChangeState(const LLVMInstrumentation& instr, const Phase& phase) {
+    for (const auto& rw : phase.config) {
+        if (queriesChangeState(instr, rw.conditions))
+            return true;
+    }
+    for (const auto& g_rule : phase.gconfig) {
+        if (queriesChangeState(instr, g_rule.conditions))
+            return true;
+    }
+    return false;
+}
+
+/**
+ * Plans instrumentation of one function.
+ * @param instr instrumentation object
+ * @param F the function
+ * @param phase current phase of instrumentation.
+ * @param plan the plan of the phase (or of the function)
+ * @return true if instrumentation was planned without problems, false otherwise
+ */
+bool planFunction(LLVMInstrumentation& instr, Function* F, const Phase& phase, PhasePlan& plan) {
+    if (!instr.plugins.empty())
+        prefetchQueries(instr, F, phase);
+
+    planEntryPoints(F, phase, plan);
+    planReturns(F, phase, plan);
+
+    // Sequences are matched in each basic block separately
+    SequenceScan scan;
+    for (BasicBlock& B : *F) {
+        scan.reset();
+        for (Instruction& I : B) {
+            // Check if the instruction is relevant
+            if (!checkInstruction(&I, F, phase, instr, scan, plan))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Plans functions on instr.jobs threads. The threads take the functions
+ * one by one, so that a long function does not hold up the others.
+ * The plans of the functions are concatenated in the order of functions,
+ * so the result is the same as when planning them on one thread.
  * @param instr instrumentation object
+ * @param functions functions to be planned
  * @param phase current phase of instrumentation.
- * @return true if instrumentation was completed without problems, false otherwise
+ * @param plan the plan of the phase
+ * @return true if instrumentation was planned without problems, false otherwise
  */
-bool runPhase(LLVMInstrumentation& instr, const Phase& phase) {
+bool planFunctionsInParallel(LLVMInstrumentation& instr, const vector<Function*>& functions,
+                             const Phase& phase, PhasePlan& plan) {
+    vector<PhasePlan> plans(functions.size());
+    std::atomic<size_t> next(0);
+    std::atomic<bool> ok(true);
+
+    auto worker = [&]() {
+        size_t i;
+        while (ok && (i = next++) < functions.size()) {
+            if (!planFunction(instr, functions[i], phase, plans[i]))
+                ok = false;
+        }
+    };
+
+    vector<std::thread> threads;
+    unsigned threadsNum = std::min<size_t>(instr.jobs, functions.size());
+    for (unsigned i = 1; i < threadsNum; ++i)
+        threads.emplace_back(worker);
+    worker();
+    for (auto& thread : threads)
+        thread.join();
+
+    if (!ok)
+        return false;
+
+    for (auto& fplan : plans) {
+        std::move(fplan.insertions.begin(), fplan.insertions.end(),
+                  std::back_inserter(plan.insertions));
+        for (const auto& it : fplan.suppressed)
+            plan.suppressed[it.first] += it.second;
+    }
+
+    return true;
+}
 
-    // Instrument instructions in functions
+/**
+ * Plans one phase of instrumentation rules. The module is not changed.
+ * @param instr instrumentation object
+ * @param phase current phase of instrumentation.
+ * @param plan the plan of the phase
+ * @return true if instrumentation was planned without problems, false otherwise
+ */
+bool planPhase(LLVMInstrumentation& instr, const Phase& phase, PhasePlan& plan) {
+    for (const auto& rule : phase.config)
+        plan.callees.push_back(rule.newInstr.calledFunction);
+    for (const auto& g_rule : phase.gconfig)
+        plan.callees.push_back(g_rule.newInstr.calledFunction);
+
+    // Collect functions to be instrumented
+    vector<Function*> functions;
     for (Module::iterator Fiterator = instr.module.begin(), E = instr.module.end(); Fiterator != E; ++Fiterator) {
         if (Fiterator->isDeclaration())
             continue;
@@ -1235,22 +1561,28 @@ bool runPhase(LLVMInstrumentation& instr, const Phase& phase) {
             continue;
         }
 
-        if (!instrumentEntryPoints(instr, (&*Fiterator), phase.config))
-            return false;
-        if (!instrumentReturns(instr, (&*Fiterator), phase.config))
-            return false;
+        functions.push_back(&*Fiterator);
+    }
 
-        for (inst_iterator Iiterator = inst_begin(&*Fiterator), End = inst_end(&*Fiterator); Iiterator != End; ++Iiterator) {
-            // This iterator may be replaced (by an iterator to the following
-            // instruction) in the insertCallInstruction function
-            // Check if the instruction is relevant
-            if (!checkInstruction(&*Iiterator, (&*Fiterator), phase.config, &Iiterator, instr))
+    // Rules that set flags or remember values and queries that change
+    // the state of plugins make the functions depend on each other,
+    // they must be planned in order
+    bool inOrder = phase.changesState || queriesChangeState(instr, phase);
+    if (instr.jobs > 1 && !inOrder) {
+        if (!planFunctionsInParallel(instr, functions, phase, plan))
+            return false;
+    } else {
+        if (instr.jobs > 1)
+            logger.write_info("Rules of the phase set flags, remember values or ask queries "
+                              "that change the state of plugins, planning on one thread.");
+        for (Function* F : functions) {
+            if (!planFunction(instr, F, phase, plan))
                 return false;
         }
     }
 
     // Instrument global variables
-    if (!instrumentGlobals(instr, phase))
+    if (!planGlobals(instr, phase, plan))
         return false;
 
     return true;
@@ -1259,21 +1591,55 @@ bool runPhase(LLVMInstrumentation& instr, const Phase& phase) {
 /**
  * Instruments given module with rules from json file.
  * @param instr instrumentation object
+ * @param appliedPlan plan to be applied instead of planning
+ *        the phases, nullptr if the phases should be planned
+ * @param emittedPlan if not nullptr, plans of the phases are stored here
  * @return true if instrumentation was done without problems, false otherwise
  */
-bool instrumentModule(LLVMInstrumentation& instr) {
+bool instrumentModule(LLVMInstrumentation& instr, const Json::Value* appliedPlan,
+                      Json::Value* emittedPlan) {
     logger.write_info("Starting instrumentation.");
 
     // Get points-to plugin
     getPointsToPlugin(instr);
 
-    Phases rw_phases = instr.rewriter.getPhases();
+    const Phases& rw_phases = instr.rewriter.getPhases();
+    if (appliedPlan && (*appliedPlan)["phases"].size() != rw_phases.size()) {
+        logger.write_error("The plan does not match the number of phases of the config.", true);
+        return false;
+    }
 
-    int i = 0;
+    unsigned i = 0;
     for (const auto& phase : rw_phases) {
         i++;
         logger.write_info("Start of the " + std::to_string(i) + ". phase.");
-        if (!runPhase(instr, phase))
+
+        // Plan the phase (or load its plan) and then perform it,
+        // the following phase is planned on the changed module
+        PhasePlan plan;
+        if (appliedPlan) {
+            try {
+                planFromJson((*appliedPlan)["phases"][i - 1], instr.module, plan);
+            }
+            catch (runtime_error& ex) {
+                logger.write_error(string("Error loading the plan: ") + ex.what());
+                return false;
+            }
+        } else if (!planPhase(instr, phase, plan)) {
+            return false;
+        }
+
+        if (emittedPlan) {
+            try {
+                (*emittedPlan)["phases"].append(planToJson(plan, instr.module));
+            }
+            catch (runtime_error& ex) {
+                logger.write_error(string("Error storing the plan: ") + ex.what());
+                return false;
+            }
+        }
+
+        if (!applyPlan(instr, plan))
             return false;
 
         logger.write_info("End of the " + std::to_string(i) + ". phase.");
@@ -1297,6 +1663,153 @@ void saveModule(LLVMInstrumentation& instr) {
     #endif
 }
 
+/**
+ * Loads a plan of insertions from a file.
+ * @param path path to the file
+ * @param plan loaded plan
+ * @return true if the plan was loaded, false otherwise
+ */
+bool loadPlan(const string& path, Json::Value& plan) {
+    ifstream plan_file(path);
+    if (!plan_file) {
+        logger.write_error("Failed to open the plan " + path, true);
+        return false;
+    }
+
+#if (JSONCPP_VERSION_MINOR < 8 || (JSONCPP_VERSION_MINOR == 8 && JSONCPP_VERSION_PATCH < 1))
+    Json::Reader reader;
+    if (!reader.parse(plan_file, plan)) {
+        logger.write_error("Failed to parse the plan " + path + "\n" +
+                           reader.getFormattedErrorMessages(), true);
+        return false;
+    }
+#else
+    Json::CharReaderBuilder rbuilder;
+    rbuilder["collectComments"] = false;
+    std::string errs;
+    if (!Json::parseFromStream(rbuilder, plan_file, &plan, &errs)) {
+        logger.write_error("Failed to parse the plan " + path + "\n" + errs, true);
+        return false;
+    }
+#endif
+
+    return true;
+}
+
+/**
+ * Writes a plan of insertions to a file.
+ * @param path path to the file
+ * @param plan the plan
+ * @return true if the plan was written, false otherwise
+ */
+bool savePlan(const string& path, const Json::Value& plan) {
+    ofstream plan_file(path);
+    plan_file << plan;
+    if (!plan_file) {
+        logger.write_error("Failed to write the plan " + path, true);
+        return false;
+    }
+
+    logger.write_info("Plan written to " + path);
+    return true;
+}
+
+/**
+ * Finds which plugins support which queries
+ * (the plugins must already know the ids of queries).
+ * @param instr instrumentation object
+ */
+void bindQueries(LLVMInstrumentation& instr) {
+    const auto& names = instr.rewriter.getQueryNames();
+    instr.queryPlugins.assign(names.size(), {});
+
+    for (auto& plugin : instr.plugins) {
+        for (QueryId query = 0; query < names.size(); ++query) {
+            if (plugin->supports(query)) {
+                instr.queryPlugins[query].push_back(plugin.get());
+            } else {
+                logger.write_info("Plugin " + plugin->getName() +
+                                  " does not support query '" + names[query] + "'.");
+            }
+        }
+    }
+
+    // pointsTo and pointsToSetsOverlap are asked only by some conditions
+    for (QueryId query = PointsToSetsOverlapQuery + 1; query < names.size(); ++query) {
+        if (instr.queryPlugins[query].empty()) {
+            logger.write_error("No plugin supports the query '" + names[query] + "'. "
+                               "Every condition with this query will be false!");
+        }
+    }
+}
+
+/**
+ * Loads the first plugin from the list that can be created and binds
+ * queries to it. Unless plugins are initialized lazily, also initializes it.
+ * @param instr instrumentation object
+ * @param paths paths to the plugin and its alternatives
+ * @param next index of the first path to be tried, set to the index
+ *        where the loading stopped
+ * @param readOnly load only plugins that declare read-only access
+ *        to the module, stop at the first other one
+ * @return the plugin or nullptr if none was loaded
+ */
+static unique_ptr<InstrPluginV2> loadPlugin(LLVMInstrumentation& instr,
+                                            const vector<string>& paths,
+                                            size_t& next, bool readOnly) {
+    for (; next < paths.size(); ++next) {
+        const string& path = paths[next];
+        if (readOnly &&
+            !(Analyzer::getCapabilities(path) & PluginReadsModuleOnly))
+            return nullptr;
+
+        auto plugin = Analyzer::analyze(path, &instr.module);
+        if (plugin) {
+            logger.write_info("Plugin " + plugin->getName() + " loaded " +
+                              "(" + path +").");
+            auto options = instr.rewriter.pluginOptions.find(plugin->getName());
+            if (options != instr.rewriter.pluginOptions.end()) {
+                for (const auto& option : options->second) {
+                    if (!plugin->setOption(option.first, option.second)) {
+                        logger.write_error("Plugin " + plugin->getName() +
+                                           " does not accept the option " +
+                                           option.first + "=" + option.second);
+                        cerr << "Invalid option of plugin " << plugin->getName()
+                             << ": " << option.first << "=" << option.second << endl;
+                    }
+                }
+            }
+            plugin->bindQueries(instr.rewriter.getQueryNames());
+            // Plugins that are initialized lazily run their analyses
+            // when they are asked the first query
+            if (!instr.lazyPlugins)
+                plugin->ensureInitialized();
+            ++next;
+            return plugin; // we got the first plugin from the list, we're done
+        } else {
+            logger.write_error("Failed loading plugin " + path);
+            cerr <<"Failed loading plugin: " << path << endl;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * Computes layouts of all structures in the module, so that plugins
+ * that read the data layout on more threads do not fill its cache
+ * at the same time.
+ * @param M the module
+ */
+static void computeStructLayouts(const Module& M) {
+    TypeFinder types;
+    types.run(M, false /* also literal structures */);
+    const DataLayout& DL = M.getDataLayout();
+    for (StructType *ST : types) {
+        if (!ST->isOpaque() && ST->isSized())
+            DL.getStructLayout(ST);
+    }
+}
+
 /**
  * Loads all plugins.
  * @param instr instrumentation object
@@ -1306,27 +1819,56 @@ void saveModule(LLVMInstrumentation& instr) {
 bool loadPlugins(LLVMInstrumentation& instr) {
     if (instr.rewriter.analysisPaths.size() == 0) {
         logger.write_info("No plugin specified.");
+        bindQueries(instr);
         return true;
     }
 
-    for (const auto& paths : instr.rewriter.analysisPaths) {
-        for (const auto& path : paths) {
-            auto plugin = Analyzer::analyze(path, &instr.module);
-            if (plugin) {
-                logger.write_info("Plugin " + plugin->getName() + " loaded " +
-                                  "(" + path +").");
-                instr.plugins.push_back(std::move(plugin));
-                break; // we got the first plugin from the list, we're done
-            } else {
-                logger.write_error("Failed loading plugin " + path);
-                cerr <<"Failed loading plugin: " << path << endl;
-            }
+    const auto& analyses = instr.rewriter.analysisPaths;
+    vector<unique_ptr<InstrPluginV2>> loaded(analyses.size());
+    vector<size_t> next(analyses.size(), 0);
+
+    // Plugins that may change the module or the LLVM context are loaded
+    // one by one, the others only read the module, so they are loaded
+    // (and their analyses run) concurrently
+    vector<size_t> concurrent;
+    for (size_t i = 0; i < analyses.size(); ++i) {
+        if (!analyses[i].empty() &&
+            (Analyzer::getCapabilities(analyses[i][0]) & PluginReadsModuleOnly))
+            concurrent.push_back(i);
+        else
+            loaded[i] = loadPlugin(instr, analyses[i], next[i], false);
+    }
+
+    if (concurrent.size() > 1) {
+        computeStructLayouts(instr.module);
+
+        vector<std::thread> threads;
+        for (size_t i : concurrent) {
+            threads.emplace_back([&instr, &analyses, &loaded, &next, i]() {
+                loaded[i] = loadPlugin(instr, analyses[i], next[i], true);
+            });
         }
+        for (auto& thread : threads)
+            thread.join();
+    } else {
+        for (size_t i : concurrent)
+            loaded[i] = loadPlugin(instr, analyses[i], next[i], true);
+    }
+
+    // Alternatives of the concurrently loaded plugins that
+    // do not declare read-only access to the module
+    for (size_t i = 0; i < analyses.size(); ++i) {
+        if (!loaded[i])
+            loaded[i] = loadPlugin(instr, analyses[i], next[i], false);
+        if (loaded[i])
+            instr.plugins.push_back(std::move(loaded[i]));
     }
+
+    bindQueries(instr);
     return !instr.plugins.empty();
 }
 
-static void dumpStatistics() {
+static void dumpStatistics(LLVMInstrumentation& instr) {
     // dump statistics about instrumented module
     logger.write_info("Number of inserted calls:", true /* stdout */);
     for (auto& it : statistics.inserted_calls) {
@@ -1346,6 +1888,62 @@ static void dumpStatistics() {
                           " (blocked " + std::to_string(it.second) + ")";
         logger.write_info(msg, true /* stdout */);
     }
+
+    for (const auto& plugin : instr.plugins) {
+        if (!plugin->isInitialized()) {
+            logger.write_info("Plugin " + plugin->getName() + " was not needed",
+                              true /* stdout */);
+            continue;
+        }
+
+        std::string pluginStatistics = plugin->getStatistics();
+        if (!pluginStatistics.empty())
+            logger.write_info("Plugin " + plugin->getName() + ": " + pluginStatistics,
+                              true /* stdout */);
+    }
+
+    if (instr.rememberedValues.size() + instr.rememberedPTSets.size() > 0) {
+        logger.write_info("Remembered values: " +
+                          std::to_string(instr.rememberedValues.size()) +
+                          ", remembered points-to targets: " +
+                          std::to_string(instr.rememberedPTSets.size()),
+                          true /* stdout */);
+    }
+
+    const QueryCache& cache = instr.queryCache;
+    if (cache.getHits() + cache.getMisses() + cache.getUncached() > 0) {
+        logger.write_info("Queries to plugins: " +
+                          std::to_string(cache.getHits()) + " answered from cache, " +
+                          std::to_string(cache.getMisses()) + " computed (" +
+                          std::to_string(cache.getBatches()) + " batches), " +
+                          std::to_string(cache.getUncached()) + " not cacheable",
+                          true /* stdout */);
+    }
+
+    // dump the number of rules that are tried for each kind of instruction
+    int i = 0;
+    for (const auto& phase : instr.rewriter.getPhases()) {
+        ++i;
+        logger.write_info("Rules of the " + std::to_string(i) + ". phase:",
+                          true /* stdout */);
+        logger.write_info("  " + std::to_string(phase.entryRules.size()) +
+                          " for entry", true /* stdout */);
+        logger.write_info("  " + std::to_string(phase.returnRules.size()) +
+                          " for return", true /* stdout */);
+        for (unsigned op = 0; op < phase.opcodeRules.size(); ++op) {
+            if (phase.opcodeRules[op].empty())
+                continue;
+            logger.write_info("  " + std::to_string(phase.opcodeRules[op].size()) +
+                              " for " + Instruction::getOpcodeName(op),
+                              true /* stdout */);
+        }
+        if (!phase.sequences.empty()) {
+            logger.write_info("  " + std::to_string(phase.sequences.getSequencesNum()) +
+                              " for sequences (" +
+                              std::to_string(phase.sequences.getStatesNum()) +
+                              " states)", true /* stdout */);
+        }
+    }
 }
 
 int main(int argc, char *argv[]) {
@@ -1359,6 +1957,45 @@ int main(int argc, char *argv[]) {
         exit(1);
     }
 
+    bool noLinking = false;
+    int jobs = 1;
+    bool lazyPlugins = false;
+    string emitPlanPath;
+    string applyPlanPath;
+    // options of plugins given on the command line, PLUGIN.NAME=VALUE
+    vector<string> pluginOptions;
+    for (int i = 5; i < argc; ++i) {
+        if (strcmp(argv[i], "--no-linking") == 0) {
+            noLinking = true;
+        } else if (strncmp(argv[i], "--jobs=", 7) == 0) {
+            jobs = atoi(argv[i] + 7);
+            if (jobs < 1) {
+                cerr << "Invalid number of jobs: " << argv[i] + 7 << endl;
+                exit(1);
+            }
+        } else if (strcmp(argv[i], "--lazy-plugins") == 0) {
+            lazyPlugins = true;
+        } else if (strncmp(argv[i], "--plugin-option=", 16) == 0) {
+            string option = argv[i] + 16;
+            size_t dot = option.find('.');
+            size_t eq = option.find('=');
+            if (dot == string::npos || eq == string::npos || eq < dot ||
+                dot == 0 || eq == dot + 1) {
+                cerr << "Invalid plugin option: " << option << endl;
+                exit(1);
+            }
+            pluginOptions.push_back(option);
+        } else if (strncmp(argv[i], "--emit-plan=", 12) == 0) {
+            emitPlanPath = argv[i] + 12;
+        } else if (strncmp(argv[i], "--apply-plan=", 13) == 0) {
+            applyPlanPath = argv[i] + 13;
+        } else {
+            cerr << "Unknown option: " << argv[i] << endl;
+            usage(argv[0]);
+            exit(1);
+        }
+    }
+
     ifstream config_file;
     config_file.open(argv[1]);
 
@@ -1379,6 +2016,14 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
+    // options from the command line override the config
+    for (const auto& option : pluginOptions) {
+        size_t dot = option.find('.');
+        size_t eq = option.find('=');
+        rw.pluginOptions[option.substr(0, dot)][option.substr(dot + 1, eq - dot - 1)]
+            = option.substr(eq + 1);
+    }
+
     // Get module from LLVM file
     LLVMContext Context;
     SMDiagnostic Err;
@@ -1403,22 +2048,38 @@ int main(int argc, char *argv[]) {
     LLVMInstrumentation instr(*module.get(), *defModule.get());
     instr.rewriter = std::move(rw);
     instr.outputName = argv[4];
-
-    logger.write_info("Loading plugins...");
-    if (!loadPlugins(instr))
-        return 1;
+    instr.jobs = jobs;
+    instr.lazyPlugins = lazyPlugins;
+
+    // Load the plan, the plugins are not needed then
+    Json::Value appliedPlan;
+    if (!applyPlanPath.empty()) {
+        logger.write_info("Loading plan...");
+        if (!loadPlan(applyPlanPath, appliedPlan))
+            return 1;
+    } else {
+        logger.write_info("Loading plugins...");
+        if (!loadPlugins(instr))
+            return 1;
+    }
 
     // Instrument
-    bool resultOK = instrumentModule(instr);
+    Json::Value emittedPlan;
+    bool resultOK = instrumentModule(instr,
+                                     applyPlanPath.empty() ? nullptr : &appliedPlan,
+                                     emitPlanPath.empty() ? nullptr : &emittedPlan);
+
+    if (resultOK && !emitPlanPath.empty())
+        resultOK = savePlan(emitPlanPath, emittedPlan);
 
-    dumpStatistics();
+    dumpStatistics(instr);
 
     config_file.close();
     llvmir_file.close();
 
     // If option --no-linking is present, do not link definitions
     // of instrumentation functions
-    if (argc > 5 && strcmp(argv[5], "--no-linking") == 0 && resultOK) {
+    if (noLinking && resultOK) {
         saveModule(instr);
         logger.write_info("DONE.");
         return 0;
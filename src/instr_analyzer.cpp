@@ -10,8 +10,30 @@
 
 using namespace std;
 
-unique_ptr<InstrPlugin> Analyzer::analyze(const string &path,
-                                          llvm::Module* module)
+void StringPluginAdapter::bindQueries(const vector<string>& names) {
+    queryNames = names;
+    supported.clear();
+    for (const auto& name : names)
+        supported.push_back(plugin->supports(name));
+}
+
+bool StringPluginAdapter::supports(QueryId query) const {
+    return query < supported.size() && supported[query];
+}
+
+QueryResult StringPluginAdapter::query(QueryId query,
+                                       llvm::ArrayRef<llvm::Value *> operands) {
+    assert(query < queryNames.size() && "Unknown query");
+    return parseQueryResult(plugin->query(queryNames[query], operands.vec()));
+}
+
+bool StringPluginAdapter::isCacheable(QueryId query) const {
+    assert(query < queryNames.size() && "Unknown query");
+    return plugin->isCacheable(queryNames[query]);
+}
+
+unique_ptr<InstrPluginV2> Analyzer::analyze(const string &path,
+                                            llvm::Module* module)
 {
 
     if (path.empty())
@@ -27,8 +49,19 @@ unique_ptr<InstrPlugin> Analyzer::analyze(const string &path,
         return nullptr;
     }
 
+    void *symbol = DL.getAddressOfSymbol("create_object_v2");
+    if (symbol) {
+        auto create = reinterpret_cast<InstrPluginV2 *(*)(llvm::Module*, unsigned)>(symbol);
+        unique_ptr<InstrPluginV2> plugin(create(module, INSTR_PLUGIN_ABI_VERSION));
+        if (!plugin) {
+            cerr << "Plugin " << path << " does not implement version "
+                 << INSTR_PLUGIN_ABI_VERSION << " of the interface" << endl;
+        }
+        return plugin;
+    }
+
     InstrPlugin* (*create)(llvm::Module*);
-    void *symbol = DL.getAddressOfSymbol("create_object");
+    symbol = DL.getAddressOfSymbol("create_object");
     if (!symbol) {
         cerr << "Cannot load symbol 'create_object' from " << path << endl;
         return nullptr;
@@ -36,60 +69,68 @@ unique_ptr<InstrPlugin> Analyzer::analyze(const string &path,
 
 	create = reinterpret_cast<InstrPlugin *(*)(llvm::Module*)>(symbol);
 	unique_ptr<InstrPlugin> plugin(create(module));
+	if (!plugin)
+		return nullptr;
 
-	return plugin;
+	return unique_ptr<InstrPluginV2>(new StringPluginAdapter(std::move(plugin)));
 }
 
-bool Analyzer::shouldInstrument(const RememberedValues& rememberedValues,
-                                InstrPlugin* plugin,
-                                const Condition &condition,
-                                const ValuesVector& parameters,
-                                Logger& logger)
+unsigned Analyzer::getCapabilities(const string &path)
 {
+    if (path.empty())
+        return 0;
 
-    string answer;
+    auto DL = llvm::sys::DynamicLibrary::getPermanentLibrary(path.c_str());
+    if (!DL.isValid())
+        return 0;
 
-    if (condition.name == "isRemembered") {
-        assert(parameters.size() == 1);
-        if (!plugin->supports("pointsTo"))
-            return false;
+    void *symbol = DL.getAddressOfSymbol("instr_plugin_capabilities");
+    if (!symbol)
+        return 0;
 
-        for (const auto& v : rememberedValues) {
-            answer = plugin->query("pointsTo",
-                                   {v.first, *(parameters.begin())});
-            for (const auto& expV : condition.expectedValues)
-            if (answer == expV)
-                return true;
-        }
-        return false;
-    }
+    return *reinterpret_cast<const unsigned *>(symbol);
+}
 
-    if (condition.name == "pointsToRemembered") {
+bool Analyzer::shouldInstrument(const RememberedValues& rememberedValues,
+                                InstrPluginV2* plugin,
+                                const Condition &condition,
+                                llvm::ArrayRef<llvm::Value*> parameters,
+                                QueryCache& cache,
+                                Logger& logger,
+                                bool& answered)
+{
+
+    QueryResult answer;
+    answered = true;
+
+    if (condition.kind == ConditionKind::IS_REMEMBERED ||
+        condition.kind == ConditionKind::POINTS_TO_REMEMBERED) {
         assert(parameters.size() == 1);
-        if (!plugin->supports("pointsToSetsOverlap"))
+        if (!plugin->supports(condition.query))
             return false;
 
         for (const auto& v : rememberedValues) {
-            answer = plugin->query("pointsToSetsOverlap",
-                                   {v.first, *(parameters.begin())});
-            for (const auto& expV : condition.expectedValues)
-            if (answer == expV)
+            llvm::Value *operands[] = {v.first, parameters[0]};
+            answer = cache.query(plugin, condition.query, operands);
+            if (answer == QueryResult::Unsupported) {
+                answered = false;
+                return false;
+            }
+            if (condition.expectedResults & toQueryResults(answer))
                 return true;
         }
         return false;
     }
 
-    std::vector<llvm::Value *> operands(parameters.begin(), parameters.end());
-    assert(plugin->supports(condition.name)
+    assert(plugin->supports(condition.query)
             && "Plugin does not support the condition");
-    answer = plugin->query(condition.name, operands);
-    logger.write_info("Condition '" + condition.name + "' got answer: " + answer);
-    for (const auto& expV : condition.expectedValues) {
-        if (answer == expV) {
-            return true;
-        }
+    answer = cache.query(plugin, condition.query, parameters);
+    logger.write_info("Condition '" + condition.name + "' got answer: " +
+                      getQueryResultName(answer));
+    if (answer == QueryResult::Unsupported) {
+        answered = false;
+        return false;
     }
 
-	return false;
+    return condition.expectedResults & toQueryResults(answer);
 }
-
@@ -48,13 +48,13 @@ void Logger::log_insertion(const string& where,
  * @param foundInstrs found instructions for instrumentation
  * @param newInstr name of the new instruction
  */
-void Logger::log_insertion(InstrumentSequence foundInstrs, string newInstr) {
+void Logger::log_insertion(const InstrumentSequence& foundInstrs, const string& newInstr) {
 
     string instructions;
     uint i = 0;
 
-    for (list<InstrumentInstruction>::iterator sit=foundInstrs.begin(); sit != foundInstrs.end(); ++sit) {
-        InstrumentInstruction foundInstr = *sit;
+    for (list<InstrumentInstruction>::const_iterator sit=foundInstrs.begin(); sit != foundInstrs.end(); ++sit) {
+        const InstrumentInstruction& foundInstr = *sit;
 
         if (i < foundInstrs.size() - 1) {
             instructions += foundInstr.instruction + ", ";
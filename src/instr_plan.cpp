@@ -0,0 +1,224 @@
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <llvm/AsmParser/Parser.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/Support/SourceMgr.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "instr_plan.hpp"
+
+using namespace llvm;
+using namespace std;
+
+static const char *kindNames[] = {
+    "before", "after", "replace", "entry", "return", "global"
+};
+
+static const char *getKindName(InsertionKind kind) {
+    return kindNames[static_cast<unsigned>(kind)];
+}
+
+static InsertionKind getKind(const string& name) {
+    for (unsigned i = 0; i < sizeof(kindNames) / sizeof(*kindNames); ++i) {
+        if (name == kindNames[i])
+            return static_cast<InsertionKind>(i);
+    }
+
+    cerr << "Unknown kind of insertion in the plan: " << name << endl;
+    throw runtime_error("Plan parsing failure.");
+}
+
+// Positions of instructions in their functions, computed on demand
+class InstructionIds {
+    unordered_map<const Function*, unordered_map<const Instruction*, unsigned>> ids;
+ public:
+    unsigned get(const Instruction *I) {
+        auto& fids = ids[I->getFunction()];
+        if (fids.empty()) {
+            unsigned id = 0;
+            for (const Instruction& FI : instructions(I->getFunction()))
+                fids[&FI] = id++;
+        }
+        return fids[I];
+    }
+};
+
+// Instructions of functions by their positions, computed on demand
+class InstructionsById {
+    unordered_map<const Function*, vector<Instruction*>> instrs;
+ public:
+    Instruction *get(Function *F, const Json::Value& id) {
+        auto& finstrs = instrs[F];
+        if (finstrs.empty()) {
+            for (Instruction& FI : instructions(F))
+                finstrs.push_back(&FI);
+        }
+
+        if (!id.isUInt() || id.asUInt() >= finstrs.size()) {
+            cerr << "Invalid instruction in the plan: " << id.toStyledString()
+                 << "in function " << F->getName().str() << endl;
+            throw runtime_error("Plan parsing failure.");
+        }
+        return finstrs[id.asUInt()];
+    }
+};
+
+static Json::Value valueToJson(const Value *V, const Module& M, InstructionIds& ids) {
+    Json::Value json;
+    if (const Instruction *I = dyn_cast<Instruction>(V)) {
+        json["function"] = I->getFunction()->getName().str();
+        json["instruction"] = ids.get(I);
+    } else if (const Argument *A = dyn_cast<Argument>(V)) {
+        json["function"] = A->getParent()->getName().str();
+        json["argument"] = A->getArgNo();
+    } else if (isa<GlobalValue>(V)) {
+        json["global"] = V->getName().str();
+    } else if (isa<Constant>(V)) {
+        string str;
+        raw_string_ostream os(str);
+        V->printAsOperand(os, true /* print type */, &M);
+        json["constant"] = os.str();
+    } else {
+        string str;
+        raw_string_ostream os(str);
+        V->print(os);
+        cerr << "Cannot store value in the plan: " << os.str() << endl;
+        throw runtime_error("Plan writing failure.");
+    }
+
+    return json;
+}
+
+static Function *getFunction(Module& M, const Json::Value& name) {
+    Function *F = M.getFunction(name.asString());
+    if (!F || F->isDeclaration()) {
+        cerr << "Unknown function in the plan: " << name.asString() << endl;
+        throw runtime_error("Plan parsing failure.");
+    }
+    return F;
+}
+
+static Value *valueFromJson(const Json::Value& json, Module& M, InstructionsById& instrs) {
+    if (json.isMember("instruction"))
+        return instrs.get(getFunction(M, json["function"]), json["instruction"]);
+
+    if (json.isMember("argument")) {
+        Function *F = getFunction(M, json["function"]);
+        const Json::Value& no = json["argument"];
+        if (!no.isUInt() || no.asUInt() >= F->arg_size()) {
+            cerr << "Invalid argument in the plan: " << json.toStyledString() << endl;
+            throw runtime_error("Plan parsing failure.");
+        }
+        return &*std::next(F->arg_begin(), no.asUInt());
+    }
+
+    if (json.isMember("global")) {
+        GlobalValue *GV = M.getNamedValue(json["global"].asString());
+        if (!GV) {
+            cerr << "Unknown global in the plan: " << json["global"].asString() << endl;
+            throw runtime_error("Plan parsing failure.");
+        }
+        return GV;
+    }
+
+    SMDiagnostic Err;
+    Constant *C = parseConstantValue(json["constant"].asString(), Err, M);
+    if (!C) {
+        cerr << "Invalid constant in the plan: " << json.toStyledString();
+        Err.print("plan", errs());
+        throw runtime_error("Plan parsing failure.");
+    }
+    return C;
+}
+
+Json::Value planToJson(const PhasePlan& plan, const Module& M) {
+    InstructionIds ids;
+    Json::Value json;
+
+    json["callees"] = Json::Value(Json::arrayValue);
+    for (const auto& callee : plan.callees)
+        json["callees"].append(callee);
+
+    json["insertions"] = Json::Value(Json::arrayValue);
+    for (const Insertion& ins : plan.insertions) {
+        Json::Value jins;
+        jins["kind"] = getKindName(ins.kind);
+        jins["function"] = ins.function->getName().str();
+        if (ins.site)
+            jins["site"] = ids.get(ins.site);
+        jins["rule"] = ins.rule;
+
+        jins["arguments"] = Json::Value(Json::arrayValue);
+        for (const PlannedArgument& arg : ins.arguments) {
+            Json::Value jarg;
+            if (arg.value) {
+                jarg["value"] = valueToJson(arg.value, M, ids);
+                jarg["cast"] = arg.cast;
+            }
+            jins["arguments"].append(jarg);
+        }
+
+        for (const Instruction *I : ins.replaced)
+            jins["replaced"].append(ids.get(I));
+
+        json["insertions"].append(jins);
+    }
+
+    json["suppressed"] = Json::Value(Json::objectValue);
+    for (const auto& it : plan.suppressed)
+        json["suppressed"][it.first] = it.second;
+
+    return json;
+}
+
+void planFromJson(const Json::Value& json, Module& M, PhasePlan& plan) {
+    InstructionsById instrs;
+
+    for (const auto& callee : json["callees"])
+        plan.callees.push_back(callee.asString());
+
+    for (const auto& jins : json["insertions"]) {
+        Insertion ins;
+        ins.kind = getKind(jins["kind"].asString());
+        ins.function = getFunction(M, jins["function"]);
+        if (jins.isMember("site"))
+            ins.site = instrs.get(ins.function, jins["site"]);
+        ins.rule = jins["rule"].asUInt();
+        if (ins.rule >= plan.callees.size()) {
+            cerr << "Invalid rule in the plan: " << ins.rule << endl;
+            throw runtime_error("Plan parsing failure.");
+        }
+
+        for (const auto& jarg : jins["arguments"]) {
+            PlannedArgument arg;
+            if (!jarg.isNull()) {
+                arg.value = valueFromJson(jarg["value"], M, instrs);
+                arg.cast = jarg["cast"].asBool();
+            }
+            ins.arguments.push_back(arg);
+        }
+
+        for (const auto& id : jins["replaced"])
+            ins.replaced.push_back(instrs.get(ins.function, id));
+
+        bool needsSite = ins.kind != InsertionKind::ENTRY &&
+                         ins.kind != InsertionKind::GLOBAL;
+        if (needsSite != (ins.site != nullptr)) {
+            cerr << "Invalid site of insertion in the plan: "
+                 << jins.toStyledString() << endl;
+            throw runtime_error("Plan parsing failure.");
+        }
+
+        plan.insertions.push_back(std::move(ins));
+    }
+
+    for (const auto& name : json["suppressed"].getMemberNames())
+        plan.suppressed[name] = json["suppressed"][name].asUInt();
+}
@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <functional>
+#include <unordered_set>
+
+#include "query_cache.hpp"
+
+using namespace std;
+
+const unsigned QueryCache::MaxOperands;
+
+size_t QueryCache::KeyHash::operator()(const Key& key) const {
+    size_t h = hash<const void*>()(key.plugin);
+    h = h * 31 + key.query;
+    for (unsigned i = 0; i < key.operandsNum; ++i)
+        h = h * 31 + hash<const void*>()(key.operands[i]);
+    return h;
+}
+
+bool QueryCache::isCacheable(InstrPluginV2* plugin, QueryId query) {
+    auto it = cacheable.find({plugin, query});
+    if (it == cacheable.end())
+        it = cacheable.emplace(make_pair(plugin, query), plugin->isCacheable(query)).first;
+    return it->second;
+}
+
+void QueryCache::initialize(InstrPluginV2* plugin) {
+    if (plugin->isInitialized())
+        return;
+    // The analysis of the plugin may create constants and types in the
+    // LLVM context while other threads plan functions, so it runs under
+    // the lock that serializes such changes
+    lock_guard<mutex> guard(pluginLock);
+    plugin->ensureInitialized();
+}
+
+QueryResult QueryCache::query(InstrPluginV2* plugin, QueryId query,
+                              llvm::ArrayRef<llvm::Value*> operands) {
+    Key key;
+    key.plugin = plugin;
+    key.query = query;
+    key.operandsNum = operands.size();
+    key.operands.fill(nullptr);
+
+    {
+        lock_guard<mutex> guard(lock);
+        if (!isCacheable(plugin, query) || operands.size() > MaxOperands) {
+            ++uncached;
+            key.plugin = nullptr;
+        } else {
+            copy(operands.begin(), operands.end(), key.operands.begin());
+            auto answer = answers.find(key);
+            if (answer != answers.end()) {
+                ++hits;
+                return answer->second;
+            }
+            ++misses;
+        }
+    }
+
+    // Do not hold the lock of the cache while the plugin works,
+    // other threads may use the cache meanwhile
+    initialize(plugin);
+
+    QueryResult answer;
+    {
+        unique_lock<mutex> guard;
+        if (!plugin->isThreadSafe())
+            guard = unique_lock<mutex>(pluginLock);
+        answer = plugin->query(query, operands);
+    }
+
+    if (key.plugin) {
+        lock_guard<mutex> guard(lock);
+        answers.emplace(key, answer);
+    }
+
+    return answer;
+}
+
+void QueryCache::clear() {
+    lock_guard<mutex> guard(lock);
+    answers.clear();
+}
+
+void QueryCache::answerBatch(const QueryBatch& batch) {
+    // queries that are not answered yet, grouped by plugins
+    map<InstrPluginV2*, vector<const Key*>> pending;
+    {
+        lock_guard<mutex> guard(lock);
+        unordered_set<Key, KeyHash> seen;
+        for (const Key& key : batch.keys) {
+            if (!isCacheable(key.plugin, key.query) ||
+                answers.count(key) > 0 || !seen.insert(key).second)
+                continue;
+            pending[key.plugin].push_back(&key);
+        }
+    }
+
+    for (auto& it : pending) {
+        InstrPluginV2 *plugin = it.first;
+        initialize(plugin);
+
+        vector<BatchQuery> queries(it.second.size());
+        for (size_t i = 0; i < queries.size(); ++i) {
+            const Key& key = *it.second[i];
+            queries[i].query = key.query;
+            queries[i].operands = llvm::makeArrayRef(key.operands.data(), key.operandsNum);
+        }
+
+        {
+            unique_lock<mutex> guard;
+            if (!plugin->isThreadSafe())
+                guard = unique_lock<mutex>(pluginLock);
+            plugin->queryBatch(queries);
+        }
+
+        lock_guard<mutex> guard(lock);
+        for (size_t i = 0; i < queries.size(); ++i) {
+            if (answers.emplace(*it.second[i], queries[i].result).second)
+                ++misses;
+        }
+        ++batches;
+    }
+}
+
+void QueryBatch::add(InstrPluginV2* plugin, QueryId query,
+                     llvm::ArrayRef<llvm::Value*> operands) {
+    if (operands.size() > QueryCache::MaxOperands)
+        return;
+
+    QueryCache::Key key;
+    key.plugin = plugin;
+    key.query = query;
+    key.operandsNum = operands.size();
+    key.operands.fill(nullptr);
+    copy(operands.begin(), operands.end(), key.operands.begin());
+    keys.push_back(key);
+}
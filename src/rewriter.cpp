@@ -2,9 +2,13 @@
 #include <string>
 #include <iostream>
 #include <fstream>
+#include <iterator>
+#include <algorithm>
 #include "rewriter.hpp"
 #include "json/json.h"
 
+#include <llvm/IR/Instruction.h>
+
 using namespace std;
 
 void parseConditions(const Json::Value& conditions, std::list<Condition>& r_conditions) {
@@ -37,6 +41,26 @@ BinOpType getType(const std::string& type) {
     return BinOpType::NBOP;
 }
 
+/**
+ * Translates the name of an instruction to its opcode.
+ * @param name name of the instruction as returned by getOpcodeName()
+ * @return opcode of the instruction or 0 if there is no such instruction
+ */
+unsigned getOpcode(const std::string& name) {
+    static std::map<std::string, unsigned> opcodes;
+    if (opcodes.empty()) {
+        for (unsigned op = 1; op < llvm::Instruction::OtherOpsEnd; ++op) {
+            opcodes.emplace(llvm::Instruction::getOpcodeName(op), op);
+        }
+    }
+
+    auto it = opcodes.find(name);
+    if (it == opcodes.end())
+        return 0;
+
+    return it->second;
+}
+
 void parseRule(const Json::Value& rule, RewriteRule& r) {
     // Get findInstructions
     for (const auto& findInstruction : rule["findInstructions"]) {
@@ -47,6 +71,12 @@ void parseRule(const Json::Value& rule, RewriteRule& r) {
         }
 
         instr.instruction = findInstruction["instruction"].asString();
+        instr.opcode = getOpcode(instr.instruction);
+        if (instr.opcode == 0) {
+            cerr << "Unknown instruction '" << instr.instruction
+                 << "', the rule will never be applied\n";
+        }
+
         for (const auto& operand : findInstruction["operands"]) {
             instr.parameters.push_back(operand.asString());
         }
@@ -128,20 +158,344 @@ void parseGlobalRule(const Json::Value& globalRule, GlobalVarsRule& rw_globals_r
     rw_globals_rule.inFunction = globalRule["in"].asString();
 }
 
-void parsePhase(const Json::Value& phase, Phase& r_phase) {
+/**
+ * Assigns slots to the variables of one rule.
+ */
+class VariableSlots {
+    std::vector<std::string> names;
+
+  public:
+    /**
+     * Gets the slot of a variable, a new slot is created
+     * if the variable has not been seen yet.
+     */
+    int bind(const std::string& name) {
+        int slot = find(name);
+        if (slot != NoSlot)
+            return slot;
+
+        if (names.size() >= MaxRuleVariables) {
+            cerr << "Too many variables in a rule, at most "
+                 << MaxRuleVariables << " are supported\n";
+            throw runtime_error("Config parsing failure.");
+        }
+
+        names.push_back(name);
+        return names.size() - 1;
+    }
+
+    /**
+     * Gets the slot of a variable or NoSlot if the name
+     * is not a variable of the rule.
+     */
+    int find(const std::string& name) const {
+        for (unsigned i = 0; i < names.size(); ++i) {
+            if (names[i] == name)
+                return i;
+        }
+
+        return NoSlot;
+    }
+
+    unsigned size() const { return names.size(); }
+};
+
+bool isVariable(const std::string& name) {
+    return name.size() > 1 && name.front() == '<' && name.back() == '>';
+}
+
+void bindSlots(const std::list<std::string>& names, std::vector<int>& slots,
+               VariableSlots& vars) {
+    for (const auto& name : names) {
+        slots.push_back(vars.bind(name));
+    }
+}
+
+/**
+ * Gets the id of the query, assigns a new one if the query is new.
+ * @param name name of the query
+ * @param queries names of queries indexed by their ids
+ * @return id of the query
+ */
+QueryId internQuery(const string& name, vector<string>& queries) {
+    auto it = find(queries.begin(), queries.end(), name);
+    if (it != queries.end())
+        return it - queries.begin();
+
+    queries.push_back(name);
+    return queries.size() - 1;
+}
+
+void compileCondition(Condition& condition, const VariableSlots& vars,
+                      const Flags& flags, vector<string>& queries) {
+    if (flags.find(condition.name) != flags.end()) {
+        condition.kind = ConditionKind::FLAG;
+    } else if (condition.name == "isRemembered") {
+        condition.kind = ConditionKind::IS_REMEMBERED;
+        condition.query = PointsToQuery;
+    } else if (condition.name == "pointsToRemembered") {
+        condition.kind = ConditionKind::POINTS_TO_REMEMBERED;
+        condition.query = PointsToSetsOverlapQuery;
+    } else {
+        if (condition.name == "isRemembered+")
+            condition.kind = ConditionKind::IS_REMEMBERED_PLUS;
+        condition.query = internQuery(condition.name, queries);
+    }
+
+    if (condition.kind != ConditionKind::FLAG) {
+        for (const auto& expected : condition.expectedValues) {
+            QueryResult result = parseQueryResult(expected);
+            if (result == QueryResult::Unsupported) {
+                cerr << "Unknown expected result '" << expected
+                     << "' of the query '" << condition.name << "'" << endl;
+                continue;
+            }
+            condition.expectedResults |= toQueryResults(result);
+        }
+    }
+
+    for (const auto& arg : condition.arguments) {
+        if (arg == "<this>") {
+            condition.argumentSlots.push_back(ThisSlot);
+        } else {
+            condition.argumentSlots.push_back(vars.find(arg));
+        }
+    }
+}
+
+void compileNewInstruction(InstrumentInstruction& newInstr,
+                           const VariableSlots& vars) {
+    newInstr.opcode = getOpcode(newInstr.instruction);
+    if (newInstr.parameters.empty())
+        return;
+
+    newInstr.calledFunction = newInstr.parameters.back();
+    for (auto it = newInstr.parameters.begin(),
+              last = std::prev(newInstr.parameters.end()); it != last; ++it) {
+        CallArgument arg;
+        arg.slot = vars.find(*it);
+        if (arg.slot != NoSlot) {
+            arg.kind = ArgumentKind::VARIABLE;
+        } else {
+            try {
+                arg.value = stoi(*it);
+                arg.kind = ArgumentKind::CONSTANT;
+            } catch (invalid_argument&) {
+                arg.kind = ArgumentKind::INVALID;
+            } catch (out_of_range&) {
+                arg.kind = ArgumentKind::OUT_OF_RANGE;
+            }
+        }
+        newInstr.arguments.push_back(arg);
+    }
+}
+
+/**
+ * Lowers the rule into the compiled form, that is, resolves
+ * variables to slots and pre-parses arguments of the new instruction.
+ * @param r parsed rule
+ * @param flags flags declared in the configuration
+ * @param queries names of queries to plugins, new queries are added
+ */
+void compileRule(RewriteRule& r, const Flags& flags, vector<string>& queries) {
+    VariableSlots vars;
+
+    for (auto& instr : r.foundInstrs) {
+        instr.anyOperands = instr.parameters.size() == 1 &&
+                            instr.parameters.front() == "*";
+        for (const auto& param : instr.parameters) {
+            OperandPattern op;
+            if (param == "*") {
+                op.kind = OperandKind::ANY;
+            } else if (isVariable(param)) {
+                op.kind = OperandKind::VARIABLE;
+                op.slot = vars.bind(param);
+                op.stripInboundsOffsets = instr.stripInboundsOffsets == param;
+            } else {
+                op.kind = OperandKind::NAME;
+                op.name = param;
+            }
+            instr.operands.push_back(op);
+        }
+
+        if (!instr.getDestType.empty())
+            instr.getDestTypeSlot = vars.bind(instr.getDestType);
+        if (isVariable(instr.returnValue))
+            instr.returnValueSlot = vars.bind(instr.returnValue);
+    }
+
+    // type size and pointer infos are taken only from the first instruction
+    if (!r.foundInstrs.empty()) {
+        auto& first = r.foundInstrs.front();
+        if (!first.getSizeTo.empty())
+            first.getSizeToSlot = vars.bind(first.getSizeTo);
+
+        if (r.foundInstrs.size() == 1) {
+            if (first.getPointerInfoTo.size() == 3)
+                bindSlots(first.getPointerInfoTo, first.getPointerInfoSlots, vars);
+            if (first.getPointerInfoMinTo.size() == 3)
+                bindSlots(first.getPointerInfoMinTo, first.getPointerInfoMinSlots, vars);
+            if (first.getPInfoMinMaxTo.size() == 5)
+                bindSlots(first.getPInfoMinMaxTo, first.getPInfoMinMaxSlots, vars);
+        }
+    }
+
+    for (auto& condition : r.conditions) {
+        compileCondition(condition, vars, flags, queries);
+    }
+
+    compileNewInstruction(r.newInstr, vars);
+    r.rememberSlot = vars.find(r.remember);
+    r.rememberPTSetSlot = vars.find(r.rememberPTSet);
+    r.variablesNum = vars.size();
+}
+
+/**
+ * Lowers the rule for global variables into the compiled form.
+ * @param r parsed rule
+ * @param flags flags declared in the configuration
+ * @param queries names of queries to plugins, new queries are added
+ */
+void compileGlobalRule(GlobalVarsRule& r, const Flags& flags, vector<string>& queries) {
+    VariableSlots vars;
+
+    if (r.globalVar.globalVariable != "*")
+        r.globalVar.globalVariableSlot = vars.bind(r.globalVar.globalVariable);
+    if (!r.globalVar.getSizeTo.empty())
+        r.globalVar.getSizeToSlot = vars.bind(r.globalVar.getSizeTo);
+
+    for (auto& condition : r.conditions) {
+        compileCondition(condition, vars, flags, queries);
+    }
+
+    compileNewInstruction(r.newInstr, vars);
+    r.variablesNum = vars.size();
+}
+
+const SequenceMatcher::State SequenceMatcher::Start;
+
+void SequenceMatcher::addSequence(const vector<unsigned>& opcodes, unsigned rule) {
+    State state = Start;
+    for (unsigned opcode : opcodes) {
+        auto it = nodes[state].children.find(opcode);
+        if (it == nodes[state].children.end()) {
+            nodes.emplace_back();
+            it = nodes[state].children.emplace(opcode, nodes.size() - 1).first;
+        }
+        state = it->second;
+    }
+
+    nodes[state].matches.push_back(rule);
+    ++sequencesNum;
+    if (opcodes.size() > maxLength)
+        maxLength = opcodes.size();
+}
+
+void SequenceMatcher::build(unsigned opcodes) {
+    opcodesNum = opcodes;
+    transitions.assign(nodes.size() * opcodesNum, Start);
+
+    // Breadth-first search, so that the fail state of a node
+    // is complete when we get to the node
+    vector<State> queue;
+    queue.reserve(nodes.size());
+    for (const auto& child : nodes[Start].children) {
+        transitions[child.first] = child.second;
+        queue.push_back(child.second);
+    }
+
+    for (size_t i = 0; i < queue.size(); ++i) {
+        State state = queue[i];
+        Node& node = nodes[state];
+
+        // Sequences that end in the fail state end here too
+        const RuleIndices& inherited = nodes[node.fail].matches;
+        node.matches.insert(node.matches.end(), inherited.begin(), inherited.end());
+        std::sort(node.matches.begin(), node.matches.end());
+
+        for (unsigned opcode = 0; opcode < opcodesNum; ++opcode) {
+            transitions[state * opcodesNum + opcode] =
+                transitions[node.fail * opcodesNum + opcode];
+        }
+
+        for (const auto& child : node.children) {
+            nodes[child.second].fail = transitions[node.fail * opcodesNum + child.first];
+            transitions[state * opcodesNum + child.first] = child.second;
+            queue.push_back(child.second);
+        }
+    }
+}
+
+/**
+ * Sorts rules of the phase into buckets, so that we do not need
+ * to go through all the rules for every instruction.
+ * @param r_phase phase with parsed rules
+ */
+void indexPhase(Phase& r_phase) {
+    r_phase.opcodeRules.assign(llvm::Instruction::OtherOpsEnd, RuleIndices());
+
+    for (unsigned idx = 0; idx < r_phase.config.size(); ++idx) {
+        const RewriteRule& r = r_phase.config[idx];
+        if (!r.setFlags.empty() || r.rememberSlot != NoSlot ||
+                r.rememberPTSetSlot != NoSlot) {
+            r_phase.changesState = true;
+        }
+        // getting the pointer info (min, max) remembers the pointed-to
+        // objects for isRemembered+ too
+        for (const auto& found : r.foundInstrs) {
+            if (!found.getPInfoMinMaxSlots.empty())
+                r_phase.changesState = true;
+        }
+
+        if (r.where == InstrumentPlacement::ENTRY) {
+            r_phase.entryRules.push_back(idx);
+        } else if (r.where == InstrumentPlacement::RETURN) {
+            r_phase.returnRules.push_back(idx);
+        }
+
+        if (r.foundInstrs.empty())
+            continue;
+
+        if (r.foundInstrs.size() == 1) {
+            // rules with unknown instruction can never match
+            if (r.foundInstrs.front().opcode != 0)
+                r_phase.opcodeRules[r.foundInstrs.front().opcode].push_back(idx);
+            continue;
+        }
+
+        vector<unsigned> opcodes;
+        for (const auto& found : r.foundInstrs) {
+            if (found.opcode == 0)
+                break;
+            opcodes.push_back(found.opcode);
+        }
+
+        if (opcodes.size() == r.foundInstrs.size())
+            r_phase.sequences.addSequence(opcodes, idx);
+    }
+
+    r_phase.sequences.build(llvm::Instruction::OtherOpsEnd);
+}
+
+void parsePhase(const Json::Value& phase, Phase& r_phase, const Flags& flags,
+                vector<string>& queries) {
     // Load instructions rules for instructions
     for (const auto& rule : phase["instructionsRules"]) {
         RewriteRule rw_rule;
         parseRule(rule, rw_rule);
-        r_phase.config.push_back(rw_rule);
+        compileRule(rw_rule, flags, queries);
+        r_phase.config.push_back(std::move(rw_rule));
     }
 
     // Load global variables rules for instructions
     for (const auto& rule : phase["globalVariablesRules"]) {
         GlobalVarsRule g_rule;
         parseGlobalRule(rule, g_rule);
-        r_phase.gconfig.push_back(g_rule);
+        compileGlobalRule(g_rule, flags, queries);
+        r_phase.gconfig.push_back(std::move(g_rule));
     }
+
+    indexPhase(r_phase);
 }
 
 void Rewriter::parseConfig(ifstream &config_file) {
@@ -178,6 +532,28 @@ void Rewriter::parseConfig(ifstream &config_file) {
         }
     }
 
+    // Load options of plugins
+    const Json::Value& options = json_rules["pluginOptions"];
+    if (!options.isNull() && !options.isObject()) {
+        cerr << "pluginOptions must map names of plugins to their options" << endl;
+        throw runtime_error("Config parsing failure.");
+    }
+    for (const auto& plugin : options.getMemberNames()) {
+        if (!options[plugin].isObject()) {
+            cerr << "Options of the plugin " << plugin << " must be an object" << endl;
+            throw runtime_error("Config parsing failure.");
+        }
+        for (const auto& option : options[plugin].getMemberNames()) {
+            const Json::Value& value = options[plugin][option];
+            if (!value.isConvertibleTo(Json::stringValue)) {
+                cerr << "Invalid value of the option '" << option
+                     << "' of the plugin " << plugin << endl;
+                throw runtime_error("Config parsing failure.");
+            }
+            pluginOptions[plugin][option] = value.asString();
+        }
+    }
+
     // Load flags
     for (const auto& flag : json_rules["flags"]) {
         this->flags.insert(Flag(flag.asString(), ""));
@@ -186,31 +562,32 @@ void Rewriter::parseConfig(ifstream &config_file) {
     // Load phases
     for (const auto& phase : json_rules["phases"]) {
         Phase rw_phase;
-        parsePhase(phase, rw_phase);
-        this->phases.push_back(rw_phase);
+        parsePhase(phase, rw_phase, this->flags, this->queryNames);
+        this->phases.push_back(std::move(rw_phase));
     }
 }
 
-const Phases& Rewriter::getPhases() {
+const Phases& Rewriter::getPhases() const {
     return this->phases;
 }
 
-bool Rewriter::isFlag(string name) {
+bool Rewriter::isFlag(const string& name) const {
     auto search = this->flags.find(name);
     return search != this->flags.end();
 }
 
-void Rewriter::setFlag(string name, string value) {
+void Rewriter::setFlag(const string& name, const string& value) {
     auto search = this->flags.find(name);
     if (search != this->flags.end())
             search->second = value;
 }
 
-string Rewriter::getFlagValue(string name) {
+const string& Rewriter::getFlagValue(const string& name) const {
+    static const string none;
     auto search = this->flags.find(name);
     if (search != this->flags.end())
         return search->second;
 
-    return "";
+    return none;
 }
 
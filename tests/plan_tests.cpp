@@ -0,0 +1,207 @@
+#include <catch2/catch.hpp>
+
+#include <llvm/AsmParser/Parser.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IRReader/IRReader.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/SourceMgr.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+// program with insertions of all kinds: entry, return, before, after,
+// replace and global
+const char *program = R"(
+@g = global i32 0, align 4
+
+define i32 @foo(i32 %a, i32 %b) {
+entry:
+  %x = alloca i32, align 4
+  store i32 %a, i32* %x, align 4
+  %l = load i32, i32* %x, align 4
+  %s = add nsw i32 %l, %b
+  %c = icmp sgt i32 %s, 0
+  br i1 %c, label %then, label %else
+then:
+  %k = add i8 1, 2
+  %k16 = add nsw i16 1, 2
+  ret i32 %s
+else:
+  ret i32 0
+}
+
+define i32 @main() {
+entry:
+  %a = call i32 @foo(i32 1, i32 2)
+  %g = load i32, i32* @g, align 4
+  %e = add nsw i32 %g, %a
+  store i32 %e, i32* @g, align 4
+  ret i32 %e
+}
+)";
+
+// the same program without foo, the plan does not fit it
+const char *otherProgram = R"(
+define i32 @main() {
+entry:
+  ret i32 0
+}
+)";
+
+const char *definitions = R"(
+define void @__INSTR_entry() {
+  ret void
+}
+
+define void @__INSTR_ret() {
+  ret void
+}
+
+define void @__INSTR_load(i8* %p, i64 %s) {
+  ret void
+}
+
+define void @__INSTR_store(i8* %p, i64 %s) {
+  ret void
+}
+
+define void @__INSTR_check_add_i32(i32 %x, i32 %y) {
+  ret void
+}
+
+define void @__INSTR_global(i8* %p, i64 %s) {
+  ret void
+}
+)";
+
+// no plugins are loaded, so the conditions are satisfied speculatively
+const char *config = R"({
+    "phases": [
+        {
+            "instructionsRules": [
+                {
+                    "newInstruction": {"returnValue": "*", "instruction": "call",
+                                       "operands": ["__INSTR_entry"]},
+                    "where": "entry", "in": "*"
+                },
+                {
+                    "newInstruction": {"returnValue": "*", "instruction": "call",
+                                       "operands": ["__INSTR_ret"]},
+                    "where": "return", "in": "foo"
+                },
+                {
+                    "findInstructions": [{"returnValue": "*", "instruction": "load",
+                                          "operands": ["<t1>"], "getTypeSize": "<t2>"}],
+                    "newInstruction": {"returnValue": "*", "instruction": "call",
+                                       "operands": ["<t1>", "<t2>", "__INSTR_load"]},
+                    "conditions": [{"query": ["isValidPointer", "<t1>", "<t2>"],
+                                    "expectedResults": ["false", "maybe", "unknown"]}],
+                    "where": "before", "in": "*"
+                },
+                {
+                    "findInstructions": [{"returnValue": "<r>", "instruction": "add",
+                                          "operands": ["<t1>", "<t2>"], "type": "i32"}],
+                    "newInstruction": {"returnValue": "*", "instruction": "call",
+                                       "operands": ["<t1>", "<t2>", "__INSTR_check_add_i32"]},
+                    "where": "after", "in": "*"
+                },
+                {
+                    "findInstructions": [
+                        {"returnValue": "*", "instruction": "add", "operands": ["*", "*"],
+                         "type": "i8"},
+                        {"returnValue": "*", "instruction": "add", "operands": ["*", "*"],
+                         "type": "i16"}],
+                    "newInstruction": {"returnValue": "*", "instruction": "call",
+                                       "operands": ["__INSTR_entry"]},
+                    "where": "replace", "in": "*"
+                }
+            ],
+            "globalVariablesRules": [
+                {
+                    "findGlobals": {"globalVariable": "<t1>", "getTypeSize": "<t2>"},
+                    "newInstruction": {"returnValue": "*", "instruction": "call",
+                                       "operands": ["<t1>", "<t2>", "__INSTR_global"]},
+                    "in": "main"
+                }
+            ]
+        },
+        {
+            "instructionsRules": [
+                {
+                    "findInstructions": [{"returnValue": "*", "instruction": "store",
+                                          "operands": ["*", "<t1>"], "getTypeSize": "<t2>"}],
+                    "newInstruction": {"returnValue": "*", "instruction": "call",
+                                       "operands": ["<t1>", "<t2>", "__INSTR_store"]},
+                    "where": "before", "in": "*"
+                }
+            ]
+        }
+    ]
+})";
+
+void writeFile(const std::string &path, const char *content) {
+    std::ofstream os(path);
+    os << content;
+}
+
+void writeBitcode(const std::string &path, const char *assembly) {
+    llvm::LLVMContext context;
+    llvm::SMDiagnostic SMD;
+    auto module = llvm::parseAssemblyString(assembly, SMD, context);
+    REQUIRE(module);
+
+    std::error_code EC;
+    llvm::raw_fd_ostream os(path, EC, llvm::sys::fs::OF_None);
+    REQUIRE(!EC);
+    llvm::WriteBitcodeToFile(*module, os);
+}
+
+// returns the instrumented module as text
+std::string readModule(const std::string &path) {
+    llvm::LLVMContext context;
+    llvm::SMDiagnostic SMD;
+    auto module = llvm::parseIRFile(path, SMD, context);
+    REQUIRE(module);
+    // the identifier is the name of the output file
+    module->setModuleIdentifier("instrumented");
+
+    std::string text;
+    llvm::raw_string_ostream os(text);
+    module->print(os, nullptr);
+    return os.str();
+}
+
+int instrument(const std::string &program, const std::string &output,
+               const std::string &option = "") {
+    std::string command = std::string(SBT_INSTR) + " plan-config.json " + program +
+                          " plan-defs.bc " + output + " " + option + " > /dev/null 2>&1";
+    return std::system(command.c_str());
+}
+
+TEST_CASE("applied plan gives the planned instrumentation") {
+    writeFile("plan-config.json", config);
+    writeBitcode("plan-prog.bc", program);
+    writeBitcode("plan-other.bc", otherProgram);
+    writeBitcode("plan-defs.bc", definitions);
+
+    REQUIRE(instrument("plan-prog.bc", "plan-out.bc") == 0);
+    REQUIRE(instrument("plan-prog.bc", "plan-emit.bc", "--emit-plan=plan.json") == 0);
+
+    const std::string instrumented = readModule("plan-out.bc");
+    CHECK(instrumented.find("call void @__INSTR_global") != std::string::npos);
+    CHECK(instrumented.find("call void @__INSTR_store") != std::string::npos);
+    CHECK(readModule("plan-emit.bc") == instrumented);
+
+    SECTION("same program") {
+        REQUIRE(instrument("plan-prog.bc", "plan-apply.bc", "--apply-plan=plan.json") == 0);
+        CHECK(readModule("plan-apply.bc") == instrumented);
+    }
+
+    SECTION("plan made for another program") {
+        CHECK(instrument("plan-other.bc", "plan-apply.bc", "--apply-plan=plan.json") != 0);
+    }
+}
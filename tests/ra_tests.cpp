@@ -0,0 +1,147 @@
+#include <catch2/catch.hpp>
+
+#include "ra/CSRConstraintGraph.h"
+#include "ra/RangeAnalysis.h"
+
+#include <functional>
+#include <set>
+#include <string>
+#include <vector>
+
+// the bit width of the ranges, set by the range analysis for each function
+extern thread_local unsigned MAX_BIT_INT;
+
+void setBitWidth(unsigned width) {
+    MAX_BIT_INT = width;
+    RangeAnalysis::updateMinMax(width);
+}
+
+// sign-extends the lowest width bits of the value
+int64_t wrap(uint64_t value, unsigned width) {
+    unsigned shift = 64 - width;
+    return (int64_t)(value << shift) >> shift;
+}
+
+// values at the edges of the bit width, with small ones for shifts
+std::vector<int64_t> edgeValues(const IntervalKernel64 &kernel) {
+    unsigned width = kernel.getWidth();
+    const uint64_t min = kernel.getMin();
+    const uint64_t max = kernel.getMax();
+    std::set<int64_t> values;
+    for (uint64_t value : std::initializer_list<uint64_t>{min, min + 1, ~0ull, 0, 1, 2, max - 1,
+                                                          max, width - 1u, width})
+        values.insert(wrap(value, width));
+    return {values.begin(), values.end()};
+}
+
+std::vector<Interval64> edgeIntervals(const IntervalKernel64 &kernel) {
+    std::vector<int64_t> values = edgeValues(kernel);
+    std::vector<Interval64> intervals;
+    for (size_t i = 0; i < values.size(); ++i) {
+        for (size_t j = i; j < values.size(); ++j)
+            intervals.push_back(kernel.make(values[i], values[j]));
+    }
+    return intervals;
+}
+
+std::string toString(const Interval64 &a) {
+    if (a.type == Empty)
+        return "empty";
+    if (a.type == Unknown)
+        return "unknown";
+    return "[" + std::to_string(a.l) + ", " + std::to_string(a.u) + "]";
+}
+
+using RangeOp = std::function<Range(Range &, const Range &)>;
+using KernelOp = std::function<Interval64(const IntervalKernel64 &, const Interval64 &,
+                                          const Interval64 &)>;
+
+void checkBinary(const IntervalKernel64 &kernel, const std::vector<Interval64> &intervals,
+                 const RangeOp &rangeOp, const KernelOp &kernelOp) {
+    for (const Interval64 &a : intervals) {
+        for (const Interval64 &b : intervals) {
+            Range ra = kernel.toRange(a);
+            Range result = rangeOp(ra, kernel.toRange(b));
+            Interval64 expected = kernel.fromRange(result);
+            Interval64 got = kernelOp(kernel, a, b);
+            if (got != expected) {
+                INFO(toString(a) << " and " << toString(b) << ": Range gives "
+                                 << toString(expected) << ", the kernel " << toString(got));
+                CHECK(got == expected);
+            }
+        }
+    }
+}
+
+TEST_CASE("IntervalKernel64 gives the results of Range") {
+    const unsigned width = GENERATE(1u, 2u, 8u, 16u, 32u, 33u, 63u, 64u);
+    INFO("bit width " << width);
+    setBitWidth(width);
+    IntervalKernel64 kernel(width);
+    const std::vector<Interval64> intervals = edgeIntervals(kernel);
+
+    SECTION("bounds") {
+        CHECK(kernel.getMin() == Min.getSExtValue());
+        CHECK(kernel.getMax() == Max.getSExtValue());
+        CHECK(kernel.isMaxRange(kernel.fromRange(Range())));
+    }
+
+    SECTION("conversions") {
+        for (const Interval64 &a : intervals) {
+            INFO(toString(a));
+            CHECK(kernel.fromRange(kernel.toRange(a)) == a);
+        }
+    }
+
+#define CHECK_BINARY(op)                                                                   \
+    SECTION(#op) {                                                                         \
+        checkBinary(                                                                       \
+                kernel, intervals, [](Range &a, const Range &b) { return a.op(b); },      \
+                [](const IntervalKernel64 &k, const Interval64 &a, const Interval64 &b) { \
+                    return k.op(a, b);                                                     \
+                });                                                                        \
+    }
+
+    CHECK_BINARY(add)
+    CHECK_BINARY(sub)
+    CHECK_BINARY(mul)
+    CHECK_BINARY(udiv)
+    CHECK_BINARY(sdiv)
+    CHECK_BINARY(urem)
+    CHECK_BINARY(srem)
+    CHECK_BINARY(shl)
+    CHECK_BINARY(lshr)
+    CHECK_BINARY(ashr)
+    CHECK_BINARY(And)
+    CHECK_BINARY(Or)
+    CHECK_BINARY(Xor)
+#undef CHECK_BINARY
+
+    SECTION("intersectWith and unionWith") {
+        std::vector<Interval64> typed = intervals;
+        typed.push_back(kernel.make(0, 0, Empty));
+        typed.push_back(kernel.make(kernel.getMin(), kernel.getMax(), Unknown));
+        checkBinary(
+                kernel, typed, [](Range &a, const Range &b) { return a.intersectWith(b); },
+                [](const IntervalKernel64 &k, const Interval64 &a, const Interval64 &b) {
+                    return k.intersectWith(a, b);
+                });
+        checkBinary(
+                kernel, typed, [](Range &a, const Range &b) { return a.unionWith(b); },
+                [](const IntervalKernel64 &k, const Interval64 &a, const Interval64 &b) {
+                    return k.unionWith(a, b);
+                });
+    }
+
+    SECTION("truncate and zextOrTrunc") {
+        for (unsigned bitwidth = 1; bitwidth <= width; ++bitwidth) {
+            for (const Interval64 &a : intervals) {
+                INFO(toString(a) << " to " << bitwidth << " bits");
+                Range ra = kernel.toRange(a);
+                CHECK(kernel.truncate(a, bitwidth) == kernel.fromRange(ra.truncate(bitwidth)));
+                CHECK(kernel.zextOrTrunc(a, bitwidth) ==
+                      kernel.fromRange(ra.zextOrTrunc(bitwidth)));
+            }
+        }
+    }
+}
@@ -93,6 +93,10 @@ void testBenchmark(const std::string &path, const std::string &benchmark, CheckT
     REQUIRE(module);
 
     ValueRelationsPlugin plugin(module.get());
+    plugin.bindQueries({"isValidPointer"});
+    plugin.initialize();
+    // the only bound query gets the id 0
+    const QueryId isValidPointer = 0;
 
     bool someFalse = false;
 
@@ -105,17 +109,17 @@ void testBenchmark(const std::string &path, const std::string &benchmark, CheckT
                 if (!ptr || size == 0)
                     continue;
 
-                std::string answer = plugin.query("isValidPointer", {ptr, size});
+                QueryResult answer = plugin.query(isValidPointer, {ptr, size});
                 INFO(dg::debug::getValName(ptr));
 
                 if (!llvm::isa<llvm::AllocaInst>(ptr)) {
-                    INFO(answer);
+                    INFO(getQueryResultName(answer));
                     switch (type) {
                     case CheckType::REQUIRE_TRUE:
-                        CHECK(answer == "true");
+                        CHECK(answer == QueryResult::True);
                         break;
                     case CheckType::SOME_FALSE:
-                        someFalse |= answer != "true";
+                        someFalse |= answer != QueryResult::True;
                         break;
                     case CheckType::PRINT_ALL:
                         CHECK(false); // force printing of info messages